@@ -699,6 +699,103 @@ uint16_t dec_read_resp(const uint8_t *pdu, int len, uint8_t *value, int *vlen)
 	return len;
 }
 
+uint16_t enc_prep_write_req(uint16_t handle, uint16_t offset,
+				const uint8_t *value, int vlen, uint8_t *pdu, int len)
+{
+	const uint16_t min_len = sizeof(pdu[0]) + sizeof(handle) +
+							sizeof(offset);
+
+	if (pdu == NULL)
+		return 0;
+
+	if (len < min_len)
+		return 0;
+
+	if (vlen > len - min_len)
+		vlen = len - min_len;
+
+	pdu[0] = ATT_OP_PREP_WRITE_REQ;
+	att_put_u16(handle, &pdu[1]);
+	att_put_u16(offset, &pdu[3]);
+
+	if (vlen > 0) {
+		memcpy(&pdu[5], value, vlen);
+		return min_len + vlen;
+	}
+
+	return min_len;
+}
+
+uint16_t enc_exec_write_req(uint8_t flags, uint8_t *pdu, int len)
+{
+	const uint16_t min_len = sizeof(pdu[0]) + sizeof(flags);
+
+	if (pdu == NULL)
+		return 0;
+
+	if (len < min_len)
+		return 0;
+
+	if (flags > ATT_WRITE_ALL_PREP_WRITES)
+		return 0;
+
+	pdu[0] = ATT_OP_EXEC_WRITE_REQ;
+	pdu[1] = flags;
+
+	return min_len;
+}
+
+uint16_t enc_read_multi_vl_req(const uint16_t *handles, int num, uint8_t *pdu,
+								int len)
+{
+	int i;
+
+	if (pdu == NULL || handles == NULL)
+		return 0;
+
+	/* The request carries at least two handles */
+	if (num < 2 || len < (int) (sizeof(pdu[0]) + num * sizeof(handles[0])))
+		return 0;
+
+	pdu[0] = ATT_OP_READ_MULTI_VL_REQ;
+	for (i = 0; i < num; i++)
+		att_put_u16(handles[i], &pdu[1 + i * sizeof(handles[0])]);
+
+	return sizeof(pdu[0]) + num * sizeof(handles[0]);
+}
+
+int dec_read_multi_vl_resp(const uint8_t *pdu, int len, const uint8_t **values,
+						uint16_t *vlens, int num)
+{
+	const uint8_t *ptr, *end;
+	int i;
+
+	if (pdu == NULL || values == NULL || vlens == NULL)
+		return -1;
+
+	if (len < 1 || pdu[0] != ATT_OP_READ_MULTI_VL_RESP)
+		return -1;
+
+	/*
+	 * Each value is preceded by its length. The response is truncated to
+	 * the MTU, a value cut by the truncation is not returned.
+	 */
+	ptr = pdu + 1;
+	end = pdu + len;
+	for (i = 0; i < num && end - ptr >= 2; i++) {
+		uint16_t vlen = att_get_u16(ptr);
+
+		if (end - ptr - 2 < vlen)
+			break;
+
+		values[i] = ptr + 2;
+		vlens[i] = vlen;
+		ptr += 2 + vlen;
+	}
+
+	return i;
+}
+
 uint16_t enc_error_resp(uint8_t opcode, uint16_t handle, uint8_t status,
 							uint8_t *pdu, int len)
 {
@@ -51,6 +51,8 @@
 #define ATT_OP_HANDLE_IND		0x1D
 #define ATT_OP_HANDLE_CNF		0x1E
 #define ATT_OP_SIGNED_WRITE_CMD		0xD2
+#define ATT_OP_READ_MULTI_VL_REQ	0x20
+#define ATT_OP_READ_MULTI_VL_RESP	0x21
 
 /* Error codes for Error response PDU */
 #define ATT_ECODE_INVALID_HANDLE		0x01
@@ -86,6 +88,11 @@
 #define ATT_CHAR_PROPER_EXT_PROPER		0x80
 
 #define ATT_MAX_MTU				256
+#define ATT_MAX_VALUE_LEN			512
+
+/* Flags for Execute Write Request */
+#define ATT_CANCEL_ALL_PREP_WRITES		0x00
+#define ATT_WRITE_ALL_PREP_WRITES		0x01
 #define ATT_DEFAULT_L2CAP_MTU			48
 #define ATT_DEFAULT_LE_MTU			23
 
@@ -235,6 +242,13 @@ uint16_t enc_read_resp(uint8_t *value, int vlen, uint8_t *pdu, int len);
 uint16_t enc_read_blob_resp(uint8_t *value, int vlen, uint16_t offset,
 							uint8_t *pdu, int len);
 uint16_t dec_read_resp(const uint8_t *pdu, int len, uint8_t *value, int *vlen);
+uint16_t enc_prep_write_req(uint16_t handle, uint16_t offset,
+				const uint8_t *value, int vlen, uint8_t *pdu, int len);
+uint16_t enc_exec_write_req(uint8_t flags, uint8_t *pdu, int len);
+uint16_t enc_read_multi_vl_req(const uint16_t *handles, int num, uint8_t *pdu,
+								int len);
+int dec_read_multi_vl_resp(const uint8_t *pdu, int len, const uint8_t **values,
+						uint16_t *vlens, int num);
 uint16_t enc_error_resp(uint8_t opcode, uint16_t handle, uint8_t status,
 							uint8_t *pdu, int len);
 uint16_t enc_find_info_req(uint16_t start, uint16_t end, uint8_t *pdu, int len);
@@ -39,17 +39,31 @@
 
 #define GATT_TIMEOUT 30
 
+/* Largest PDU: a whole attribute value after the largest ATT header (Prepare Write Response) */
+#define GATTRIB_RECV_BUFFER_LEN (ATT_MAX_VALUE_LEN + 5)
+
 struct _GAttrib {
 	GIOChannel *io;
 	gint refs;
 	uint8_t *buf;
 	int buflen;
+	/*
+	 * Receive buffer. It does not depend on the MTU so that it is never
+	 * reallocated while a PDU is dispatched from it.
+	 */
+	uint8_t rbuf[GATTRIB_RECV_BUFFER_LEN];
 	GSource* read_watch;
 	GSource* write_watch;
 	GSource* timeout_watch;
+	/* Context of the event loop of the connection */
+	GMainContext *loop_context;
 	GQueue *requests;
 	GQueue *responses;
 	GSList *events;
+	/* Events registered for a given opcode, indexed by opcode */
+	GSList *opcode_events[256];
+	/* Events registered with GATTRIB_ALL_EVENTS or GATTRIB_ALL_REQS */
+	GSList *wildcard_events;
 	guint next_cmd_id;
 	GDestroyNotify destroy;
 	gpointer destroy_user_data;
@@ -100,6 +114,9 @@ static guint8 opcode2expected(guint8 opcode)
 	case ATT_OP_READ_MULTI_REQ:
 		return ATT_OP_READ_MULTI_RESP;
 
+	case ATT_OP_READ_MULTI_VL_REQ:
+		return ATT_OP_READ_MULTI_VL_RESP;
+
 	case ATT_OP_READ_BY_GROUP_REQ:
 		return ATT_OP_READ_BY_GROUP_RESP;
 
@@ -130,6 +147,7 @@ static gboolean is_response(guint8 opcode)
 	case ATT_OP_READ_RESP:
 	case ATT_OP_READ_BLOB_RESP:
 	case ATT_OP_READ_MULTI_RESP:
+	case ATT_OP_READ_MULTI_VL_RESP:
 	case ATT_OP_READ_BY_GROUP_RESP:
 	case ATT_OP_WRITE_RESP:
 	case ATT_OP_PREP_WRITE_RESP:
@@ -170,6 +188,27 @@ static void event_destroy(struct event *evt)
 	g_free(evt);
 }
 
+static GSList **event_index(GAttrib *attrib, guint8 expected)
+{
+	if (expected == GATTRIB_ALL_EVENTS || expected == GATTRIB_ALL_REQS)
+		return &attrib->wildcard_events;
+
+	return &attrib->opcode_events[expected];
+}
+
+static void clear_event_index(GAttrib *attrib)
+{
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		g_slist_free(attrib->opcode_events[i]);
+		attrib->opcode_events[i] = NULL;
+	}
+
+	g_slist_free(attrib->wildcard_events);
+	attrib->wildcard_events = NULL;
+}
+
 static void attrib_destroy(GAttrib *attrib)
 {
 	GSList *l;
@@ -192,6 +231,7 @@ static void attrib_destroy(GAttrib *attrib)
 
 	g_slist_free(attrib->events);
 	attrib->events = NULL;
+	clear_event_index(attrib);
 
 	if (attrib->timeout_watch > 0)
 		g_source_destroy(attrib->timeout_watch);
@@ -205,6 +245,9 @@ static void attrib_destroy(GAttrib *attrib)
 	if (attrib->io)
 		g_io_channel_unref(attrib->io);
 
+	if (attrib->loop_context)
+		g_main_context_unref(attrib->loop_context);
+
 	g_free(attrib->buf);
 
 	if (attrib->destroy)
@@ -327,7 +370,8 @@ static gboolean can_write_data(GIOChannel *io, GIOCondition cond,
 	cmd->sent = TRUE;
 
 	if (attrib->timeout_watch == 0) {
-		attrib->timeout_watch = gattlib_timeout_add_seconds(GATT_TIMEOUT, disconnect_timeout, attrib);
+		attrib->timeout_watch = gattlib_timeout_add_seconds(attrib->loop_context, GATT_TIMEOUT,
+								disconnect_timeout, attrib);
 	}
 
 	return FALSE;
@@ -358,9 +402,9 @@ static gboolean received_data(GIOChannel *io, GIOCondition cond, gpointer data)
 {
 	struct _GAttrib *attrib = data;
 	struct command *cmd = NULL;
-	GSList *l;
-	uint8_t buf[512], status;
-	gsize len;
+	GSList *l, *next;
+	uint8_t *buf = attrib->rbuf, status;
+	gsize len = 0;
 	GIOStatus iostat;
 	gboolean norequests, noresponses;
 
@@ -372,22 +416,32 @@ static gboolean received_data(GIOChannel *io, GIOCondition cond, gpointer data)
 		return FALSE;
 	}
 
-	memset(buf, 0, sizeof(buf));
-
-	iostat = g_io_channel_read_chars(io, (gchar *) buf, sizeof(buf),
+	/*
+	 * The buffer is not cleared: only the 'len' bytes that have been read
+	 * are passed to the handlers.
+	 */
+	iostat = g_io_channel_read_chars(io, (gchar *) buf, sizeof(attrib->rbuf),
 								&len, NULL);
-	if (iostat != G_IO_STATUS_NORMAL) {
+	if (iostat != G_IO_STATUS_NORMAL || len == 0) {
 		status = ATT_ECODE_IO;
+		len = 0;
 		goto done;
 	}
 
-	for (l = attrib->events; l; l = l->next) {
+	/* Only the handlers registered for this opcode are called */
+	for (l = attrib->opcode_events[buf[0]]; l; l = next) {
+		struct event *evt = l->data;
+
+		next = l->next;
+		evt->func(buf, len, evt->user_data);
+	}
+
+	for (l = attrib->wildcard_events; l; l = next) {
 		struct event *evt = l->data;
 
-		if (evt->expected == buf[0] ||
-				evt->expected == GATTRIB_ALL_EVENTS ||
-				(is_response(buf[0]) == FALSE &&
-						evt->expected == GATTRIB_ALL_REQS))
+		next = l->next;
+		if (evt->expected == GATTRIB_ALL_EVENTS ||
+				is_response(buf[0]) == FALSE)
 			evt->func(buf, len, evt->user_data);
 	}
 
@@ -406,7 +460,7 @@ static gboolean received_data(GIOChannel *io, GIOCondition cond, gpointer data)
 	}
 
 	if (buf[0] == ATT_OP_ERROR) {
-		status = buf[4];
+		status = (len > 4) ? buf[4] : ATT_ECODE_IO;
 		goto done;
 	}
 
@@ -474,6 +528,7 @@ GAttrib *g_attrib_new(GIOChannel *io)
 	attrib->read_watch = gattlib_watch_connection_full(attrib->io,
 			G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL,
 			received_data, attrib, NULL);
+	attrib->loop_context = g_main_context_ref(g_source_get_context(attrib->read_watch));
 
 	return g_attrib_ref(attrib);
 }
@@ -660,6 +715,7 @@ guint g_attrib_register(GAttrib *attrib, guint8 opcode,
 	event->id = ++next_evt_id;
 
 	attrib->events = g_slist_append(attrib->events, event);
+	*event_index(attrib, opcode) = g_slist_append(*event_index(attrib, opcode), event);
 
 	return event->id;
 }
@@ -697,6 +753,7 @@ gboolean g_attrib_unregister(GAttrib *attrib, guint id)
 	evt = l->data;
 
 	attrib->events = g_slist_remove(attrib->events, evt);
+	*event_index(attrib, evt->expected) = g_slist_remove(*event_index(attrib, evt->expected), evt);
 
 	if (evt->notify)
 		evt->notify(evt->user_data);
@@ -724,6 +781,7 @@ gboolean g_attrib_unregister_all(GAttrib *attrib)
 
 	g_slist_free(attrib->events);
 	attrib->events = NULL;
+	clear_event_index(attrib);
 
 	return TRUE;
 }
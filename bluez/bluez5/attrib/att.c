@@ -819,6 +819,59 @@ ssize_t dec_read_resp(const uint8_t *pdu, size_t len, uint8_t *value,
 	return len - 1;
 }
 
+uint16_t enc_read_multi_vl_req(const uint16_t *handles, int num, uint8_t *pdu,
+								size_t len)
+{
+	int i;
+
+	if (pdu == NULL || handles == NULL)
+		return 0;
+
+	/* The request carries at least two handles */
+	if (num < 2 || len < sizeof(pdu[0]) + num * sizeof(handles[0]))
+		return 0;
+
+	/* Attribute Opcode (1 octet) */
+	pdu[0] = ATT_OP_READ_MULTI_VL_REQ;
+	/* Set Of Handles (2 octets each) */
+	for (i = 0; i < num; i++)
+		put_le16(handles[i], &pdu[1 + i * sizeof(handles[0])]);
+
+	return sizeof(pdu[0]) + num * sizeof(handles[0]);
+}
+
+int dec_read_multi_vl_resp(const uint8_t *pdu, size_t len,
+			const uint8_t **values, uint16_t *vlens, int num)
+{
+	const uint8_t *ptr, *end;
+	int i;
+
+	if (pdu == NULL || values == NULL || vlens == NULL)
+		return -EINVAL;
+
+	if (len < 1 || pdu[0] != ATT_OP_READ_MULTI_VL_RESP)
+		return -EINVAL;
+
+	/*
+	 * Each value is preceded by its length (2 octets). The response is
+	 * truncated to the MTU, a value cut by the truncation is not returned.
+	 */
+	ptr = pdu + 1;
+	end = pdu + len;
+	for (i = 0; i < num && end - ptr >= 2; i++) {
+		uint16_t vlen = get_le16(ptr);
+
+		if (end - ptr - 2 < vlen)
+			break;
+
+		values[i] = ptr + 2;
+		vlens[i] = vlen;
+		ptr += 2 + vlen;
+	}
+
+	return i;
+}
+
 uint16_t enc_error_resp(uint8_t opcode, uint16_t handle, uint8_t status,
 						uint8_t *pdu, size_t len)
 {
@@ -23,30 +23,122 @@
 
 #include "gattlib_internal.h"
 
+#include <errno.h>
 #include <poll.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
 
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/hci.h>
 #include <bluetooth/hci_lib.h>
 
-#define LE_SCAN_PASSIVE                 0x00
-#define LE_SCAN_ACTIVE                  0x01
-
 /* These LE scan and inquiry parameters were chosen according to LE General
  * Discovery Procedure specification.
  */
 #define DISCOV_LE_SCAN_WIN              0x12
 #define DISCOV_LE_SCAN_INT              0x12
 
-#define BLE_EVENT_TYPE     0x05
-#define BLE_SCAN_RESPONSE  0x04
+#define EVT_LE_EXTENDED_ADVERTISING_REPORT  0x0D
+/* Size of a report of the LE Extended Advertising Report event without its data */
+#define LE_EXTENDED_ADVERTISING_INFO_SIZE   24
+
+/* LE Extended Scan commands. Once used, the controller rejects the legacy scan commands. */
+#define OCF_LE_SET_EXTENDED_SCAN_PARAMETERS  0x0041
+typedef struct {
+	uint8_t		own_bdaddr_type;
+	uint8_t		filter;
+	uint8_t		phys;
+	/* Parameters of the LE 1M PHY */
+	uint8_t		type;
+	uint16_t	interval;
+	uint16_t	window;
+} __attribute__ ((packed)) le_set_extended_scan_parameters_cp;
+#define LE_SET_EXTENDED_SCAN_PARAMETERS_CP_SIZE 8
+
+#define OCF_LE_SET_EXTENDED_SCAN_ENABLE      0x0042
+typedef struct {
+	uint8_t		enable;
+	uint8_t		filter_dup;
+	uint16_t	duration;
+	uint16_t	period;
+} __attribute__ ((packed)) le_set_extended_scan_enable_cp;
+#define LE_SET_EXTENDED_SCAN_ENABLE_CP_SIZE 6
+
+#define LE_PHY_1M                            0x01
+/* Bit 12 of the LE features: LE Extended Advertising */
+#define LE_FEATURE_EXTENDED_ADVERTISING_BYTE 1
+#define LE_FEATURE_EXTENDED_ADVERTISING_BIT  0x10
 
 #define EIR_NAME_SHORT     0x08  /* shortened local name */
 #define EIR_NAME_COMPLETE  0x09  /* complete local name */
 
+static const gattlib_scan_parameters_t default_scan_parameters = {
+	.scan_type = GATTLIB_SCAN_TYPE_ACTIVE,
+	.interval = DISCOV_LE_SCAN_INT,
+	.window = DISCOV_LE_SCAN_WIN,
+	.filter_duplicates = 1,
+	.use_accept_list = 0,
+};
+
+int gattlib_adapter_list(gattlib_adapter_info_t **adapters, size_t *adapters_count) {
+	struct hci_dev_list_req *dl;
+	struct hci_dev_info di;
+	int sock, i;
+
+	if ((adapters == NULL) || (adapters_count == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	sock = socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BTPROTO_HCI);
+	if (sock < 0) {
+		fprintf(stderr, "ERROR: Could not open HCI socket.\n");
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+	dl = calloc(1, sizeof(struct hci_dev_list_req) + HCI_MAX_DEV * sizeof(struct hci_dev_req));
+	if (dl == NULL) {
+		close(sock);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	dl->dev_num = HCI_MAX_DEV;
+
+	if (ioctl(sock, HCIGETDEVLIST, (void *) dl) < 0) {
+		fprintf(stderr, "ERROR: Could not get the list of HCI devices.\n");
+		free(dl);
+		close(sock);
+		return GATTLIB_DEVICE_ERROR;
+	}
+	close(sock);
+
+	*adapters = calloc(dl->dev_num > 0 ? dl->dev_num : 1, sizeof(gattlib_adapter_info_t));
+	if (*adapters == NULL) {
+		free(dl);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	*adapters_count = 0;
+
+	for (i = 0; i < dl->dev_num; i++) {
+		gattlib_adapter_info_t *info = &(*adapters)[*adapters_count];
+
+		// The adapter might have been removed since the list has been retrieved
+		if (hci_devinfo(dl->dev_req[i].dev_id, &di) < 0) {
+			continue;
+		}
+
+		snprintf(info->name, sizeof(info->name), "%s", di.name);
+		ba2str(&di.bdaddr, info->address);
+		info->powered = hci_test_bit(HCI_UP, &di.flags) ? 1 : 0;
+		(*adapters_count)++;
+	}
+
+	free(dl);
+	return GATTLIB_SUCCESS;
+}
+
 int gattlib_adapter_open(const char* adapter_name, void** adapter) {
+	struct gattlib_adapter *gattlib_adapter;
 	int dev_id;
 
 	if (adapter == NULL) {
@@ -64,57 +156,160 @@ int gattlib_adapter_open(const char* adapter_name, void** adapter) {
 		return GATTLIB_NOT_FOUND;
 	}
 
-	int* device_desc = malloc(sizeof(int));
-	if (device_desc == NULL) {
+	gattlib_adapter = calloc(1, sizeof(struct gattlib_adapter));
+	if (gattlib_adapter == NULL) {
 		return GATTLIB_OUT_OF_MEMORY;
-	} else {
-		*adapter = device_desc;
 	}
 
-	*device_desc = hci_open_dev(dev_id);
-	if (*device_desc < 0) {
+	gattlib_adapter->dev_id = dev_id;
+	gattlib_adapter->device_desc = hci_open_dev(dev_id);
+	if (gattlib_adapter->device_desc < 0) {
 		fprintf(stderr, "ERROR: Could not open device.\n");
+		free(gattlib_adapter);
 		return GATTLIB_DEVICE_ERROR;
 	}
 
+	gattlib_adapter->scan_parameters = default_scan_parameters;
+
+	*adapter = gattlib_adapter;
 	return GATTLIB_SUCCESS;
 }
 
-static char* parse_name(uint8_t* data, size_t size) {
+struct ble_scan_handler {
+	gattlib_discovered_device_t discovered_device_cb;
+	gattlib_advertising_report_cb_t advertising_report_cb;
+	void *user_data;
+};
+
+/* Event type of the legacy advertising reports converted into the Extended Advertising Report event type */
+static const uint16_t legacy_event_types[] = {
+	[0x00] = 0x13, /* ADV_IND */
+	[0x01] = 0x15, /* ADV_DIRECT_IND */
+	[0x02] = 0x12, /* ADV_SCAN_IND */
+	[0x03] = 0x10, /* ADV_NONCONN_IND */
+	[0x04] = 0x1B, /* SCAN_RSP */
+};
+
+/* Copy the advertised name into 'name'. Return 0 if no name is advertised. */
+static size_t parse_name(const uint8_t* data, size_t size, char *name, size_t name_size) {
 	size_t offset = 0;
 
-	while (offset < size) {
-		uint8_t field_len = data[0];
+	while (offset + 1 < size) {
+		uint8_t field_len = data[offset];
 		size_t name_len;
 
-		if (field_len == 0 || offset + field_len > size)
-			return NULL;
+		if (field_len == 0 || offset + 1 + field_len > size)
+			return 0;
 
-		switch (data[1]) {
+		switch (data[offset + 1]) {
 		case EIR_NAME_SHORT:
 		case EIR_NAME_COMPLETE:
-			name_len = field_len - 1;
-			if (name_len > size)
-				return NULL;
-
-			return strndup((const char*)(data + 2), name_len);
+			name_len = MIN((size_t)field_len - 1, name_size - 1);
+			memcpy(name, data + offset + 2, name_len);
+			name[name_len] = '\0';
+			return name_len + 1;
 		}
 
 		offset += field_len + 1;
-		data += field_len + 1;
 	}
 
-	return NULL;
+	return 0;
 }
 
-static int ble_scan(void *adapter, int device_desc, gattlib_discovered_device_t discovered_device_cb, int timeout, void *user_data) {
+static void ble_scan_on_report(void *adapter, struct ble_scan_handler *handler,
+		const bdaddr_t *bdaddr, gattlib_advertising_report_t *report)
+{
+	if (handler->advertising_report_cb) {
+		// 'bdaddr_t' is stored least significant byte first
+		for (int i = 0; i < 6; i++) {
+			report->addr[i] = bdaddr->b[5 - i];
+		}
+		handler->advertising_report_cb(adapter, report, handler->user_data);
+	} else if (handler->discovered_device_cb) {
+		char addr[18];
+		char name[HCI_MAX_EVENT_SIZE];
+
+		// gattlib_adapter_scan_enable() has always reported the scan responses only
+		if ((report->event_type & GATTLIB_ADVERTISING_REPORT_SCAN_RESPONSE) == 0) {
+			return;
+		}
+
+		ba2str(bdaddr, addr);
+		if (parse_name(report->data, report->data_length, name, sizeof(name))) {
+			handler->discovered_device_cb(adapter, addr, name, handler->user_data);
+		} else {
+			handler->discovered_device_cb(adapter, addr, NULL, handler->user_data);
+		}
+	}
+}
+
+/* Parse all the advertising reports of a LE Meta event read from the HCI socket */
+static void ble_scan_process_event(void *adapter, struct ble_scan_handler *handler, const uint8_t *buffer, size_t len) {
+	const uint8_t *end = buffer + len;
+	const evt_le_meta_event* meta = (const evt_le_meta_event*)(buffer + HCI_EVENT_HDR_SIZE + 1);
+	const uint8_t *ptr = meta->data + 1;
+	gattlib_advertising_report_t report;
+	uint8_t num_reports;
+
+	if (len < HCI_EVENT_HDR_SIZE + 1 + EVT_LE_META_EVENT_SIZE + 1) {
+		return;
+	}
+	num_reports = meta->data[0];
+
+	switch (meta->subevent) {
+	case EVT_LE_ADVERTISING_REPORT:
+		for (uint8_t i = 0; i < num_reports; i++) {
+			const le_advertising_info *info = (const le_advertising_info*)ptr;
+
+			// Each report is followed by its RSSI
+			if ((ptr + LE_ADVERTISING_INFO_SIZE > end) || (info->data + info->length + 1 > end)) {
+				return;
+			}
+
+			memset(&report, 0, sizeof(report));
+			report.addr_type   = info->bdaddr_type;
+			report.event_type  = (info->evt_type < G_N_ELEMENTS(legacy_event_types)) ? legacy_event_types[info->evt_type] : 0;
+			report.rssi        = (int8_t)info->data[info->length];
+			report.tx_power    = GATTLIB_ADVERTISING_REPORT_TX_POWER_UNKNOWN;
+			report.data        = info->data;
+			report.data_length = info->length;
+			ble_scan_on_report(adapter, handler, &info->bdaddr, &report);
+
+			ptr = info->data + info->length + 1;
+		}
+		break;
+
+	case EVT_LE_EXTENDED_ADVERTISING_REPORT:
+		for (uint8_t i = 0; i < num_reports; i++) {
+			if (ptr + LE_EXTENDED_ADVERTISING_INFO_SIZE > end) {
+				return;
+			}
+
+			uint8_t data_length = ptr[23];
+			if (ptr + LE_EXTENDED_ADVERTISING_INFO_SIZE + data_length > end) {
+				return;
+			}
+
+			memset(&report, 0, sizeof(report));
+			report.event_type  = ptr[0] | (ptr[1] << 8);
+			report.addr_type   = ptr[2];
+			report.tx_power    = (int8_t)ptr[12];
+			report.rssi        = (int8_t)ptr[13];
+			report.data        = ptr + LE_EXTENDED_ADVERTISING_INFO_SIZE;
+			report.data_length = data_length;
+			ble_scan_on_report(adapter, handler, (const bdaddr_t*)(ptr + 3), &report);
+
+			ptr += LE_EXTENDED_ADVERTISING_INFO_SIZE + data_length;
+		}
+		break;
+	}
+}
+
+static int ble_scan(void *adapter, int device_desc, struct ble_scan_handler *handler, int timeout) {
 	struct hci_filter old_options;
 	socklen_t slen = sizeof(old_options);
 	struct hci_filter new_options;
 	unsigned char buffer[HCI_MAX_EVENT_SIZE];
-	evt_le_meta_event* meta = (evt_le_meta_event*)(buffer + HCI_EVENT_HDR_SIZE + 1);
-	le_advertising_info* info;
-	char addr[18];
 	int len;
 #if BLUEZ_VERSION_MAJOR == 4
 	struct timeval wait;
@@ -155,17 +350,7 @@ static int ble_scan(void *adapter, int device_desc, gattlib_discovered_device_t
 			break;
 		}
 
-		if (meta->subevent != 0x02 || (uint8_t)buffer[BLE_EVENT_TYPE] != BLE_SCAN_RESPONSE)
-			continue;
-
-		info = (le_advertising_info*) (meta->data + 1);
-		ba2str(&info->bdaddr, addr);
-
-		char* name = parse_name(info->data, info->length);
-		discovered_device_cb(adapter, addr, name, user_data);
-		if (name) {
-			free(name);
-		}
+		ble_scan_process_event(adapter, handler, buffer, len);
 
 		int elapsed = time(NULL) - ts;
 		if (elapsed >= timeout) {
@@ -194,17 +379,7 @@ static int ble_scan(void *adapter, int device_desc, gattlib_discovered_device_t
 			break;
 		}
 
-		if (meta->subevent != 0x02 || (uint8_t)buffer[BLE_EVENT_TYPE] != BLE_SCAN_RESPONSE)
-			continue;
-
-		info = (le_advertising_info*) (meta->data + 1);
-		ba2str(&info->bdaddr, addr);
-
-		char* name = parse_name(info->data, info->length);
-		discovered_device_cb(adapter, addr, name, user_data);
-		if (name) {
-			free(name);
-		}
+		ble_scan_process_event(adapter, handler, buffer, len);
 	}
 #endif
 
@@ -212,27 +387,110 @@ static int ble_scan(void *adapter, int device_desc, gattlib_discovered_device_t
 	return GATTLIB_SUCCESS;
 }
 
-int gattlib_adapter_scan_enable(void* adapter, gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data) {
-	int device_desc = *(int*)adapter;
+static bool hci_le_has_extended_scan(int device_desc) {
+	le_read_local_supported_features_rp rp;
+	struct hci_request rq;
 
-	uint16_t interval = htobs(DISCOV_LE_SCAN_INT);
-	uint16_t window = htobs(DISCOV_LE_SCAN_WIN);
+	memset(&rq, 0, sizeof(rq));
+	rq.ogf    = OGF_LE_CTL;
+	rq.ocf    = OCF_LE_READ_LOCAL_SUPPORTED_FEATURES;
+	rq.rparam = &rp;
+	rq.rlen   = LE_READ_LOCAL_SUPPORTED_FEATURES_RP_SIZE;
+
+	if ((hci_send_req(device_desc, &rq, 1000) < 0) || rp.status) {
+		return false;
+	}
+
+	return (rp.features[LE_FEATURE_EXTENDED_ADVERTISING_BYTE] & LE_FEATURE_EXTENDED_ADVERTISING_BIT) != 0;
+}
+
+static int hci_le_send_cmd(int device_desc, uint16_t ocf, void *cparam, int clen, int to) {
+	struct hci_request rq;
+	uint8_t status;
+
+	memset(&rq, 0, sizeof(rq));
+	rq.ogf    = OGF_LE_CTL;
+	rq.ocf    = ocf;
+	rq.cparam = cparam;
+	rq.clen   = clen;
+	rq.rparam = &status;
+	rq.rlen   = 1;
+
+	if (hci_send_req(device_desc, &rq, to) < 0) {
+		return -1;
+	}
+
+	if (status) {
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int hci_le_set_extended_scan_parameters(int device_desc, uint8_t type, uint16_t interval, uint16_t window,
+		uint8_t own_type, uint8_t filter, int to)
+{
+	le_set_extended_scan_parameters_cp cp;
+
+	memset(&cp, 0, sizeof(cp));
+	cp.own_bdaddr_type = own_type;
+	cp.filter          = filter;
+	cp.phys            = LE_PHY_1M;
+	cp.type            = type;
+	cp.interval        = interval;
+	cp.window          = window;
+
+	return hci_le_send_cmd(device_desc, OCF_LE_SET_EXTENDED_SCAN_PARAMETERS, &cp, LE_SET_EXTENDED_SCAN_PARAMETERS_CP_SIZE, to);
+}
+
+static int hci_le_set_extended_scan_enable(int device_desc, uint8_t enable, uint8_t filter_dup, int to) {
+	le_set_extended_scan_enable_cp cp;
+
+	// No duration: the scan runs until it is disabled
+	memset(&cp, 0, sizeof(cp));
+	cp.enable     = enable;
+	cp.filter_dup = filter_dup;
+
+	return hci_le_send_cmd(device_desc, OCF_LE_SET_EXTENDED_SCAN_ENABLE, &cp, LE_SET_EXTENDED_SCAN_ENABLE_CP_SIZE, to);
+}
+
+static int _gattlib_adapter_scan_enable(void* adapter, struct ble_scan_handler *handler, size_t timeout) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	const gattlib_scan_parameters_t *parameters = &gattlib_adapter->scan_parameters;
+	int device_desc = gattlib_adapter->device_desc;
+
+	uint16_t interval = htobs(parameters->interval);
+	uint16_t window = htobs(parameters->window);
 	uint8_t own_address_type = 0x00;
-	uint8_t filter_policy = 0x00;
+	// Filter policy 0x01: only report the advertisements of the devices in the accept list
+	uint8_t filter_policy = parameters->use_accept_list ? 0x01 : 0x00;
+
+	int ret;
 
-	int ret = hci_le_set_scan_parameters(device_desc, LE_SCAN_ACTIVE, interval, window, own_address_type, filter_policy, 10000);
+	// The Extended Advertising Reports are only sent when the scan is enabled with the extended commands
+	gattlib_adapter->extended_scan = hci_le_has_extended_scan(device_desc);
+	if (gattlib_adapter->extended_scan) {
+		ret = hci_le_set_extended_scan_parameters(device_desc, parameters->scan_type, interval, window, own_address_type, filter_policy, 10000);
+	} else {
+		ret = hci_le_set_scan_parameters(device_desc, parameters->scan_type, interval, window, own_address_type, filter_policy, 10000);
+	}
 	if (ret < 0) {
 		fprintf(stderr, "ERROR: Set scan parameters failed (are you root?).\n");
 		return 1;
 	}
 
-	ret = hci_le_set_scan_enable(device_desc, 0x01, 1, 10000);
+	if (gattlib_adapter->extended_scan) {
+		ret = hci_le_set_extended_scan_enable(device_desc, 0x01, parameters->filter_duplicates ? 1 : 0, 10000);
+	} else {
+		ret = hci_le_set_scan_enable(device_desc, 0x01, parameters->filter_duplicates ? 1 : 0, 10000);
+	}
 	if (ret < 0) {
 		fprintf(stderr, "ERROR: Enable scan failed.\n");
 		return 1;
 	}
 
-	ret = ble_scan(adapter, device_desc, discovered_device_cb, timeout, user_data);
+	ret = ble_scan(adapter, device_desc, handler, timeout);
 	if (ret != 0) {
 		fprintf(stderr, "ERROR: Advertisement fail.\n");
 		return 1;
@@ -241,21 +499,132 @@ int gattlib_adapter_scan_enable(void* adapter, gattlib_discovered_device_t disco
 	return GATTLIB_SUCCESS;
 }
 
+int gattlib_adapter_scan_enable(void* adapter, gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data) {
+	struct ble_scan_handler handler = {
+		.discovered_device_cb = discovered_device_cb,
+		.user_data = user_data,
+	};
+
+	return _gattlib_adapter_scan_enable(adapter, &handler, timeout);
+}
+
+int gattlib_adapter_scan_enable_with_reports(void* adapter, gattlib_advertising_report_cb_t advertising_report_cb, size_t timeout, void *user_data) {
+	struct ble_scan_handler handler = {
+		.advertising_report_cb = advertising_report_cb,
+		.user_data = user_data,
+	};
+
+	if (advertising_report_cb == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	return _gattlib_adapter_scan_enable(adapter, &handler, timeout);
+}
+
 int gattlib_adapter_scan_enable_with_filter(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
 		gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data)
 {
 	return GATTLIB_NOT_SUPPORTED;
 }
 
+struct gattlib_device_registry* gattlib_adapter_get_device_registry(void *adapter)
+{
+	// Device registry is not supported by this backend
+	return NULL;
+}
+
+int gattlib_adapter_scan_set_device_table(void *adapter, size_t max_devices, size_t device_timeout, uint32_t flags)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_scan_set_batch(void *adapter, gattlib_discovered_devices_t discovered_devices_cb,
+		size_t batch_period_ms, size_t batch_max_devices)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_scan_set_parameters(void *adapter, const gattlib_scan_parameters_t *parameters)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	if (parameters == NULL) {
+		gattlib_adapter->scan_parameters = default_scan_parameters;
+		return GATTLIB_SUCCESS;
+	}
+
+	if ((parameters->scan_type != GATTLIB_SCAN_TYPE_PASSIVE) && (parameters->scan_type != GATTLIB_SCAN_TYPE_ACTIVE)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	if ((parameters->interval < 0x0004) || (parameters->interval > 0x4000) ||
+	    (parameters->window < 0x0004) || (parameters->window > parameters->interval)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_adapter->scan_parameters = *parameters;
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_scan_set_accept_list(void *adapter, const gattlib_accept_list_entry_t *entries, size_t entries_count)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	bdaddr_t bdaddr;
+	int ret;
+
+	if ((gattlib_adapter == NULL) || ((entries == NULL) && (entries_count > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// Check all the entries first to not leave the accept list half loaded
+	for (size_t i = 0; i < entries_count; i++) {
+		if ((entries[i].addr == NULL) || (bachk(entries[i].addr) < 0)) {
+			return GATTLIB_INVALID_PARAMETER;
+		}
+		if ((entries[i].addr_type != GATTLIB_ADDRESS_TYPE_PUBLIC) && (entries[i].addr_type != GATTLIB_ADDRESS_TYPE_RANDOM)) {
+			return GATTLIB_INVALID_PARAMETER;
+		}
+	}
+
+	ret = hci_le_clear_white_list(gattlib_adapter->device_desc, 1000);
+	if (ret < 0) {
+		fprintf(stderr, "ERROR: Clear accept list failed.\n");
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	for (size_t i = 0; i < entries_count; i++) {
+		str2ba(entries[i].addr, &bdaddr);
+
+		ret = hci_le_add_white_list(gattlib_adapter->device_desc, &bdaddr, entries[i].addr_type, 1000);
+		if (ret < 0) {
+			// The accept list of the controller might be full. Do not keep a partial list.
+			fprintf(stderr, "ERROR: Failed to add %s to the accept list.\n", entries[i].addr);
+			hci_le_clear_white_list(gattlib_adapter->device_desc, 1000);
+			return GATTLIB_DEVICE_ERROR;
+		}
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
 int gattlib_adapter_scan_disable(void* adapter) {
-	int device_desc = *(int*)adapter;
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	int device_desc = gattlib_adapter->device_desc;
+	int result;
 
 	if (device_desc == -1) {
 		fprintf(stderr, "ERROR: Could not disable scan, not enabled yet.\n");
 		return 1;
 	}
 
-	int result = hci_le_set_scan_enable(device_desc, 0x00, 1, 10000);
+	if (gattlib_adapter->extended_scan) {
+		result = hci_le_set_extended_scan_enable(device_desc, 0x00, 1, 10000);
+	} else {
+		result = hci_le_set_scan_enable(device_desc, 0x00, 1, 10000);
+	}
 	if (result < 0) {
 		fprintf(stderr, "ERROR: Disable scan failed.\n");
 	}
@@ -263,7 +632,7 @@ int gattlib_adapter_scan_disable(void* adapter) {
 }
 
 int gattlib_adapter_close(void* adapter) {
-	hci_close_dev(*(int*)adapter);
+	hci_close_dev(((struct gattlib_adapter*)adapter)->device_desc);
 	free(adapter);
 	return GATTLIB_SUCCESS;
 }
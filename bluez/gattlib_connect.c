@@ -22,7 +22,6 @@
  */
 
 #include <assert.h>
-#include <pthread.h>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -33,28 +32,55 @@
 #include "att.h"
 #include "btio.h"
 #include "gattrib.h"
+#include "gatt.h"
 #include "hci.h"
 #include "hci_lib.h"
 
 #define CONNECTION_TIMEOUT    2
 
-struct gattlib_thread_t g_gattlib_thread = { 0 };
+// Time given to the whole connection attempt (see gattlib_set_connection_attempt_timeout())
+static gint m_connection_attempt_timeout = GATTLIB_DEFAULT_CONNECTION_ATTEMPT_TIMEOUT;
 
 typedef struct {
+	// References held by the connection attempt and by the caller of gattlib_connect() waiting for it
+	gint               ref;
 	gatt_connection_t* conn;
 	gatt_connect_cb_t  connect_cb;
+	// Set once the connection attempt has succeeded or failed. The caller of gattlib_connect() waits
+	// for it on 'cond'.
+	gint               completed;
+	GMutex             mutex;
+	GCond              cond;
 	int                connected;
 	int                timeout;
 	GError*            error;
 	void*              user_data;
+	// Expires when the connection attempt takes too long
+	GSource*           attempt_timeout;
+	// Context of the event loop running the connection attempt
+	GMainContext*      loop_context;
+	// ATT MTU to request once connected. 0 if the ATT MTU cannot be exchanged (ie: BR/EDR)
+	uint16_t           mtu;
+	// Number of Enhanced ATT bearers to open once connected. 0 to only use the ATT fixed channel
+	int                eatt_bearers;
+	bdaddr_t           sba;
+	bdaddr_t           dba;
+	uint8_t            dest_type;
+	BtIOSecLevel       sec_level;
 } io_connect_arg_t;
 
-static void events_handler(const uint8_t *pdu, uint16_t len, gpointer user_data) {
-	gatt_connection_t *conn = user_data;
+
+static void handle_att_event(gatt_connection_t *conn, GAttrib *attrib, const uint8_t *pdu, uint16_t len) {
 	uint8_t opdu[ATT_MAX_MTU];
 	uint16_t handle, olen = 0;
 	uuid_t uuid = {};
 
+	// Opcode and attribute handle
+	if (len < 3) {
+		fprintf(stderr, "Malformed ATT notification/indication\n");
+		return;
+	}
+
 #if BLUEZ_VERSION_MAJOR == 4
 	handle = att_get_u16(&pdu[1]);
 #else
@@ -66,6 +92,9 @@ static void events_handler(const uint8_t *pdu, uint16_t len, gpointer user_data)
 		return;
 	}
 
+	// Keep the cached value coherent with the device
+	gattlib_value_cache_update(((gattlib_context_t*)conn->context)->value_cache, &uuid, &pdu[3], len - 3);
+
 	switch (pdu[0]) {
 	case ATT_OP_HANDLE_NOTIFY:
 		if (gattlib_has_valid_handler(&conn->notification)) {
@@ -87,9 +116,9 @@ static void events_handler(const uint8_t *pdu, uint16_t len, gpointer user_data)
 
 	olen = enc_confirmation(opdu, sizeof(opdu));
 
+	// Confirm the indication on the bearer it has been received on
 	if (olen > 0) {
-		gattlib_context_t* conn_context = conn->context;
-		g_attrib_send(conn_context->attrib, 0,
+		g_attrib_send(attrib, 0,
 #if BLUEZ_VERSION_MAJOR == 4
 				opdu[0],
 #endif
@@ -97,6 +126,32 @@ static void events_handler(const uint8_t *pdu, uint16_t len, gpointer user_data)
 	}
 }
 
+static void events_handler(const uint8_t *pdu, uint16_t len, gpointer user_data) {
+	gatt_connection_t *conn = user_data;
+	gattlib_context_t* conn_context = conn->context;
+
+	handle_att_event(conn, conn_context->attrib, pdu, len);
+}
+
+static void bearer_events_handler(const uint8_t *pdu, uint16_t len, gpointer user_data) {
+	struct gattlib_att_bearer* bearer = user_data;
+
+	handle_att_event(bearer->connection, bearer->attrib, pdu, len);
+}
+
+void gattlib_att_bearer_listen(struct gattlib_att_bearer* bearer) {
+	g_attrib_register(bearer->attrib, ATT_OP_HANDLE_NOTIFY,
+#if BLUEZ_VERSION_MAJOR == 5
+			GATTRIB_ALL_HANDLES,
+#endif
+			bearer_events_handler, bearer, NULL);
+	g_attrib_register(bearer->attrib, ATT_OP_HANDLE_IND,
+#if BLUEZ_VERSION_MAJOR == 5
+			GATTRIB_ALL_HANDLES,
+#endif
+			bearer_events_handler, bearer, NULL);
+}
+
 static gboolean io_listen_cb(gpointer user_data) {
 	gatt_connection_t *conn = user_data;
 	gattlib_context_t* conn_context = conn->context;
@@ -115,18 +170,258 @@ static gboolean io_listen_cb(gpointer user_data) {
 	return FALSE;
 }
 
-static void io_connect_cb(GIOChannel *io, GError *err, gpointer user_data) {
+/* Index the characteristics by value handle to find the one of a notification in constant time */
+static void index_characteristics(gattlib_context_t* conn_context) {
+	int i;
+
+	conn_context->characteristic_by_handle = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	for (i = 0; i < conn_context->characteristic_count; i++) {
+		g_hash_table_insert(conn_context->characteristic_by_handle,
+				GUINT_TO_POINTER(conn_context->characteristics[i].value_handle),
+				&conn_context->characteristics[i]);
+	}
+}
+
+static io_connect_arg_t* io_connect_arg_new(void* user_data) {
+	io_connect_arg_t* io_connect_arg = calloc(1, sizeof(io_connect_arg_t));
+
+	if (io_connect_arg != NULL) {
+		io_connect_arg->user_data = user_data;
+		g_mutex_init(&io_connect_arg->mutex);
+		g_cond_init(&io_connect_arg->cond);
+	}
+	return io_connect_arg;
+}
+
+static void io_connect_arg_free(io_connect_arg_t* io_connect_arg) {
+	g_cond_clear(&io_connect_arg->cond);
+	g_mutex_clear(&io_connect_arg->mutex);
+	free(io_connect_arg);
+}
+
+static void io_connect_arg_unref(io_connect_arg_t* io_connect_arg) {
+	if (g_atomic_int_dec_and_test(&io_connect_arg->ref)) {
+		if (io_connect_arg->error) {
+			g_error_free(io_connect_arg->error);
+		}
+		g_main_context_unref(io_connect_arg->loop_context);
+		io_connect_arg_free(io_connect_arg);
+	}
+}
+
+/* Tell gattlib_connect() the attempt is over */
+static void io_connect_arg_complete(io_connect_arg_t* io_connect_arg) {
+	g_mutex_lock(&io_connect_arg->mutex);
+	g_atomic_int_set(&io_connect_arg->completed, TRUE);
+	g_cond_signal(&io_connect_arg->cond);
+	g_mutex_unlock(&io_connect_arg->mutex);
+}
+
+static void connection_release(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+	struct gattlib_thread_t* event_loop = conn_context->event_loop;
+
+	gattlib_event_loop_remove_fd(g_io_channel_unix_get_fd(conn_context->io));
+
+#if BLUEZ_VERSION_MAJOR == 4
+	// Stop the I/O Channel
+	g_io_channel_shutdown(conn_context->io, FALSE, NULL);
+	g_io_channel_unref(conn_context->io);
+#else
+	// Once created, GAttrib owns the socket
+	if (conn_context->attrib == NULL) {
+		g_io_channel_shutdown(conn_context->io, FALSE, NULL);
+		g_io_channel_unref(conn_context->io);
+	}
+#endif
+
+	gattlib_eatt_close(conn_context);
+	g_attrib_unref(conn_context->attrib);
+
+	if (conn_context->characteristic_by_handle != NULL) {
+		g_hash_table_destroy(conn_context->characteristic_by_handle);
+	}
+	free(conn_context->characteristics);
+	gattlib_read_coalescer_free(conn_context->read_coalescer);
+	gattlib_value_cache_free(conn_context->value_cache);
+	g_main_context_unref(conn_context->loop_context);
+	g_cond_clear(&conn_context->request_cond);
+	g_mutex_clear(&conn_context->request_mutex);
+	free(connection->context);
+	free(connection);
+
+	/* Decrease the reference counter of the loop. It stops the loop thread if it was the last connection. */
+	gattlib_event_loop_release(event_loop);
+}
+
+/* End the connection attempt. On failure, the connection is released. */
+static void connection_attempt_done(io_connect_arg_t* io_connect_arg, gboolean success) {
+	gatt_connection_t* conn = io_connect_arg->conn;
+
+	if (io_connect_arg->attempt_timeout != NULL) {
+		g_source_destroy(io_connect_arg->attempt_timeout);
+		g_source_unref(io_connect_arg->attempt_timeout);
+		io_connect_arg->attempt_timeout = NULL;
+	}
+
+	if (success) {
+		gattlib_context_t* conn_context = conn->context;
+
+		index_characteristics(conn_context);
+		conn_context->read_coalescer = gattlib_read_coalescer_new();
+		conn_context->value_cache = gattlib_value_cache_new();
+
+		io_connect_arg->connected = TRUE;
+	}
+
+	io_connect_arg_complete(io_connect_arg);
+
+	//
+	// Call callback if defined
+	//
+	if (io_connect_arg->connect_cb) {
+		io_connect_arg->connect_cb(success ? conn : NULL, io_connect_arg->user_data);
+	}
+
+	// The connection returned by gattlib_connect_async() stays valid until the callback has returned
+	if (!success) {
+		connection_release(conn);
+		io_connect_arg->conn = NULL;
+	}
+}
+
+static void connect_eatt_cb(gatt_connection_t* connection, void* user_data) {
 	io_connect_arg_t* io_connect_arg = user_data;
 
-	if (err) {
-		io_connect_arg->error = err;
+	connection_attempt_done(io_connect_arg, TRUE);
+	io_connect_arg_unref(io_connect_arg);
+}
+
+#if BLUEZ_VERSION_MAJOR == 4
+static void connect_discover_cb(GSList *characteristics, guint8 status, gpointer user_data) {
+#else
+static void connect_discover_cb(uint8_t status, GSList *characteristics, void *user_data) {
+#endif
+	io_connect_arg_t* io_connect_arg = user_data;
+	gattlib_context_t* conn_context = io_connect_arg->conn->context;
+
+	//
+	// Save list of characteristics to do the correspondence handle/UUID
+	//
+	if (status) {
+		fprintf(stderr, "Discover all characteristics failed: %s\n", att_ecode2str(status));
+	} else {
+		gattlib_characteristics_from_list(characteristics, &conn_context->characteristics, &conn_context->characteristic_count);
+	}
+
+	//
+	// Open the Enhanced ATT bearers. The discovery stays on the ATT fixed channel.
+	// The connection attempt completes once they are open.
+	//
+	if ((io_connect_arg->eatt_bearers > 0) &&
+	    (gattlib_eatt_open(io_connect_arg->conn, &io_connect_arg->sba, &io_connect_arg->dba, io_connect_arg->dest_type,
+			io_connect_arg->sec_level, io_connect_arg->eatt_bearers, connect_eatt_cb, io_connect_arg) == GATTLIB_SUCCESS))
+	{
+		return;
+	}
+
+	connection_attempt_done(io_connect_arg, TRUE);
+	io_connect_arg_unref(io_connect_arg);
+}
+
+static void connect_discover(io_connect_arg_t* io_connect_arg) {
+	gattlib_context_t* conn_context = io_connect_arg->conn->context;
+
+	if (gatt_discover_char(conn_context->attrib, 0x0001, 0xffff, NULL, connect_discover_cb, io_connect_arg) == 0) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Fail to discover characteristics.");
+		connection_attempt_done(io_connect_arg, TRUE);
+		io_connect_arg_unref(io_connect_arg);
+	}
+}
+
+static void connect_exchange_mtu_cb(guint8 status, const guint8 *pdu, guint16 plen, gpointer user_data) {
+	io_connect_arg_t* io_connect_arg = user_data;
+	gattlib_context_t* conn_context = io_connect_arg->conn->context;
+	uint16_t server_mtu;
+	uint16_t mtu = io_connect_arg->mtu;
+
+	// Only the MTU agreed by the server is applied. On failure, the link keeps ATT_DEFAULT_LE_MTU.
+	if (status) {
+		fprintf(stderr, "Exchange MTU failed: %s\n", att_ecode2str(status));
+	} else if (!dec_mtu_resp(pdu, plen, &server_mtu)) {
+		fprintf(stderr, "Exchange MTU failed: Protocol error\n");
+	} else if (server_mtu >= ATT_DEFAULT_LE_MTU) {
+		mtu = MIN(mtu, server_mtu);
+		// Let GAttrib use PDUs as large as the negotiated MTU
+		if ((mtu > ATT_DEFAULT_LE_MTU) && g_attrib_set_mtu(conn_context->attrib, mtu)) {
+			conn_context->mtu = mtu;
+		}
+	}
+
+	connect_discover(io_connect_arg);
+}
+
+/* Negotiate the ATT MTU. The connection establishment continues with the discovery. */
+static void connect_exchange_mtu(io_connect_arg_t* io_connect_arg) {
+	gattlib_context_t* conn_context = io_connect_arg->conn->context;
+
+#if BLUEZ_VERSION_MAJOR == 4
+	io_connect_arg->mtu = MIN(io_connect_arg->mtu, ATT_MAX_MTU);
+#else
+	io_connect_arg->mtu = MIN(io_connect_arg->mtu, BT_ATT_MAX_LE_MTU);
+#endif
+	if ((io_connect_arg->mtu <= ATT_DEFAULT_LE_MTU) ||
+	    (gatt_exchange_mtu(conn_context->attrib, io_connect_arg->mtu, connect_exchange_mtu_cb, io_connect_arg) == 0)) {
+		connect_discover(io_connect_arg);
+	}
+}
+
+static gboolean connection_attempt_timeout(gpointer user_data) {
+	io_connect_arg_t* io_connect_arg = user_data;
+	gattlib_context_t* conn_context = io_connect_arg->conn->context;
+
+	fprintf(stderr, "Connection attempt timed out\n");
 
-		// Call callback if defined
+	g_source_unref(io_connect_arg->attempt_timeout);
+	io_connect_arg->attempt_timeout = NULL;
+	io_connect_arg->timeout = TRUE;
+
+	if (conn_context->attrib == NULL) {
+		// The socket is still connecting. The connection is released when btio reports the end of the attempt.
+		io_connect_arg_complete(io_connect_arg);
 		if (io_connect_arg->connect_cb) {
 			io_connect_arg->connect_cb(NULL, io_connect_arg->user_data);
 		}
+	} else {
+		// Drop the pending ATT requests: their callbacks are not called anymore
+		g_attrib_cancel_all(conn_context->attrib);
+		connection_attempt_done(io_connect_arg, FALSE);
+		io_connect_arg_unref(io_connect_arg);
+	}
+
+	return FALSE;
+}
+
+static void io_connect_cb(GIOChannel *io, GError *err, gpointer user_data) {
+	io_connect_arg_t* io_connect_arg = user_data;
+
+	if (io_connect_arg->timeout) {
+		// The attempt has already been reported as failed
+		connection_release(io_connect_arg->conn);
+		io_connect_arg->conn = NULL;
+		io_connect_arg_unref(io_connect_arg);
+	} else if (err) {
+		io_connect_arg->error = g_error_copy(err);
+		connection_attempt_done(io_connect_arg, FALSE);
+		io_connect_arg_unref(io_connect_arg);
 	} else {
 		gattlib_context_t* conn_context = io_connect_arg->conn->context;
+#if BLUEZ_VERSION_MAJOR == 4
+		int buflen;
+#else
+		size_t buflen;
+#endif
 
 #if BLUEZ_VERSION_MAJOR == 4
 		conn_context->attrib = g_attrib_new(io);
@@ -134,6 +429,10 @@ static void io_connect_cb(GIOChannel *io, GError *err, gpointer user_data) {
 		conn_context->attrib = g_attrib_new(io, BT_ATT_DEFAULT_LE_MTU, false);
 #endif
 
+		// Start with the GAttrib buffer size. It is the L2CAP MTU on BR/EDR and the default ATT MTU on LE.
+		g_attrib_get_buffer(conn_context->attrib, &buflen);
+		conn_context->mtu = buflen;
+
 		//
 		// Register the listener callback
 		//
@@ -143,72 +442,33 @@ static void io_connect_cb(GIOChannel *io, GError *err, gpointer user_data) {
 		g_source_set_callback(source, io_listen_cb, io_connect_arg->conn, NULL);
 
 		// Attaches the listener to the main loop context
-		guint id = g_source_attach(source, g_gattlib_thread.loop_context);
+		guint id = g_source_attach(source, conn_context->loop_context);
 		g_source_unref (source);
 		assert(id != 0);
 
 		//
-		// Save list of characteristics to do the correspondence handle/UUID
-		//
-		gattlib_discover_char(io_connect_arg->conn, &conn_context->characteristics, &conn_context->characteristic_count);
-
-		//
-		// Call callback if defined
+		// The ATT MTU exchange and the discovery are asynchronous. Other connections progress meanwhile.
 		//
-		if (io_connect_arg->connect_cb) {
-			io_connect_arg->connect_cb(io_connect_arg->conn, io_connect_arg->user_data);
+		if (io_connect_arg->mtu > 0) {
+			connect_exchange_mtu(io_connect_arg);
+		} else {
+			connect_discover(io_connect_arg);
 		}
-
-		io_connect_arg->connected = TRUE;
-	}
-	if (io_connect_arg->connect_cb) {
-		free(io_connect_arg);
 	}
 }
 
-static void *connection_thread(void* arg) {
-	struct gattlib_thread_t* loop_thread = arg;
-
-	loop_thread->loop_context = g_main_context_new();
-	loop_thread->loop = g_main_loop_new(loop_thread->loop_context, TRUE);
-
-	g_main_loop_run(loop_thread->loop);
-	g_main_loop_unref(loop_thread->loop);
-	assert(0);
-	return NULL;
-}
-
 static gatt_connection_t *initialize_gattlib_connection(const gchar *src, const gchar *dst,
-		uint8_t dest_type, BtIOSecLevel sec_level, int psm, int mtu,
-		gatt_connect_cb_t connect_cb,
+		uint8_t dest_type, BtIOSecLevel sec_level, int psm, int mtu, int eatt_bearers, int event_loop_hint,
+		gatt_connect_cb_t connect_cb, bool sync_waiter,
 		io_connect_arg_t* io_connect_arg)
 {
 	bdaddr_t sba, dba;
+	GMainContext *previous_context;
 	GError *err = NULL;
 	int ret;
 
 	io_connect_arg->error = NULL;
 
-	/* Check if the GattLib thread has been started */
-	if (g_gattlib_thread.ref == 0) {
-		/* Start it */
-
-		/* Create a thread that will handle Bluetooth events */
-		int error = pthread_create(&g_gattlib_thread.thread, NULL, &connection_thread, &g_gattlib_thread);
-		if (error != 0) {
-			fprintf(stderr, "Cannot create connection thread: %s", strerror(error));
-			return NULL;
-		}
-
-		/* Wait for the loop to be started */
-		while (!g_gattlib_thread.loop || !g_main_loop_is_running (g_gattlib_thread.loop)) {
-			usleep(1000);
-		}
-	} else {
-		/* Increase the reference to know how many GATT connection use the loop */
-		g_gattlib_thread.ref++;
-	}
-
 	/* Remote device */
 	if (dst == NULL) {
 		fprintf(stderr, "Remote Bluetooth address required\n");
@@ -249,6 +509,7 @@ static gatt_connection_t *initialize_gattlib_connection(const gchar *src, const
 	if (conn_context == NULL) {
 		return NULL;
 	}
+	gattlib_link_info_init(&conn_context->link_info);
 
 	gatt_connection_t* conn = calloc(sizeof(gatt_connection_t), 1);
 	if (conn == NULL) {
@@ -256,14 +517,45 @@ static gatt_connection_t *initialize_gattlib_connection(const gchar *src, const
 		return NULL;
 	}
 
+	/* Assign the connection to an event loop. It starts the event loop thread if needed. */
+	conn_context->event_loop = gattlib_event_loop_acquire(event_loop_hint);
+	if (conn_context->event_loop == NULL) {
+		free(conn_context);
+		free(conn);
+		return NULL;
+	}
+	conn_context->loop_context = g_main_context_ref(conn_context->event_loop->loop_context);
+	g_mutex_init(&conn_context->request_mutex);
+	g_cond_init(&conn_context->request_cond);
+
 	conn->context = conn_context;
 
 	/* Intialize bt_io_connect argument */
+	// gattlib_connect() keeps a reference to wait for the end of the attempt
+	io_connect_arg->ref        = sync_waiter ? 2 : 1;
 	io_connect_arg->conn       = conn;
 	io_connect_arg->connect_cb = connect_cb;
+	io_connect_arg->completed  = FALSE;
 	io_connect_arg->connected  = FALSE;
 	io_connect_arg->timeout    = FALSE;
 	io_connect_arg->error      = NULL;
+	// The ATT MTU is only exchanged on the LE fixed channel
+	io_connect_arg->mtu        = (psm == 0) ? (mtu ? mtu : GATTLIB_DEFAULT_ATT_MTU) : 0;
+	// Enhanced ATT bearers are only opened alongside the LE fixed channel
+	io_connect_arg->eatt_bearers = (psm == 0) ? eatt_bearers : 0;
+	io_connect_arg->dest_type  = dest_type;
+	io_connect_arg->sec_level  = sec_level;
+	bacpy(&io_connect_arg->sba, &sba);
+	bacpy(&io_connect_arg->dba, &dba);
+
+	// The connection socket does not exist yet, its watch is attached to the event loop of the calling thread
+	previous_context = gattlib_event_loop_set_current(conn_context->loop_context);
+
+	// Bound the whole connection attempt: socket connection, ATT MTU exchange, discovery and Enhanced ATT bearers
+	io_connect_arg->loop_context = g_main_context_ref(conn_context->loop_context);
+	io_connect_arg->attempt_timeout = g_source_ref(
+			gattlib_timeout_add_seconds(io_connect_arg->loop_context, g_atomic_int_get(&m_connection_attempt_timeout),
+					connection_attempt_timeout, io_connect_arg));
 
 	if (psm == 0) {
 		conn_context->io = bt_io_connect(
@@ -299,18 +591,29 @@ static gatt_connection_t *initialize_gattlib_connection(const gchar *src, const
 				BT_IO_OPT_INVALID);
 	}
 
+	gattlib_event_loop_set_current(previous_context);
+
 	if (err) {
 		fprintf(stderr, "%s\n", err->message);
 		g_error_free(err);
+		g_source_destroy(io_connect_arg->attempt_timeout);
+		g_source_unref(io_connect_arg->attempt_timeout);
+		g_main_context_unref(io_connect_arg->loop_context);
+		g_main_context_unref(conn_context->loop_context);
+		g_cond_clear(&conn_context->request_cond);
+		g_mutex_clear(&conn_context->request_mutex);
+		gattlib_event_loop_release(conn_context->event_loop);
 		free(conn_context);
 		free(conn);
 		return NULL;
 	} else {
+		gattlib_event_loop_add_fd(g_io_channel_unix_get_fd(conn_context->io), conn_context->loop_context);
 		return conn;
 	}
 }
 
-static void get_connection_options(unsigned long options, BtIOSecLevel *bt_io_sec_level, int *psm, int *mtu) {
+static void get_connection_options(unsigned long options, BtIOSecLevel *bt_io_sec_level, int *psm, int *mtu, int *eatt_bearers,
+		int *event_loop_hint) {
 	if (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BT_SEC_LOW) {
 		*bt_io_sec_level = BT_IO_SEC_LOW;
 	} else if (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BT_SEC_MEDIUM) {
@@ -323,6 +626,8 @@ static void get_connection_options(unsigned long options, BtIOSecLevel *bt_io_se
 
 	*psm = GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_PSM(options);
 	*mtu = GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_MTU(options);
+	*eatt_bearers = GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_EATT_BEARERS(options);
+	*event_loop_hint = GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_EVENT_LOOP(options);
 }
 
 gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
@@ -330,14 +635,14 @@ gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
 				gatt_connect_cb_t connect_cb, void* data)
 {
 	const char *adapter_mac_address;
+	char adapter_name[16];
 	gatt_connection_t *conn;
 	BtIOSecLevel bt_io_sec_level;
-	int psm, mtu;
+	int psm, mtu, eatt_bearers, event_loop_hint;
 
 	if (adapter != NULL) {
-		fprintf(stderr, "Missing support");
-		assert(0); // Need to add support
-		return NULL;
+		snprintf(adapter_name, sizeof(adapter_name), "hci%d", ((struct gattlib_adapter*)adapter)->dev_id);
+		adapter_mac_address = adapter_name;
 	} else {
 		adapter_mac_address = NULL;
 	}
@@ -350,36 +655,30 @@ gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
 		return NULL;
 	}
 
-	get_connection_options(options, &bt_io_sec_level, &psm, &mtu);
+	get_connection_options(options, &bt_io_sec_level, &psm, &mtu, &eatt_bearers, &event_loop_hint);
 
-	io_connect_arg_t* io_connect_arg = malloc(sizeof(io_connect_arg_t));
+	io_connect_arg_t* io_connect_arg = io_connect_arg_new(data);
 	if (io_connect_arg == NULL) {
 		return NULL;
 	}
-	io_connect_arg->user_data = data;
 
+	conn = NULL;
 	if (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_PUBLIC) {
 		conn = initialize_gattlib_connection(adapter_mac_address, dst, BDADDR_LE_PUBLIC, bt_io_sec_level,
-						     psm, mtu, connect_cb, io_connect_arg);
-		if (conn != NULL) {
-			return conn;
-		}
+						     psm, mtu, eatt_bearers, event_loop_hint, connect_cb, false, io_connect_arg);
 	}
 
-	if (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM) {
+	if ((conn == NULL) && (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM)) {
 		conn = initialize_gattlib_connection(adapter_mac_address, dst, BDADDR_LE_RANDOM, bt_io_sec_level,
-						     psm, mtu, connect_cb, io_connect_arg);
+						     psm, mtu, eatt_bearers, event_loop_hint, connect_cb, false, io_connect_arg);
 	}
 
-	return conn;
-}
-
-static gboolean connection_timeout(gpointer user_data) {
-	io_connect_arg_t* io_connect_arg = user_data;
-
-	io_connect_arg->timeout = TRUE;
+	// Once initialized, the connection attempt owns 'io_connect_arg'
+	if (conn == NULL) {
+		io_connect_arg_free(io_connect_arg);
+	}
 
-	return FALSE;
+	return conn;
 }
 
 /**
@@ -391,46 +690,54 @@ static gboolean connection_timeout(gpointer user_data) {
  * @param sec_level    Set security level (either BT_IO_SEC_LOW, BT_IO_SEC_MEDIUM, BT_IO_SEC_HIGH)
  * @param psm          Specify the PSM for GATT/ATT over BR/EDR
  * @param mtu          Specify the MTU size
+ * @param eatt_bearers Number of Enhanced ATT bearers to open
+ * @param event_loop_hint Event loop to assign the connection to. -1 to let gattlib pick one
  */
 static gatt_connection_t *gattlib_connect_with_options(const char *src, const char *dst,
-						       uint8_t dest_type, BtIOSecLevel bt_io_sec_level, int psm, int mtu)
+						       uint8_t dest_type, BtIOSecLevel bt_io_sec_level, int psm, int mtu,
+						       int eatt_bearers, int event_loop_hint)
 {
-	GSource* timeout;
 	gatt_connection_t *conn;
-	io_connect_arg_t io_connect_arg;
+	io_connect_arg_t* io_connect_arg;
 
-	conn = initialize_gattlib_connection(src, dst, dest_type, bt_io_sec_level,
-			psm, mtu, NULL, &io_connect_arg);
-	if (conn == NULL) {
-		if (io_connect_arg.error) {
-			fprintf(stderr, "Error: gattlib_connect - initialization error:%s\n", io_connect_arg.error->message);
-		} else {
-			fprintf(stderr, "Error: gattlib_connect - initialization\n");
-		}
+	io_connect_arg = io_connect_arg_new(NULL);
+	if (io_connect_arg == NULL) {
 		return NULL;
 	}
 
-	// Timeout of 'CONNECTION_TIMEOUT+4' seconds
-	timeout = gattlib_timeout_add_seconds(CONNECTION_TIMEOUT + 4, connection_timeout, &io_connect_arg);
-
-	// Wait for the connection to be done
-	while ((io_connect_arg.connected == FALSE) && (io_connect_arg.timeout == FALSE)) {
-		g_main_context_iteration(g_gattlib_thread.loop_context, FALSE);
+	conn = initialize_gattlib_connection(src, dst, dest_type, bt_io_sec_level,
+			psm, mtu, eatt_bearers, event_loop_hint, NULL, true, io_connect_arg);
+	if (conn == NULL) {
+		fprintf(stderr, "Error: gattlib_connect - initialization\n");
+		io_connect_arg_free(io_connect_arg);
+		return NULL;
 	}
-	
-	// Disconnect the timeout source if connection success
-	if (io_connect_arg.connected) g_source_destroy(timeout);
 
-	if (io_connect_arg.timeout) {
-		return NULL;
+	// Wait for the connection attempt to be done. It ends by itself when it times out.
+	if (g_main_context_is_owner(io_connect_arg->loop_context)) {
+		// Called from the event loop running the attempt (eg: from a notification handler): run it from here
+		while (!g_atomic_int_get(&io_connect_arg->completed)) {
+			g_main_context_iteration(io_connect_arg->loop_context, TRUE);
+		}
+	} else {
+		g_mutex_lock(&io_connect_arg->mutex);
+		while (!g_atomic_int_get(&io_connect_arg->completed)) {
+			g_cond_wait(&io_connect_arg->cond, &io_connect_arg->mutex);
+		}
+		g_mutex_unlock(&io_connect_arg->mutex);
 	}
 
-	if (io_connect_arg.error) {
-		fprintf(stderr, "gattlib_connect - connection error:%s\n", io_connect_arg.error->message);
-		return NULL;
+	if (io_connect_arg->connected) {
+		conn = io_connect_arg->conn;
 	} else {
-		return conn;
+		if (io_connect_arg->error) {
+			fprintf(stderr, "gattlib_connect - connection error:%s\n", io_connect_arg->error->message);
+		}
+		conn = NULL;
 	}
+
+	io_connect_arg_unref(io_connect_arg);
+	return conn;
 }
 
 
@@ -444,14 +751,14 @@ static gatt_connection_t *gattlib_connect_with_options(const char *src, const ch
 gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long options)
 {
 	const char* adapter_mac_address;
+	char adapter_name[16];
 	gatt_connection_t *conn;
 	BtIOSecLevel bt_io_sec_level;
-	int psm, mtu;
+	int psm, mtu, eatt_bearers, event_loop_hint;
 
 	if (adapter != NULL) {
-		fprintf(stderr, "Missing support");
-		assert(0); // Need to add support
-		return NULL;
+		snprintf(adapter_name, sizeof(adapter_name), "hci%d", ((struct gattlib_adapter*)adapter)->dev_id);
+		adapter_mac_address = adapter_name;
 	} else {
 		adapter_mac_address = NULL;
 	}
@@ -464,89 +771,95 @@ gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long
 		return NULL;
 	}
 
-	get_connection_options(options, &bt_io_sec_level, &psm, &mtu);
+	get_connection_options(options, &bt_io_sec_level, &psm, &mtu, &eatt_bearers, &event_loop_hint);
 
 	if (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_PUBLIC) {
-		conn = gattlib_connect_with_options(adapter_mac_address, dst, BDADDR_LE_PUBLIC, bt_io_sec_level, psm, mtu);
+		conn = gattlib_connect_with_options(adapter_mac_address, dst, BDADDR_LE_PUBLIC, bt_io_sec_level, psm, mtu, eatt_bearers, event_loop_hint);
 		if (conn != NULL) {
 			return conn;
 		}
 	}
 
 	if (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM) {
-		conn = gattlib_connect_with_options(adapter_mac_address, dst, BDADDR_LE_RANDOM, bt_io_sec_level, psm, mtu);
+		conn = gattlib_connect_with_options(adapter_mac_address, dst, BDADDR_LE_RANDOM, bt_io_sec_level, psm, mtu, eatt_bearers, event_loop_hint);
 	}
 
 	return conn;
 }
 
 int gattlib_disconnect(gatt_connection_t* connection) {
-	gattlib_context_t* conn_context = connection->context;
+	connection_release(connection);
+	return GATTLIB_SUCCESS;
+}
 
-#if BLUEZ_VERSION_MAJOR == 4
-	// Stop the I/O Channel
-	GIOStatus status = g_io_channel_shutdown(conn_context->io, FALSE, NULL);
-	assert(status == G_IO_STATUS_NORMAL);
-	g_io_channel_unref(conn_context->io);
-#endif
+int gattlib_set_connection_attempt_timeout(unsigned int timeout_s) {
+	if ((timeout_s == 0) || (timeout_s > G_MAXINT)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
 
-	g_attrib_unref(conn_context->attrib);
+	g_atomic_int_set(&m_connection_attempt_timeout, (gint)timeout_s);
+	return GATTLIB_SUCCESS;
+}
 
-	free(conn_context->characteristics);
-	free(connection->context);
-	free(connection);
+int gattlib_connection_set_reconnect_policy(gatt_connection_t* connection, const gattlib_reconnect_policy_t *policy) {
+	// The loss of the link is not detected with this backend
+	return GATTLIB_NOT_SUPPORTED;
+}
 
-	//TODO: Add a mutex around this code to avoid a race condition
-	/* Decrease the reference counter of the loop */
-	g_gattlib_thread.ref--;
-	/* Check if we are the last one */
-	if (g_gattlib_thread.ref == 0) {
-		g_main_loop_quit(g_gattlib_thread.loop);
-		g_main_loop_unref(g_gattlib_thread.loop);
-		g_main_context_unref(g_gattlib_thread.loop_context);
+int gattlib_connection_set_timeout(gatt_connection_t* connection, unsigned int timeout_ms) {
+	gattlib_context_t* conn_context;
 
-		// Detach the thread
-		pthread_detach(g_gattlib_thread.thread);
+	if ((connection == NULL) || (timeout_ms > G_MAXINT)) {
+		return GATTLIB_INVALID_PARAMETER;
 	}
+	conn_context = connection->context;
 
+	g_atomic_int_set(&conn_context->operation_timeout_ms, (gint)timeout_ms);
 	return GATTLIB_SUCCESS;
 }
 
-GSource* gattlib_watch_connection_full(GIOChannel* io, GIOCondition condition,
-								 GIOFunc func, gpointer user_data, GDestroyNotify notify)
-{
-	// Create a main loop source
-	GSource *source = g_io_create_watch (io, condition);
-	assert(source != NULL);
-
-	g_source_set_callback (source, (GSourceFunc)func, user_data, notify);
+int gattlib_connection_cancel(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context;
 
-	// Attaches it to the main loop context
-	guint id = g_source_attach(source, g_gattlib_thread.loop_context);
-	g_source_unref (source);
-	assert(id != 0);
+	if (connection == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
 
-	return source;
+	gattlib_request_cancel_all(conn_context);
+	return GATTLIB_SUCCESS;
 }
 
-GSource* gattlib_timeout_add_seconds(guint interval, GSourceFunc function, gpointer data) {
-	GSource *source = g_timeout_source_new_seconds(interval);
-	assert(source != NULL);
+int gattlib_connection_set_value_cache(gatt_connection_t* connection, unsigned int ttl_ms) {
+	gattlib_context_t* conn_context;
 
-	g_source_set_callback(source, function, data, NULL);
+	if (connection == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
 
-	// Attaches it to the main loop context
-	guint id = g_source_attach(source, g_gattlib_thread.loop_context);
-	g_source_unref (source);
-	assert(id != 0);
+	if (conn_context->value_cache == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
 
-	return source;
+	gattlib_value_cache_set_ttl(conn_context->value_cache, ttl_ms);
+	return GATTLIB_SUCCESS;
 }
 
 int get_uuid_from_handle(gatt_connection_t* connection, uint16_t handle, uuid_t* uuid) {
 	gattlib_context_t* conn_context = connection->context;
+	gattlib_characteristic_t* characteristic;
 	int i;
 
+	if (conn_context->characteristic_by_handle != NULL) {
+		characteristic = g_hash_table_lookup(conn_context->characteristic_by_handle, GUINT_TO_POINTER(handle));
+		if (characteristic == NULL) {
+			return GATTLIB_NOT_FOUND;
+		}
+		memcpy(uuid, &characteristic->uuid, sizeof(uuid_t));
+		return GATTLIB_SUCCESS;
+	}
+
 	for (i = 0; i < conn_context->characteristic_count; i++) {
 		if (conn_context->characteristics[i].value_handle == handle) {
 			memcpy(uuid, &conn_context->characteristics[i].uuid, sizeof(uuid_t));
@@ -569,6 +882,18 @@ int get_handle_from_uuid(gatt_connection_t* connection, const uuid_t* uuid, uint
 	return GATTLIB_NOT_FOUND;
 }
 
+int gattlib_get_mtu(gatt_connection_t* connection, uint16_t *mtu) {
+	gattlib_context_t* conn_context;
+
+	if ((connection == NULL) || (mtu == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	conn_context = connection->context;
+	*mtu = conn_context->mtu;
+	return GATTLIB_SUCCESS;
+}
+
 #if 0 // Disable until https://github.com/labapart/gattlib/issues/75 is resolved
 int gattlib_get_rssi(gatt_connection_t *connection, int16_t *rssi)
 {
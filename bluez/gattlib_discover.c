@@ -33,6 +33,7 @@
 #include "gatt.h"
 
 struct primary_all_cb_t {
+	gattlib_context_t* conn_context;
 	gattlib_primary_service_t* services;
 	int services_count;
 	int discovered;
@@ -71,27 +72,27 @@ static void primary_all_cb(uint8_t status, GSList *services, void *user_data) {
 	}
 
 done:
-	data->discovered = TRUE;
+	gattlib_request_complete(data->conn_context, &data->discovered);
 }
 
 int gattlib_discover_primary(gatt_connection_t* connection, gattlib_primary_service_t** services, int* services_count) {
 	struct primary_all_cb_t user_data;
 	guint ret;
 
+	gattlib_context_t* conn_context = connection->context;
+
 	bzero(&user_data, sizeof(user_data));
+	user_data.conn_context   = conn_context;
 	user_data.discovered     = FALSE;
 
-	gattlib_context_t* conn_context = connection->context;
 	ret = gatt_discover_primary(conn_context->attrib, NULL, primary_all_cb, &user_data);
 	if (ret == 0) {
 		GATTLIB_LOG(GATTLIB_ERROR, "Fail to discover primary services.");
 		return GATTLIB_ERROR_BLUEZ;
 	}
 
-	// Wait for completion
-	while(user_data.discovered == FALSE) {
-		g_main_context_iteration(g_gattlib_thread.loop_context, FALSE);
-	}
+	// Wait for completion. The discovery cannot be abandoned: the callback uses 'user_data'.
+	gattlib_request_wait(conn_context, &user_data.discovered, 0, -1);
 
 	if (services != NULL) {
 		*services = user_data.services;
@@ -103,7 +104,33 @@ int gattlib_discover_primary(gatt_connection_t* connection, gattlib_primary_serv
 	return GATTLIB_SUCCESS;
 }
 
+int gattlib_characteristics_from_list(GSList *list, gattlib_characteristic_t** characteristics, int* characteristics_count) {
+	GSList *l;
+	int i;
+
+	// Allocate array
+	*characteristics_count = g_slist_length(list);
+	*characteristics = malloc(*characteristics_count * sizeof(gattlib_characteristic_t));
+	if (*characteristics == NULL) {
+		fprintf(stderr, "Discover all characteristics failed: OutOfMemory\n");
+		*characteristics_count = 0;
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	for (i = 0, l = list; l; l = l->next, i++) {
+		struct gatt_char *chars = l->data;
+
+		(*characteristics)[i].handle       = chars->handle;
+		(*characteristics)[i].properties   = chars->properties;
+		(*characteristics)[i].value_handle = chars->value_handle;
+		gattlib_string_to_uuid(chars->uuid, MAX_LEN_UUID_STR + 1, &(*characteristics)[i].uuid);
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
 struct characteristic_cb_t {
+	gattlib_context_t* conn_context;
 	gattlib_characteristic_t* characteristics;
 	int characteristics_count;
 	int discovered;
@@ -115,55 +142,34 @@ static void characteristic_cb(GSList *characteristics, guint8 status, gpointer u
 static void characteristic_cb(uint8_t status, GSList *characteristics, void *user_data) {
 #endif
 	struct characteristic_cb_t* data = user_data;
-	GSList *l;
-	int i;
 
 	if (status) {
 		fprintf(stderr, "Discover all characteristics failed: %s\n", att_ecode2str(status));
-		goto done;
-	}
-
-	// Allocate array
-	data->characteristics_count = g_slist_length(characteristics);
-	data->characteristics = malloc(data->characteristics_count * sizeof(gattlib_characteristic_t));
-	if (data->characteristics == NULL) {
-		fprintf(stderr, "Discover all characteristics failed: OutOfMemory\n");
-		goto done;
-	}
-
-	for (i = 0, l = characteristics; l; l = l->next, i++) {
-		struct gatt_char *chars = l->data;
-
-		data->characteristics[i].handle       = chars->handle;
-		data->characteristics[i].properties   = chars->properties;
-		data->characteristics[i].value_handle = chars->value_handle;
-		gattlib_string_to_uuid(chars->uuid, MAX_LEN_UUID_STR + 1, &data->characteristics[i].uuid);
-
-		assert(i < data->characteristics_count);
+	} else {
+		gattlib_characteristics_from_list(characteristics, &data->characteristics, &data->characteristics_count);
 	}
 
-done:
-	data->discovered = TRUE;
+	gattlib_request_complete(data->conn_context, &data->discovered);
 }
 
 int gattlib_discover_char_range(gatt_connection_t* connection, int start, int end, gattlib_characteristic_t** characteristics, int* characteristics_count) {
 	struct characteristic_cb_t user_data;
 	guint ret;
 
+	gattlib_context_t* conn_context = connection->context;
+
 	bzero(&user_data, sizeof(user_data));
+	user_data.conn_context   = conn_context;
 	user_data.discovered     = FALSE;
 
-	gattlib_context_t* conn_context = connection->context;
 	ret = gatt_discover_char(conn_context->attrib, start, end, NULL, characteristic_cb, &user_data);
 	if (ret == 0) {
 		GATTLIB_LOG(GATTLIB_ERROR, "Fail to discover characteristics.");
 		return GATTLIB_ERROR_BLUEZ;
 	}
 
-	// Wait for completion
-	while(user_data.discovered == FALSE) {		
-		g_main_context_iteration(g_gattlib_thread.loop_context, FALSE);
-	}
+	// Wait for completion. The discovery cannot be abandoned: the callback uses 'user_data'.
+	gattlib_request_wait(conn_context, &user_data.discovered, 0, -1);
 	*characteristics       = user_data.characteristics;
 	*characteristics_count = user_data.characteristics_count;
 
@@ -175,6 +181,7 @@ int gattlib_discover_char(gatt_connection_t* connection, gattlib_characteristic_
 }
 
 struct descriptor_cb_t {
+	gattlib_context_t* conn_context;
 	gattlib_descriptor_t* descriptors;
 	int descriptors_count;
 	int discovered;
@@ -227,7 +234,7 @@ static void char_desc_cb(guint8 status, const guint8 *pdu, guint16 plen, gpointe
 	att_data_list_free(list);
 
 done:
-	data->discovered = TRUE;
+	gattlib_request_complete(data->conn_context, &data->discovered);
 }
 #else
 static void char_desc_cb(uint8_t status, GSList *descriptors, void *user_data)
@@ -260,7 +267,7 @@ static void char_desc_cb(uint8_t status, GSList *descriptors, void *user_data)
 	}
 
 done:
-	data->discovered = TRUE;
+	gattlib_request_complete(data->conn_context, &data->discovered);
 }
 #endif
 
@@ -270,6 +277,7 @@ int gattlib_discover_desc_range(gatt_connection_t* connection, int start, int en
 	guint ret;
 
 	bzero(&descriptor_data, sizeof(descriptor_data));
+	descriptor_data.conn_context = conn_context;
 
 #if BLUEZ_VERSION_MAJOR == 4
 	ret = gatt_find_info(conn_context->attrib, start, end, char_desc_cb, &descriptor_data);
@@ -281,10 +289,8 @@ int gattlib_discover_desc_range(gatt_connection_t* connection, int start, int en
 		return GATTLIB_ERROR_BLUEZ;
 	}
 
-	// Wait for completion
-	while(descriptor_data.discovered == FALSE) {
-		g_main_context_iteration(g_gattlib_thread.loop_context, FALSE);
-	}
+	// Wait for completion. The discovery cannot be abandoned: the callback uses 'descriptor_data'.
+	gattlib_request_wait(conn_context, &descriptor_data.discovered, 0, -1);
 
 	*descriptors      = descriptor_data.descriptors;
 	*descriptor_count = descriptor_data.descriptors_count;
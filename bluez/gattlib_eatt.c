@@ -0,0 +1,377 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2021 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/l2cap.h>
+
+#include "gattlib_internal.h"
+
+#include "att.h"
+#include "gattrib.h"
+#include "gatt.h"
+
+#ifndef BT_SNDMTU
+  #define BT_SNDMTU             12
+#endif
+#ifndef BT_RCVMTU
+  #define BT_RCVMTU             13
+#endif
+#ifndef BT_MODE
+  #define BT_MODE               15
+  #define BT_MODE_EXT_FLOWCTL   0x04
+#endif
+
+// LE PSM of the Enhanced ATT bearers
+#define EATT_PSM                          0x0027
+
+// 'Server Supported Features' characteristic: the server supports Enhanced ATT bearers
+#define GATT_SERVER_FEATURE_EATT          (1 << 0)
+// 'Client Supported Features' characteristic: the client supports Enhanced ATT bearers
+#define GATT_CLIENT_FEATURE_EATT          (1 << 1)
+
+static const uuid_t m_server_supported_features_uuid = CREATE_UUID16(0x2B3A);
+static const uuid_t m_client_supported_features_uuid = CREATE_UUID16(0x2B29);
+
+//
+// The Enhanced ATT bearers are opened from the event loop of the connection once the discovery has completed.
+// Each step is asynchronous, like the ATT MTU exchange and the discovery: the event loop is never blocked.
+//
+struct gattlib_eatt_open {
+	gatt_connection_t*     connection;
+	bdaddr_t               src;
+	bdaddr_t               dst;
+	uint8_t                dst_type;
+	int                    sec_level;
+	int                    count;
+	// Pending ATT request of the feature negotiation
+	guint                  request_id;
+	// Channel being connected and its watch
+	GIOChannel*            io;
+	GSource*               watch;
+	gattlib_eatt_open_cb_t cb;
+	void*                  user_data;
+};
+
+static void eatt_connect_next(struct gattlib_eatt_open* eatt_open);
+
+static void eatt_open_done(struct gattlib_eatt_open* eatt_open) {
+	gatt_connection_t* connection = eatt_open->connection;
+	gattlib_context_t* conn_context = connection->context;
+
+	conn_context->eatt_open = NULL;
+	eatt_open->cb(connection, eatt_open->user_data);
+	free(eatt_open);
+}
+
+static void eatt_open_abort(struct gattlib_eatt_open* eatt_open) {
+	if (eatt_open->watch != NULL) {
+		g_source_destroy(eatt_open->watch);
+		g_source_unref(eatt_open->watch);
+	}
+	if (eatt_open->io != NULL) {
+		gattlib_event_loop_remove_fd(g_io_channel_unix_get_fd(eatt_open->io));
+		g_io_channel_unref(eatt_open->io);
+	}
+	free(eatt_open);
+}
+
+/* Start to open a L2CAP channel in Enhanced Credit Based mode to the EATT PSM */
+static int eatt_connect(const bdaddr_t *src, const bdaddr_t *dst, uint8_t dst_type, int sec_level) {
+	struct sockaddr_l2 addr;
+	struct bt_security sec = { .level = sec_level };
+	uint8_t mode = BT_MODE_EXT_FLOWCTL;
+	int fd;
+
+	fd = socket(PF_BLUETOOTH, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, BTPROTO_L2CAP);
+	if (fd < 0) {
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.l2_family = AF_BLUETOOTH;
+	addr.l2_bdaddr_type = BDADDR_LE_PUBLIC;
+	bacpy(&addr.l2_bdaddr, src);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		goto ERROR;
+	}
+
+	// The kernel only supports the Enhanced Credit Based mode when it is enabled (see 'enable_ecred')
+	if (setsockopt(fd, SOL_BLUETOOTH, BT_MODE, &mode, sizeof(mode)) < 0) {
+		goto ERROR;
+	}
+	if ((sec_level > BT_SECURITY_SDP) && (setsockopt(fd, SOL_BLUETOOTH, BT_SECURITY, &sec, sizeof(sec)) < 0)) {
+		goto ERROR;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.l2_family = AF_BLUETOOTH;
+	addr.l2_psm = htobs(EATT_PSM);
+	addr.l2_bdaddr_type = dst_type;
+	bacpy(&addr.l2_bdaddr, dst);
+	if ((connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) && (errno != EINPROGRESS)) {
+		goto ERROR;
+	}
+
+	return fd;
+
+ERROR:
+	close(fd);
+	return -1;
+}
+
+/* The ATT MTU of an Enhanced ATT bearer is the L2CAP MTU of the channel */
+static int eatt_get_mtu(int fd, uint16_t *mtu) {
+	uint16_t tx_mtu, rx_mtu;
+	socklen_t len;
+	int err = 0;
+
+	len = sizeof(err);
+	if ((getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) || (err != 0)) {
+		if (err != 0) {
+			errno = err;
+		}
+		return -1;
+	}
+
+	len = sizeof(tx_mtu);
+	if (getsockopt(fd, SOL_BLUETOOTH, BT_SNDMTU, &tx_mtu, &len) < 0) {
+		return -1;
+	}
+	len = sizeof(rx_mtu);
+	if (getsockopt(fd, SOL_BLUETOOTH, BT_RCVMTU, &rx_mtu, &len) < 0) {
+		return -1;
+	}
+	*mtu = MIN(tx_mtu, rx_mtu);
+
+	return 0;
+}
+
+static gboolean eatt_connected_cb(GIOChannel *io, GIOCondition cond, gpointer user_data) {
+	struct gattlib_eatt_open* eatt_open = user_data;
+	gattlib_context_t* conn_context = eatt_open->connection->context;
+	struct gattlib_att_bearer* bearer = &conn_context->eatt_bearers[conn_context->eatt_bearer_count];
+	int fd = g_io_channel_unix_get_fd(io);
+	uint16_t mtu;
+
+	g_source_unref(eatt_open->watch);
+	eatt_open->watch = NULL;
+	// From now, the channel belongs to the bearer
+	eatt_open->io = NULL;
+
+	if (eatt_get_mtu(fd, &mtu) < 0) {
+		fprintf(stderr, "Fail to open Enhanced ATT bearer: %s\n", strerror(errno));
+		gattlib_event_loop_remove_fd(fd);
+		g_io_channel_unref(io);
+		eatt_open_done(eatt_open);
+		return FALSE;
+	}
+
+#if BLUEZ_VERSION_MAJOR == 4
+	mtu = MIN(mtu, ATT_MAX_MTU);
+#else
+	mtu = MIN(mtu, BT_ATT_MAX_LE_MTU);
+#endif
+
+	bearer->connection = eatt_open->connection;
+	bearer->io = io;
+#if BLUEZ_VERSION_MAJOR == 4
+	bearer->attrib = g_attrib_new(bearer->io);
+	if ((bearer->attrib != NULL) && !g_attrib_set_mtu(bearer->attrib, mtu)) {
+		g_attrib_unref(bearer->attrib);
+		bearer->attrib = NULL;
+	}
+#else
+	bearer->attrib = g_attrib_new(bearer->io, mtu, false);
+#endif
+	if (bearer->attrib == NULL) {
+		gattlib_event_loop_remove_fd(fd);
+		g_io_channel_unref(bearer->io);
+		eatt_open_done(eatt_open);
+		return FALSE;
+	}
+
+	gattlib_att_bearer_listen(bearer);
+	conn_context->eatt_bearer_count++;
+
+	eatt_connect_next(eatt_open);
+	return FALSE;
+}
+
+/* Open the next bearer. The bearers are opened one after the other. */
+static void eatt_connect_next(struct gattlib_eatt_open* eatt_open) {
+	gattlib_context_t* conn_context = eatt_open->connection->context;
+	int fd;
+
+	if (conn_context->eatt_bearer_count >= eatt_open->count) {
+		eatt_open_done(eatt_open);
+		return;
+	}
+
+	fd = eatt_connect(&eatt_open->src, &eatt_open->dst, eatt_open->dst_type, eatt_open->sec_level);
+	if (fd < 0) {
+		fprintf(stderr, "Fail to open Enhanced ATT bearer: %s\n", strerror(errno));
+		eatt_open_done(eatt_open);
+		return;
+	}
+
+	gattlib_event_loop_add_fd(fd, conn_context->loop_context);
+	eatt_open->io = g_io_channel_unix_new(fd);
+	g_io_channel_set_close_on_unref(eatt_open->io, TRUE);
+
+	// The socket becomes writable once the channel is connected or has failed
+	eatt_open->watch = g_source_ref(gattlib_watch_connection_full(eatt_open->io,
+			G_IO_OUT | G_IO_ERR | G_IO_HUP | G_IO_NVAL, eatt_connected_cb, eatt_open, NULL));
+}
+
+static void eatt_client_features_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
+	struct gattlib_eatt_open* eatt_open = user_data;
+
+	eatt_open->request_id = 0;
+
+	if (status != 0) {
+		fprintf(stderr, "Fail to enable Enhanced ATT: %s\n", att_ecode2str(status));
+		eatt_open_done(eatt_open);
+		return;
+	}
+
+	eatt_connect_next(eatt_open);
+}
+
+/* The server supports EATT. Tell it we support it too. */
+static void eatt_server_features_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
+	struct gattlib_eatt_open* eatt_open = user_data;
+	gattlib_context_t* conn_context = eatt_open->connection->context;
+	uint8_t client_features = GATT_CLIENT_FEATURE_EATT;
+	uint16_t handle;
+
+	eatt_open->request_id = 0;
+
+	if ((status != 0) || (len < 2) || (pdu[0] != ATT_OP_READ_RESP) || !(pdu[1] & GATT_SERVER_FEATURE_EATT)) {
+		fprintf(stderr, "The remote device does not support Enhanced ATT.\n");
+		eatt_open_done(eatt_open);
+		return;
+	}
+
+	if (get_handle_from_uuid(eatt_open->connection, &m_client_supported_features_uuid, &handle) == GATTLIB_SUCCESS) {
+		eatt_open->request_id = gatt_write_char(conn_context->attrib, handle, &client_features, sizeof(client_features),
+				eatt_client_features_cb, eatt_open);
+	}
+	if (eatt_open->request_id == 0) {
+		fprintf(stderr, "Fail to enable Enhanced ATT.\n");
+		eatt_open_done(eatt_open);
+	}
+}
+
+int gattlib_eatt_open(gatt_connection_t* connection, const bdaddr_t *src, const bdaddr_t *dst, uint8_t dst_type,
+		int sec_level, int count, gattlib_eatt_open_cb_t cb, void* user_data)
+{
+	gattlib_context_t* conn_context = connection->context;
+	struct gattlib_eatt_open* eatt_open;
+	uint16_t handle;
+
+	if (count > GATTLIB_EATT_MAX_BEARERS) {
+		count = GATTLIB_EATT_MAX_BEARERS;
+	}
+
+	// The 'Server Supported Features' characteristic tells whether the server supports EATT
+	if (get_handle_from_uuid(connection, &m_server_supported_features_uuid, &handle) != GATTLIB_SUCCESS) {
+		fprintf(stderr, "The remote device does not support Enhanced ATT.\n");
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+	eatt_open = calloc(1, sizeof(struct gattlib_eatt_open));
+	if (eatt_open == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	eatt_open->connection = connection;
+	bacpy(&eatt_open->src, src);
+	bacpy(&eatt_open->dst, dst);
+	eatt_open->dst_type   = dst_type;
+	eatt_open->sec_level  = sec_level;
+	eatt_open->count      = count;
+	eatt_open->cb         = cb;
+	eatt_open->user_data  = user_data;
+
+#if BLUEZ_VERSION_MAJOR == 4
+	eatt_open->request_id = gatt_read_char(conn_context->attrib, handle, 0, eatt_server_features_cb, eatt_open);
+#else
+	eatt_open->request_id = gatt_read_char(conn_context->attrib, handle, eatt_server_features_cb, eatt_open);
+#endif
+	if (eatt_open->request_id == 0) {
+		free(eatt_open);
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	conn_context->eatt_open = eatt_open;
+	return GATTLIB_SUCCESS;
+}
+
+void gattlib_eatt_close(gattlib_context_t* conn_context) {
+	int i;
+
+	// Abandon the opening of the bearers. Its callback is not called.
+	if (conn_context->eatt_open != NULL) {
+		if (conn_context->eatt_open->request_id != 0) {
+			g_attrib_cancel(conn_context->attrib, conn_context->eatt_open->request_id);
+		}
+		eatt_open_abort(conn_context->eatt_open);
+		conn_context->eatt_open = NULL;
+	}
+
+	for (i = 0; i < conn_context->eatt_bearer_count; i++) {
+		struct gattlib_att_bearer* bearer = &conn_context->eatt_bearers[i];
+
+		gattlib_event_loop_remove_fd(g_io_channel_unix_get_fd(bearer->io));
+#if BLUEZ_VERSION_MAJOR == 4
+		g_io_channel_shutdown(bearer->io, FALSE, NULL);
+#endif
+		g_attrib_unref(bearer->attrib);
+		g_io_channel_unref(bearer->io);
+	}
+	conn_context->eatt_bearer_count = 0;
+}
+
+/*
+ * Return the bearer to send the next request on. ATT allows a single outstanding request per bearer,
+ * spreading the requests over the Enhanced ATT bearers lets independent requests run in parallel.
+ */
+GAttrib* gattlib_get_attrib(gattlib_context_t* conn_context) {
+	unsigned int index;
+
+	if (conn_context->eatt_bearer_count == 0) {
+		return conn_context->attrib;
+	}
+
+	index = conn_context->next_bearer++ % (conn_context->eatt_bearer_count + 1);
+	if (index == 0) {
+		return conn_context->attrib;
+	} else {
+		return conn_context->eatt_bearers[index - 1].attrib;
+	}
+}
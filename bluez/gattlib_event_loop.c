@@ -0,0 +1,318 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2021 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gattlib_internal.h"
+
+//
+// Each connection is assigned to one of the event loop threads. All the sources of a connection
+// (socket watches and timeouts) are attached to the GMainContext of its event loop. Callers
+// blocking on a request sleep until the event loop completes it.
+//
+
+static struct gattlib_thread_t m_event_loops[GATTLIB_MAX_EVENT_LOOPS];
+static unsigned int m_event_loop_count = 1;
+static unsigned int m_next_event_loop;
+static pthread_mutex_t m_event_loop_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Context of the event loop of each connection socket, indexed by file descriptor
+static GHashTable* m_fd_contexts;
+
+// Context of the event loop the calling thread works for
+static GPrivate m_current_context;
+
+static void *event_loop_thread(void* arg) {
+	GMainLoop* loop = arg;
+
+	g_private_set(&m_current_context, g_main_loop_get_context(loop));
+
+	g_main_loop_run(loop);
+	g_main_loop_unref(loop);
+	return NULL;
+}
+
+static int event_loop_start(struct gattlib_thread_t* event_loop) {
+	int error;
+
+	event_loop->loop_context = g_main_context_new();
+	event_loop->loop = g_main_loop_new(event_loop->loop_context, FALSE);
+
+	/* Create a thread that will handle Bluetooth events */
+	error = pthread_create(&event_loop->thread, NULL, &event_loop_thread, g_main_loop_ref(event_loop->loop));
+	if (error != 0) {
+		fprintf(stderr, "Cannot create connection thread: %s", strerror(error));
+		g_main_loop_unref(event_loop->loop);
+		g_main_loop_unref(event_loop->loop);
+		g_main_context_unref(event_loop->loop_context);
+		event_loop->loop = NULL;
+		event_loop->loop_context = NULL;
+		return GATTLIB_ERROR_INTERNAL;
+	}
+	pthread_detach(event_loop->thread);
+
+	/* Wait for the loop to be started */
+	while (!g_main_loop_is_running(event_loop->loop)) {
+		usleep(1000);
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+static void event_loop_stop(struct gattlib_thread_t* event_loop) {
+	// The thread releases its own reference on the loop when it exits
+	g_main_loop_quit(event_loop->loop);
+	g_main_loop_unref(event_loop->loop);
+	g_main_context_unref(event_loop->loop_context);
+	event_loop->loop = NULL;
+	event_loop->loop_context = NULL;
+}
+
+int gattlib_set_event_loop_count(unsigned int count) {
+	if ((count == 0) || (count > GATTLIB_MAX_EVENT_LOOPS)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// The connections already assigned to an event loop keep it until they are disconnected
+	pthread_mutex_lock(&m_event_loop_mutex);
+	m_event_loop_count = count;
+	pthread_mutex_unlock(&m_event_loop_mutex);
+
+	return GATTLIB_SUCCESS;
+}
+
+struct gattlib_thread_t* gattlib_event_loop_acquire(int hint) {
+	struct gattlib_thread_t* event_loop;
+	unsigned int i, index;
+
+	pthread_mutex_lock(&m_event_loop_mutex);
+
+	if (hint >= 0) {
+		index = hint % m_event_loop_count;
+	} else {
+		// Pick the event loop with the fewest connections, starting after the last one picked
+		index = m_next_event_loop % m_event_loop_count;
+		for (i = 1; i < m_event_loop_count; i++) {
+			unsigned int candidate = (m_next_event_loop + i) % m_event_loop_count;
+
+			if (m_event_loops[candidate].ref < m_event_loops[index].ref) {
+				index = candidate;
+			}
+		}
+		m_next_event_loop = index + 1;
+	}
+
+	event_loop = &m_event_loops[index];
+	if ((event_loop->ref == 0) && (event_loop_start(event_loop) != GATTLIB_SUCCESS)) {
+		pthread_mutex_unlock(&m_event_loop_mutex);
+		return NULL;
+	}
+
+	/* Increase the reference to know how many GATT connection use the loop */
+	event_loop->ref++;
+
+	pthread_mutex_unlock(&m_event_loop_mutex);
+	return event_loop;
+}
+
+void gattlib_event_loop_release(struct gattlib_thread_t* event_loop) {
+	pthread_mutex_lock(&m_event_loop_mutex);
+
+	/* Check if we are the last one */
+	event_loop->ref--;
+	if (event_loop->ref == 0) {
+		event_loop_stop(event_loop);
+	}
+
+	pthread_mutex_unlock(&m_event_loop_mutex);
+}
+
+void gattlib_event_loop_add_fd(int fd, GMainContext* context) {
+	pthread_mutex_lock(&m_event_loop_mutex);
+	if (m_fd_contexts == NULL) {
+		m_fd_contexts = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+	g_hash_table_insert(m_fd_contexts, GINT_TO_POINTER(fd), context);
+	pthread_mutex_unlock(&m_event_loop_mutex);
+}
+
+void gattlib_event_loop_remove_fd(int fd) {
+	pthread_mutex_lock(&m_event_loop_mutex);
+	if (m_fd_contexts != NULL) {
+		g_hash_table_remove(m_fd_contexts, GINT_TO_POINTER(fd));
+	}
+	pthread_mutex_unlock(&m_event_loop_mutex);
+}
+
+GMainContext* gattlib_event_loop_set_current(GMainContext* context) {
+	GMainContext* previous = g_private_get(&m_current_context);
+
+	g_private_set(&m_current_context, context);
+	return previous;
+}
+
+/*
+ * Return the context to attach a source to. The socket of the source identifies the connection and
+ * so its event loop. Without socket (or before the socket is registered), we use the event loop of
+ * the calling thread. There is no fallback: nobody runs the default context, a source attached to it
+ * would never be dispatched.
+ */
+static GMainContext* get_loop_context(GIOChannel* io) {
+	GMainContext* context = NULL;
+
+	if (io != NULL) {
+		pthread_mutex_lock(&m_event_loop_mutex);
+		if (m_fd_contexts != NULL) {
+			context = g_hash_table_lookup(m_fd_contexts, GINT_TO_POINTER(g_io_channel_unix_get_fd(io)));
+		}
+		pthread_mutex_unlock(&m_event_loop_mutex);
+	}
+
+	if (context == NULL) {
+		context = g_private_get(&m_current_context);
+	}
+	assert(context != NULL);
+
+	return context;
+}
+
+GSource* gattlib_watch_connection_full(GIOChannel* io, GIOCondition condition,
+								 GIOFunc func, gpointer user_data, GDestroyNotify notify)
+{
+	// Create a main loop source
+	GSource *source = g_io_create_watch (io, condition);
+	assert(source != NULL);
+
+	g_source_set_callback (source, (GSourceFunc)func, user_data, notify);
+
+	// Attaches it to the main loop context of the connection
+	guint id = g_source_attach(source, get_loop_context(io));
+	g_source_unref (source);
+	assert(id != 0);
+
+	return source;
+}
+
+GSource* gattlib_timeout_add_seconds(GMainContext* context, guint interval, GSourceFunc function, gpointer data) {
+	assert(context != NULL);
+
+	GSource *source = g_timeout_source_new_seconds(interval);
+	assert(source != NULL);
+
+	g_source_set_callback(source, function, data, NULL);
+
+	// Attaches it to the main loop context of the connection
+	guint id = g_source_attach(source, context);
+	g_source_unref (source);
+	assert(id != 0);
+
+	return source;
+}
+
+void gattlib_request_complete(gattlib_context_t* conn_context, int* completed) {
+	g_mutex_lock(&conn_context->request_mutex);
+	g_atomic_int_set(completed, TRUE);
+	g_cond_broadcast(&conn_context->request_cond);
+	g_mutex_unlock(&conn_context->request_mutex);
+}
+
+static gboolean on_request_wait_expired(gpointer user_data) {
+	// Only wake up the waiting caller
+	return FALSE;
+}
+
+static bool request_is_cancelled(gattlib_context_t* conn_context, int generation) {
+	return (generation >= 0) && (g_atomic_int_get(&conn_context->cancel_generation) != generation);
+}
+
+/*
+ * Wait from the event loop of the connection (eg: from a notification handler). Nobody else would
+ * complete the request: the event loop is run from here.
+ */
+static int request_wait_in_loop(gattlib_context_t* conn_context, int* completed, gint64 deadline, int generation) {
+	GSource* timeout = NULL;
+	int ret = GATTLIB_SUCCESS;
+
+	if (deadline != 0) {
+		timeout = g_timeout_source_new(MAX(deadline - g_get_monotonic_time(), 0) / 1000 + 1);
+		g_source_set_callback(timeout, on_request_wait_expired, NULL, NULL);
+		g_source_attach(timeout, conn_context->loop_context);
+	}
+
+	while (!g_atomic_int_get(completed)) {
+		if (request_is_cancelled(conn_context, generation)) {
+			ret = GATTLIB_CANCELLED;
+			break;
+		} else if ((deadline != 0) && (g_get_monotonic_time() >= deadline)) {
+			ret = GATTLIB_TIMEOUT;
+			break;
+		}
+		g_main_context_iteration(conn_context->loop_context, TRUE);
+	}
+
+	if (timeout != NULL) {
+		g_source_destroy(timeout);
+		g_source_unref(timeout);
+	}
+	return ret;
+}
+
+int gattlib_request_wait(gattlib_context_t* conn_context, int* completed, gint64 deadline, int generation) {
+	int ret = GATTLIB_SUCCESS;
+
+	if (g_main_context_is_owner(conn_context->loop_context)) {
+		return request_wait_in_loop(conn_context, completed, deadline, generation);
+	}
+
+	g_mutex_lock(&conn_context->request_mutex);
+	while (!g_atomic_int_get(completed)) {
+		if (request_is_cancelled(conn_context, generation)) {
+			ret = GATTLIB_CANCELLED;
+			break;
+		} else if (deadline == 0) {
+			g_cond_wait(&conn_context->request_cond, &conn_context->request_mutex);
+		} else if (!g_cond_wait_until(&conn_context->request_cond, &conn_context->request_mutex, deadline) &&
+		           !g_atomic_int_get(completed)) {
+			ret = GATTLIB_TIMEOUT;
+			break;
+		}
+	}
+	g_mutex_unlock(&conn_context->request_mutex);
+
+	return ret;
+}
+
+void gattlib_request_cancel_all(gattlib_context_t* conn_context) {
+	// The requests waited for since the previous generation are abandoned
+	g_mutex_lock(&conn_context->request_mutex);
+	g_atomic_int_inc(&conn_context->cancel_generation);
+	g_cond_broadcast(&conn_context->request_cond);
+	g_mutex_unlock(&conn_context->request_mutex);
+
+	// Wake up the caller waiting from the event loop
+	g_main_context_wakeup(conn_context->loop_context);
+}
@@ -48,27 +48,135 @@ struct gattlib_thread_t {
 	GMainLoop*    loop;
 };
 
+// Largest number of event loop threads (see gattlib_set_event_loop_count())
+#define GATTLIB_MAX_EVENT_LOOPS   8
+
+// Largest number of Enhanced ATT bearers opened in addition to the ATT fixed channel
+#define GATTLIB_EATT_MAX_BEARERS  7
+
+struct gattlib_att_bearer {
+	gatt_connection_t*        connection;
+	GIOChannel*               io;
+	GAttrib*                  attrib;
+};
+
 typedef struct {
 	GIOChannel*               io;
 	GAttrib*                  attrib;
 
+	// Event loop the connection is assigned to
+	struct gattlib_thread_t*  event_loop;
+	GMainContext*             loop_context;
+
+	// Enhanced ATT bearers. The requests are spread over 'attrib' and these bearers.
+	struct gattlib_att_bearer eatt_bearers[GATTLIB_EATT_MAX_BEARERS];
+	int                       eatt_bearer_count;
+	unsigned int              next_bearer;
+	// Opening of the Enhanced ATT bearers in progress (see gattlib_eatt_open())
+	struct gattlib_eatt_open* eatt_open;
+
 	// We keep a list of characteristics to make the correspondence handle/UUID.
 	gattlib_characteristic_t* characteristics;
 	int                       characteristic_count;
+	// Index of 'characteristics' by value handle to dispatch the notifications
+	GHashTable*               characteristic_by_handle;
+
+	// Effective ATT MTU of the connection
+	uint16_t                  mtu;
+
+	// Set when the remote device rejected ATT Read Multiple Variable Length
+	bool                      read_multi_vl_unsupported;
+	// Concurrent reads of a same characteristic share a single ATT request
+	struct gattlib_read_coalescer* read_coalescer;
+	// Values of the characteristics (see gattlib_connection_set_value_cache())
+	struct gattlib_value_cache* value_cache;
+
+	// Link Layer settings last reported by the controller
+	gattlib_link_info_t       link_info;
+
+	// Timeout of the GATT requests in milliseconds, 0 to wait for the remote device (see gattlib_connection_set_timeout())
+	gint                      operation_timeout_ms;
+	// Incremented by gattlib_connection_cancel() to abandon the requests in progress
+	gint                      cancel_generation;
+	// Wake up the callers waiting for the requests of the connection (see gattlib_request_wait())
+	GMutex                    request_mutex;
+	GCond                     request_cond;
 } gattlib_context_t;
 
-extern struct gattlib_thread_t g_gattlib_thread;
+struct gattlib_adapter {
+	// Identifier and HCI socket of the adapter
+	int dev_id;
+	int device_desc;
+
+	// Parameters used by the next BLE scan (see gattlib_adapter_scan_set_parameters())
+	gattlib_scan_parameters_t scan_parameters;
+	// Set when the scan has been enabled with the LE Extended Scan commands
+	bool extended_scan;
+};
+
+struct gattlib_thread_t* gattlib_event_loop_acquire(int hint);
+void gattlib_event_loop_release(struct gattlib_thread_t* event_loop);
+void gattlib_event_loop_add_fd(int fd, GMainContext* context);
+void gattlib_event_loop_remove_fd(int fd);
+GMainContext* gattlib_event_loop_set_current(GMainContext* context);
 
 /**
  * Watch the GATT connection for conditions
  */
 GSource* gattlib_watch_connection_full(GIOChannel* io, GIOCondition condition,
 								 GIOFunc func, gpointer user_data, GDestroyNotify notify);
-GSource* gattlib_timeout_add_seconds(guint interval, GSourceFunc function, gpointer data);
+/**
+ * Add a timeout to the main loop context of a connection
+ */
+GSource* gattlib_timeout_add_seconds(GMainContext* context, guint interval, GSourceFunc function, gpointer data);
+
+/**
+ * Mark a request of the connection as completed and wake up the caller waiting for it
+ */
+void gattlib_request_complete(gattlib_context_t* conn_context, int* completed);
+/**
+ * Wait for a request of the connection to be completed. 'deadline' is in monotonic time (0 to wait
+ * for the remote device). A negative 'generation' cannot be cancelled by gattlib_connection_cancel().
+ */
+int gattlib_request_wait(gattlib_context_t* conn_context, int* completed, gint64 deadline, int generation);
+/**
+ * Abandon the requests of the connection waited for
+ */
+void gattlib_request_cancel_all(gattlib_context_t* conn_context);
 
 void uuid_to_bt_uuid(uuid_t* uuid, bt_uuid_t* bt_uuid);
 void bt_uuid_to_uuid(bt_uuid_t* bt_uuid, uuid_t* uuid);
 
+int gattlib_connection_open_hci(gatt_connection_t* connection, int *dd, uint16_t *handle);
+
+/**
+ * Events of interest when updating the Link Layer of a connection
+ */
+#define GATTLIB_LINK_EVENT_NONE                0
+#define GATTLIB_LINK_EVENT_COMMAND_DONE        1
+#define GATTLIB_LINK_EVENT_COMMAND_FAILED      2
+#define GATTLIB_LINK_EVENT_DATA_LENGTH_CHANGED 3
+#define GATTLIB_LINK_EVENT_PHY_UPDATED         4
+
+void gattlib_link_info_init(gattlib_link_info_t *info);
+size_t gattlib_hci_encode_le_set_data_length(uint8_t *buf, uint16_t handle, uint16_t tx_octets, uint16_t tx_time);
+size_t gattlib_hci_encode_le_set_phy(uint8_t *buf, uint16_t handle, uint8_t tx_phys, uint8_t rx_phys);
+int gattlib_hci_parse_link_event(const uint8_t *buf, size_t len, uint16_t opcode, uint16_t handle, gattlib_link_info_t *info);
+int gattlib_hci_link_request(int fd, const uint8_t *cmd, size_t cmd_len, uint16_t handle,
+		int expected_event, gattlib_link_info_t *info, int timeout_ms);
+
+void gattlib_att_bearer_listen(struct gattlib_att_bearer* bearer);
+/**
+ * Called once the Enhanced ATT bearers have been opened or could not be opened
+ */
+typedef void (*gattlib_eatt_open_cb_t)(gatt_connection_t* connection, void* user_data);
+int gattlib_eatt_open(gatt_connection_t* connection, const bdaddr_t *src, const bdaddr_t *dst, uint8_t dst_type,
+		int sec_level, int count, gattlib_eatt_open_cb_t cb, void* user_data);
+void gattlib_eatt_close(gattlib_context_t* conn_context);
+GAttrib* gattlib_get_attrib(gattlib_context_t* conn_context);
+
+int gattlib_characteristics_from_list(GSList *list, gattlib_characteristic_t** characteristics, int* characteristics_count);
+
 int get_uuid_from_handle(gatt_connection_t* connection, uint16_t handle, uuid_t* uuid);
 int get_handle_from_uuid(gatt_connection_t* connection, const uuid_t* uuid, uint16_t* handle);
 
@@ -0,0 +1,389 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2021 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <bluetooth/bluetooth.h>
+
+#include "gattlib_internal.h"
+
+#include "btio.h"
+#include "hci.h"
+#include "hci_lib.h"
+
+#define HCI_COMMAND_TIMEOUT  1000
+
+/* LE commands and events that are not defined by the Bluez headers we ship */
+#define OCF_LE_SET_DATA_LENGTH              0x0022
+#define OCF_LE_SET_PHY                      0x0032
+#define EVT_LE_DATA_LENGTH_CHANGE           0x07
+#define EVT_LE_PHY_UPDATE_COMPLETE          0x0C
+
+/* Link Layer defaults before any Data Length or PHY update */
+#define LE_DEFAULT_OCTETS                   27
+#define LE_DEFAULT_TIME                     328
+
+/* Largest values allowed by LE Data Length Extension */
+#define LE_MAX_OCTETS                       251
+#define LE_MAX_TIME                         0x4290
+
+#define HCI_LINK_COMMAND_MAX_SIZE           (1 + HCI_COMMAND_HDR_SIZE + 16)
+
+static inline void put_le16_at(uint8_t *buf, uint16_t value) {
+	buf[0] = value & 0xFF;
+	buf[1] = value >> 8;
+}
+
+static inline uint16_t get_le16_at(const uint8_t *buf) {
+	return buf[0] | (buf[1] << 8);
+}
+
+/*
+ * Open the HCI device the connection goes through and retrieve the handle of the connection.
+ * The returned HCI socket must be closed with hci_close_dev().
+ */
+int gattlib_connection_open_hci(gatt_connection_t* connection, int *dd, uint16_t *handle) {
+	gattlib_context_t* conn_context = connection->context;
+	GError *err = NULL;
+	char src[18];
+	int dev_id;
+
+	bt_io_get(conn_context->io,
+#if BLUEZ_VERSION_MAJOR == 4
+			BT_IO_L2CAP,
+#endif
+			&err,
+			BT_IO_OPT_SOURCE, src,
+			BT_IO_OPT_HANDLE, handle,
+			BT_IO_OPT_INVALID);
+	if (err) {
+		fprintf(stderr, "Failed to get connection handle: %s\n", err->message);
+		g_error_free(err);
+		return GATTLIB_ERROR_BLUEZ;
+	}
+
+	dev_id = hci_devid(src);
+	if (dev_id < 0) {
+		fprintf(stderr, "ERROR: Could not find the adapter %s.\n", src);
+		return GATTLIB_NOT_FOUND;
+	}
+
+	*dd = hci_open_dev(dev_id);
+	if (*dd < 0) {
+		fprintf(stderr, "ERROR: Could not open device.\n");
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_connection_set_parameters(gatt_connection_t* connection, const gattlib_connection_parameters_t *parameters) {
+	uint16_t handle;
+	int dd, ret;
+
+	if ((connection == NULL) || (parameters == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// Check the ranges defined by the Bluetooth Core Specification
+	if ((parameters->min_interval < 0x0006) || (parameters->max_interval > 0x0C80) ||
+	    (parameters->min_interval > parameters->max_interval) ||
+	    (parameters->latency > 0x01F3) ||
+	    (parameters->supervision_timeout < 0x000A) || (parameters->supervision_timeout > 0x0C80)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// The supervision timeout (10ms unit) must be larger than (1 + latency) * max_interval * 2 (1.25ms unit)
+	if ((uint32_t)parameters->supervision_timeout * 4 <= (1 + (uint32_t)parameters->latency) * parameters->max_interval) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	ret = gattlib_connection_open_hci(connection, &dd, &handle);
+	if (ret != GATTLIB_SUCCESS) {
+		return ret;
+	}
+
+	ret = hci_le_conn_update(dd, handle,
+			parameters->min_interval, parameters->max_interval,
+			parameters->latency, parameters->supervision_timeout,
+			HCI_COMMAND_TIMEOUT);
+	hci_close_dev(dd);
+
+	if (ret < 0) {
+		fprintf(stderr, "ERROR: Connection update failed (are you root?).\n");
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+void gattlib_link_info_init(gattlib_link_info_t *info) {
+	info->max_tx_octets = LE_DEFAULT_OCTETS;
+	info->max_tx_time   = LE_DEFAULT_TIME;
+	info->max_rx_octets = LE_DEFAULT_OCTETS;
+	info->max_rx_time   = LE_DEFAULT_TIME;
+	info->tx_phy        = GATTLIB_PHY_1M;
+	info->rx_phy        = GATTLIB_PHY_1M;
+}
+
+/*
+ * The following functions encode the HCI commands and parse the HCI events as they are written to and read from
+ * a raw HCI socket (ie: starting with the HCI packet type). They do not rely on any socket option so they can be
+ * exercised with any file descriptor (eg: a socketpair standing in for the HCI socket).
+ */
+
+size_t gattlib_hci_encode_le_set_data_length(uint8_t *buf, uint16_t handle, uint16_t tx_octets, uint16_t tx_time) {
+	buf[0] = HCI_COMMAND_PKT;
+	put_le16_at(&buf[1], cmd_opcode_pack(OGF_LE_CTL, OCF_LE_SET_DATA_LENGTH));
+	buf[3] = 6;
+	put_le16_at(&buf[4], handle);
+	put_le16_at(&buf[6], tx_octets);
+	put_le16_at(&buf[8], tx_time);
+	return 1 + HCI_COMMAND_HDR_SIZE + 6;
+}
+
+size_t gattlib_hci_encode_le_set_phy(uint8_t *buf, uint16_t handle, uint8_t tx_phys, uint8_t rx_phys) {
+	buf[0] = HCI_COMMAND_PKT;
+	put_le16_at(&buf[1], cmd_opcode_pack(OGF_LE_CTL, OCF_LE_SET_PHY));
+	buf[3] = 7;
+	put_le16_at(&buf[4], handle);
+	buf[6] = 0x00; // ALL_PHYS: The Host has preferences for both directions
+	buf[7] = tx_phys;
+	buf[8] = rx_phys;
+	put_le16_at(&buf[9], 0x0000); // PHY_options: No preferred coding on LE Coded PHY
+	return 1 + HCI_COMMAND_HDR_SIZE + 7;
+}
+
+int gattlib_hci_parse_link_event(const uint8_t *buf, size_t len, uint16_t opcode, uint16_t handle, gattlib_link_info_t *info) {
+	const uint8_t *params = buf + 1 + HCI_EVENT_HDR_SIZE;
+	size_t params_len;
+
+	if ((len < 1 + HCI_EVENT_HDR_SIZE) || (buf[0] != HCI_EVENT_PKT)) {
+		return GATTLIB_LINK_EVENT_NONE;
+	}
+	params_len = MIN((size_t)buf[2], len - 1 - HCI_EVENT_HDR_SIZE);
+
+	switch (buf[1]) {
+	case EVT_CMD_COMPLETE:
+		// Num_HCI_Command_Packets, Command_Opcode, Status
+		if ((params_len < 4) || (get_le16_at(&params[1]) != opcode)) {
+			return GATTLIB_LINK_EVENT_NONE;
+		}
+		return (params[3] == 0) ? GATTLIB_LINK_EVENT_COMMAND_DONE : GATTLIB_LINK_EVENT_COMMAND_FAILED;
+
+	case EVT_CMD_STATUS:
+		// Status, Num_HCI_Command_Packets, Command_Opcode
+		if ((params_len < 4) || (get_le16_at(&params[2]) != opcode)) {
+			return GATTLIB_LINK_EVENT_NONE;
+		}
+		return (params[0] == 0) ? GATTLIB_LINK_EVENT_COMMAND_DONE : GATTLIB_LINK_EVENT_COMMAND_FAILED;
+
+	case EVT_LE_META_EVENT:
+		if (params_len < 1) {
+			return GATTLIB_LINK_EVENT_NONE;
+		}
+
+		if ((params[0] == EVT_LE_DATA_LENGTH_CHANGE) && (params_len >= 11) && (get_le16_at(&params[1]) == handle)) {
+			info->max_tx_octets = get_le16_at(&params[3]);
+			info->max_tx_time   = get_le16_at(&params[5]);
+			info->max_rx_octets = get_le16_at(&params[7]);
+			info->max_rx_time   = get_le16_at(&params[9]);
+			return GATTLIB_LINK_EVENT_DATA_LENGTH_CHANGED;
+		} else if ((params[0] == EVT_LE_PHY_UPDATE_COMPLETE) && (params_len >= 6) && (get_le16_at(&params[2]) == handle)) {
+			if (params[1] != 0) {
+				return GATTLIB_LINK_EVENT_COMMAND_FAILED;
+			}
+			info->tx_phy = params[4];
+			info->rx_phy = params[5];
+			return GATTLIB_LINK_EVENT_PHY_UPDATED;
+		}
+		return GATTLIB_LINK_EVENT_NONE;
+
+	default:
+		return GATTLIB_LINK_EVENT_NONE;
+	}
+}
+
+static int64_t get_monotonic_time_ms(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int gattlib_hci_link_request(int fd, const uint8_t *cmd, size_t cmd_len, uint16_t handle,
+		int expected_event, gattlib_link_info_t *info, int timeout_ms)
+{
+	uint8_t buf[HCI_MAX_EVENT_SIZE];
+	uint16_t opcode = get_le16_at(&cmd[1]);
+	int64_t deadline = get_monotonic_time_ms() + timeout_ms;
+	bool command_done = false;
+
+	if (write(fd, cmd, cmd_len) != (ssize_t)cmd_len) {
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	while (true) {
+		struct pollfd p = { .fd = fd, .events = POLLIN };
+		int64_t remaining = deadline - get_monotonic_time_ms();
+		int n;
+
+		if (remaining <= 0) {
+			break;
+		}
+
+		n = poll(&p, 1, remaining);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return GATTLIB_DEVICE_ERROR;
+		} else if (n == 0) {
+			break;
+		}
+
+		ssize_t len = read(fd, buf, sizeof(buf));
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return GATTLIB_DEVICE_ERROR;
+		}
+
+		switch (gattlib_hci_parse_link_event(buf, len, opcode, handle, info)) {
+		case GATTLIB_LINK_EVENT_COMMAND_FAILED:
+			return GATTLIB_DEVICE_ERROR;
+		case GATTLIB_LINK_EVENT_COMMAND_DONE:
+			command_done = true;
+			break;
+		case GATTLIB_LINK_EVENT_DATA_LENGTH_CHANGED:
+		case GATTLIB_LINK_EVENT_PHY_UPDATED:
+			// The controller might report the change before completing the command
+			if (command_done || (expected_event == GATTLIB_LINK_EVENT_PHY_UPDATED)) {
+				return GATTLIB_SUCCESS;
+			}
+			break;
+		}
+	}
+
+	// The controller does not report any change when the values are already in use
+	return command_done ? GATTLIB_SUCCESS : GATTLIB_DEVICE_ERROR;
+}
+
+static int link_open_hci(gatt_connection_t* connection, int *dd, uint16_t *handle) {
+	struct hci_filter filter;
+	int ret;
+
+	ret = gattlib_connection_open_hci(connection, dd, handle);
+	if (ret != GATTLIB_SUCCESS) {
+		return ret;
+	}
+
+	hci_filter_clear(&filter);
+	hci_filter_set_ptype(HCI_EVENT_PKT, &filter);
+	hci_filter_set_event(EVT_CMD_STATUS, &filter);
+	hci_filter_set_event(EVT_CMD_COMPLETE, &filter);
+	hci_filter_set_event(EVT_LE_META_EVENT, &filter);
+	if (setsockopt(*dd, SOL_HCI, HCI_FILTER, &filter, sizeof(filter)) < 0) {
+		hci_close_dev(*dd);
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_connection_set_data_length(gatt_connection_t* connection, uint16_t tx_octets, uint16_t tx_time) {
+	gattlib_context_t* conn_context;
+	uint8_t cmd[HCI_LINK_COMMAND_MAX_SIZE];
+	uint16_t handle;
+	int dd, ret;
+
+	if (connection == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	if ((tx_octets < LE_DEFAULT_OCTETS) || (tx_octets > LE_MAX_OCTETS) ||
+	    (tx_time < LE_DEFAULT_TIME) || (tx_time > LE_MAX_TIME)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	ret = link_open_hci(connection, &dd, &handle);
+	if (ret != GATTLIB_SUCCESS) {
+		return ret;
+	}
+
+	size_t cmd_len = gattlib_hci_encode_le_set_data_length(cmd, handle, tx_octets, tx_time);
+	ret = gattlib_hci_link_request(dd, cmd, cmd_len, handle, GATTLIB_LINK_EVENT_DATA_LENGTH_CHANGED,
+			&conn_context->link_info, HCI_COMMAND_TIMEOUT);
+	hci_close_dev(dd);
+
+	if (ret != GATTLIB_SUCCESS) {
+		fprintf(stderr, "ERROR: LE Set Data Length failed.\n");
+	}
+	return ret;
+}
+
+int gattlib_connection_set_phy(gatt_connection_t* connection, uint8_t tx_phys, uint8_t rx_phys) {
+	gattlib_context_t* conn_context;
+	uint8_t cmd[HCI_LINK_COMMAND_MAX_SIZE];
+	uint16_t handle;
+	int dd, ret;
+
+	if (connection == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	if ((tx_phys == 0) || (rx_phys == 0) || ((tx_phys | rx_phys) & ~GATTLIB_PHY_MASK_ALL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	ret = link_open_hci(connection, &dd, &handle);
+	if (ret != GATTLIB_SUCCESS) {
+		return ret;
+	}
+
+	size_t cmd_len = gattlib_hci_encode_le_set_phy(cmd, handle, tx_phys, rx_phys);
+	ret = gattlib_hci_link_request(dd, cmd, cmd_len, handle, GATTLIB_LINK_EVENT_PHY_UPDATED,
+			&conn_context->link_info, HCI_COMMAND_TIMEOUT);
+	hci_close_dev(dd);
+
+	if (ret != GATTLIB_SUCCESS) {
+		fprintf(stderr, "ERROR: LE Set PHY failed.\n");
+	}
+	return ret;
+}
+
+int gattlib_get_link_info(gatt_connection_t* connection, gattlib_link_info_t *info) {
+	gattlib_context_t* conn_context;
+
+	if ((connection == NULL) || (info == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	conn_context = connection->context;
+	*info = conn_context->link_info;
+	return GATTLIB_SUCCESS;
+}
@@ -30,7 +30,196 @@
 #include "gattrib.h"
 #include "gatt.h"
 
+static int att_ecode_to_gattlib_error(guint8 status) {
+	switch (status) {
+	case ATT_ECODE_INVALID_HANDLE:
+	case ATT_ECODE_ATTR_NOT_FOUND:
+		return GATTLIB_NOT_FOUND;
+	case ATT_ECODE_REQ_NOT_SUPP:
+		return GATTLIB_NOT_SUPPORTED;
+	default:
+		return GATTLIB_DEVICE_ERROR;
+	}
+}
+
+/* Queue an encoded ATT request on the GAttrib of the connection */
+static guint attrib_send_pdu(GAttrib *attrib, const uint8_t *pdu, guint16 len, GAttribResultFunc func, gpointer user_data) {
+#if BLUEZ_VERSION_MAJOR == 4
+	return g_attrib_send(attrib, 0, pdu[0], pdu, len, func, user_data, NULL);
+#else
+	return g_attrib_send(attrib, 0, pdu, len, func, user_data, NULL);
+#endif
+}
+
+/*
+ * Wait for the completion of a request. The request is abandoned when the timeout of the connection
+ * expires or when gattlib_connection_cancel() is called.
+ */
+static int request_wait(gattlib_context_t* conn_context, int* completed) {
+	int generation = g_atomic_int_get(&conn_context->cancel_generation);
+	int timeout_ms = g_atomic_int_get(&conn_context->operation_timeout_ms);
+	gint64 deadline = 0;
+
+	if (timeout_ms > 0) {
+		deadline = g_get_monotonic_time() + (gint64)timeout_ms * 1000;
+	}
+
+	return gattlib_request_wait(conn_context, completed, deadline, generation);
+}
+
+/*
+ * Group of requests queued at once and waited for together. The group is shared by the caller and
+ * the callbacks of its requests. When the caller gives up on timeout or cancellation, the requests
+ * still queued are cancelled and the group outlives the caller until the callbacks of the requests
+ * that could not be cancelled have run.
+ */
+struct gattlib_request_group_t {
+	gattlib_context_t* conn_context;
+	gint     ref;
+	// Number of requests waiting for their callback, plus one while the caller queues requests
+	gint     pending;
+	int      completed;
+	// Held by the callbacks while they write into the buffers of the caller
+	GMutex   mutex;
+	// Set when the caller has given up. The callbacks must not touch the buffers of the caller anymore.
+	bool     abandoned;
+	// List of 'struct gattlib_group_request_t*' waiting for their callback
+	GList*   requests;
+	void   (*free)(struct gattlib_request_group_t* group);
+};
+
+/* Request of a group. It must be the first member of the data passed to the request callback. */
+struct gattlib_group_request_t {
+	struct gattlib_request_group_t* group;
+	GAttrib* attrib;
+	guint    id;
+};
+
+static void request_group_init(struct gattlib_request_group_t* group, gattlib_context_t* conn_context,
+		void (*free_group)(struct gattlib_request_group_t* group))
+{
+	group->conn_context = conn_context;
+	group->ref       = 1;
+	group->pending   = 1;
+	group->completed = FALSE;
+	group->abandoned = false;
+	group->requests  = NULL;
+	group->free      = free_group;
+	g_mutex_init(&group->mutex);
+}
+
+static void request_group_unref(struct gattlib_request_group_t* group) {
+	if (g_atomic_int_dec_and_test(&group->ref)) {
+		g_mutex_clear(&group->mutex);
+		group->free(group);
+	}
+}
+
+static void request_group_done(struct gattlib_request_group_t* group) {
+	if (g_atomic_int_dec_and_test(&group->pending)) {
+		gattlib_request_complete(group->conn_context, &group->completed);
+	}
+}
+
+/* Reuse a group whose requests have all completed for the next requests */
+static void request_group_reset(struct gattlib_request_group_t* group) {
+	g_atomic_int_set(&group->pending, 1);
+	g_atomic_int_set(&group->completed, FALSE);
+}
+
+/* Account for a request about to be sent. The mutex of the group must be held. */
+static void request_group_add(struct gattlib_request_group_t* group, struct gattlib_group_request_t* request, GAttrib* attrib) {
+	request->group  = group;
+	request->attrib = attrib;
+	request->id     = 0;
+
+	g_atomic_int_inc(&group->pending);
+	g_atomic_int_inc(&group->ref);
+	group->requests = g_list_prepend(group->requests, request);
+}
+
+/*
+ * Complete the accounting of a request with the id returned by GAttrib. The request is freed if it has not been sent.
+ * The mutex of the group must be held. Return false if the request has not been sent.
+ */
+static bool request_group_sent(struct gattlib_request_group_t* group, struct gattlib_group_request_t* request, guint id) {
+	if (id == 0) {
+		group->requests = g_list_remove(group->requests, request);
+		// The caller or the callback queuing this request holds 'pending' and a reference: they cannot drop to 0
+		g_atomic_int_add(&group->pending, -1);
+		g_atomic_int_add(&group->ref, -1);
+		free(request);
+		return false;
+	}
+
+	request->id = id;
+	return true;
+}
+
+/* Start of a request callback. Return false if the caller has abandoned the group. */
+static bool request_group_callback_begin(struct gattlib_group_request_t* request) {
+	struct gattlib_request_group_t* group = request->group;
+
+	g_mutex_lock(&group->mutex);
+	group->requests = g_list_remove(group->requests, request);
+	return !group->abandoned;
+}
+
+/* End of a request callback. The request is freed. */
+static void request_group_callback_end(struct gattlib_group_request_t* request) {
+	struct gattlib_request_group_t* group = request->group;
+
+	g_mutex_unlock(&group->mutex);
+	free(request);
+	request_group_done(group);
+	request_group_unref(group);
+}
+
+/* Give up the requests of the group. Once it returns, the callbacks do not touch the buffers of the caller anymore. */
+static void request_group_abandon(struct gattlib_request_group_t* group) {
+	int cancelled = 0;
+	GList *l, *next;
+
+	g_mutex_lock(&group->mutex);
+	group->abandoned = true;
+	for (l = group->requests; l != NULL; l = next) {
+		struct gattlib_group_request_t* request = l->data;
+
+		next = l->next;
+		// The callback is not called once the request has been removed from the queue
+		if (g_attrib_cancel(request->attrib, request->id)) {
+			group->requests = g_list_delete_link(group->requests, l);
+			free(request);
+			cancelled++;
+		}
+	}
+	g_mutex_unlock(&group->mutex);
+
+	for (; cancelled > 0; cancelled--) {
+		request_group_done(group);
+		request_group_unref(group);
+	}
+}
+
+/*
+ * Wait for all the requests of the group once they have been queued. The group is abandoned
+ * when the timeout of the connection expires or when gattlib_connection_cancel() is called.
+ */
+static int request_group_wait(gattlib_context_t* conn_context, struct gattlib_request_group_t* group) {
+	int ret;
+
+	// All the requests have been queued
+	request_group_done(group);
+
+	ret = request_wait(conn_context, &group->completed);
+	if (ret != GATTLIB_SUCCESS) {
+		request_group_abandon(group);
+	}
+	return ret;
+}
+
 struct gattlib_result_read_uuid_t {
+	gattlib_context_t* conn_context;
 	void**         buffer;
 	size_t*        buffer_len;
 	gatt_read_cb_t callback;
@@ -85,10 +274,86 @@ done:
 	if (gattlib_result->callback) {
 		free(gattlib_result);
 	} else {
-		gattlib_result->completed = TRUE;
+		gattlib_request_complete(gattlib_result->conn_context, &gattlib_result->completed);
+	}
+}
+
+struct gattlib_result_read_handle_t {
+	gattlib_context_t* conn_context;
+	void**         buffer;
+	size_t*        buffer_len;
+	gatt_read_cb_t callback;
+	int            completed;
+	int            ret;
+
+	// Synchronous read: the value is kept in the result shared by the caller and the callback.
+	// The result outlives the caller when the request is abandoned.
+	void*          value;
+	size_t         value_len;
+	gint           ref;
+};
+
+static void read_handle_result_unref(struct gattlib_result_read_handle_t* gattlib_result) {
+	if (g_atomic_int_dec_and_test(&gattlib_result->ref)) {
+		free(gattlib_result->value);
+		free(gattlib_result);
+	}
+}
+
+static void gattlib_result_read_handle_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
+	struct gattlib_result_read_handle_t* gattlib_result = user_data;
+	const uint8_t *value = pdu + 1;
+	size_t value_len = len - 1;
+
+	if (status != 0) {
+		fprintf(stderr, "Read characteristic failed: %s\n", att_ecode2str(status));
+		gattlib_result->ret = att_ecode_to_gattlib_error(status);
+		goto done;
+	}
+
+	// On long values, the response is the concatenation of the Read and Read Blob responses
+	if ((len < 1) || (pdu[0] != ATT_OP_READ_RESP)) {
+		gattlib_result->ret = GATTLIB_DEVICE_ERROR;
+		goto done;
+	}
+
+	if (gattlib_result->callback) {
+		gattlib_result->callback(value, value_len);
+	} else {
+		void* buffer = malloc(value_len > 0 ? value_len : 1);
+		if (buffer == NULL) {
+			gattlib_result->ret = GATTLIB_OUT_OF_MEMORY;
+			goto done;
+		}
+
+		memcpy(buffer, value, value_len);
+
+		*gattlib_result->buffer_len = value_len;
+		*gattlib_result->buffer     = buffer;
+	}
+
+done:
+	if (gattlib_result->callback) {
+		free(gattlib_result);
+	} else {
+		gattlib_request_complete(gattlib_result->conn_context, &gattlib_result->completed);
+		read_handle_result_unref(gattlib_result);
 	}
 }
 
+/*
+ * Read the value at the given handle with a Read request. gatt_read_char() completes the values
+ * longer than the ATT MTU with Read Blob requests.
+ */
+static guint read_char_by_handle(GAttrib* attrib, uint16_t handle, struct gattlib_result_read_handle_t* gattlib_result)
+{
+#if BLUEZ_VERSION_MAJOR == 4
+	return gatt_read_char(attrib, handle, 0, gattlib_result_read_handle_cb, gattlib_result);
+#else
+	return gatt_read_char(attrib, handle, gattlib_result_read_handle_cb, gattlib_result);
+#endif
+}
+
 void uuid_to_bt_uuid(uuid_t* uuid, bt_uuid_t* bt_uuid) {
 	memcpy(&bt_uuid->value, &uuid->value, sizeof(bt_uuid->value));
 	if (uuid->type == SDP_UUID16) {
@@ -102,6 +367,55 @@ void uuid_to_bt_uuid(uuid_t* uuid, bt_uuid_t* bt_uuid) {
 	}
 }
 
+struct read_char_request {
+	gattlib_context_t* conn_context;
+	uint16_t           handle;
+};
+
+/* Read the value of a discovered characteristic and wait for it. It is issued by the read coalescer. */
+static int read_char_by_handle_sync(void* user_data, void **buffer, size_t* buffer_len) {
+	struct read_char_request* request = user_data;
+	gattlib_context_t* conn_context = request->conn_context;
+	GAttrib* attrib = gattlib_get_attrib(conn_context);
+	struct gattlib_result_read_handle_t* result;
+	guint id;
+	int ret;
+
+	result = calloc(1, sizeof(struct gattlib_result_read_handle_t));
+	if (result == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	result->conn_context = conn_context;
+	result->buffer     = &result->value;
+	result->buffer_len = &result->value_len;
+	// One reference for this function and one for the callback
+	result->ref        = 2;
+
+	id = read_char_by_handle(attrib, request->handle, result);
+	if (id == 0) {
+		free(result);
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	ret = request_wait(conn_context, &result->completed);
+	if (ret != GATTLIB_SUCCESS) {
+		// The callback is not called once the request has been removed from the queue
+		if (g_attrib_cancel(attrib, id)) {
+			read_handle_result_unref(result);
+		}
+		read_handle_result_unref(result);
+		return ret;
+	}
+
+	ret = result->ret;
+	if (ret == GATTLIB_SUCCESS) {
+		*buffer     = g_steal_pointer(&result->value);
+		*buffer_len = result->value_len;
+	}
+	read_handle_result_unref(result);
+	return ret;
+}
+
 int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid,
 			      void **buffer, size_t* buffer_len)
 {
@@ -110,11 +424,35 @@ int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid,
 	bt_uuid_t bt_uuid;
 	const int start = 0x0001;
 	const int end   = 0xffff;
+	uint16_t handle;
+
+	if (gattlib_value_cache_get(conn_context->value_cache, uuid, buffer, buffer_len)) {
+		return GATTLIB_SUCCESS;
+	}
+
+	// Prefer the handle of the discovered characteristic. It saves the server from searching its database.
+	if (get_handle_from_uuid(connection, uuid, &handle) == GATTLIB_SUCCESS) {
+		uint64_t cache_sequence = gattlib_value_cache_sequence(conn_context->value_cache);
+		struct read_char_request request = {
+			.conn_context = conn_context,
+			.handle       = handle,
+		};
+		int ret;
+
+		// The threads reading this characteristic at the same time share the same ATT request
+		ret = gattlib_read_coalescer_read(conn_context->read_coalescer, uuid,
+				read_char_by_handle_sync, &request, buffer, buffer_len);
+		if (ret == GATTLIB_SUCCESS) {
+			gattlib_value_cache_update_from_read(conn_context->value_cache, uuid, *buffer, *buffer_len, cache_sequence);
+		}
+		return ret;
+	}
 
 	gattlib_result = malloc(sizeof(struct gattlib_result_read_uuid_t));
 	if (gattlib_result == NULL) {
 		return GATTLIB_OUT_OF_MEMORY;
 	}
+	gattlib_result->conn_context   = conn_context;
 	gattlib_result->buffer         = buffer;
 	gattlib_result->buffer_len     = buffer_len;
 	gattlib_result->callback       = NULL;
@@ -125,10 +463,8 @@ int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid,
 	gatt_read_char_by_uuid(conn_context->attrib, start, end, &bt_uuid,
 			       gattlib_result_read_uuid_cb, gattlib_result);
 
-	// Wait for completion of the event
-	while(gattlib_result->completed == FALSE) {
-		g_main_context_iteration(g_gattlib_thread.loop_context, FALSE);
-	}
+	// Wait for completion of the event. The result is used by the callback until then.
+	gattlib_request_wait(conn_context, &gattlib_result->completed, 0, -1);
 
 	free(gattlib_result);
 	return GATTLIB_SUCCESS;
@@ -142,11 +478,27 @@ int gattlib_read_char_by_uuid_async(gatt_connection_t* connection, uuid_t* uuid,
 	const int start = 0x0001;
 	const int end   = 0xffff;
 	bt_uuid_t bt_uuid;
+	uint16_t handle;
+
+	if (get_handle_from_uuid(connection, uuid, &handle) == GATTLIB_SUCCESS) {
+		struct gattlib_result_read_handle_t* result = calloc(1, sizeof(struct gattlib_result_read_handle_t));
+		if (result == NULL) {
+			return GATTLIB_OUT_OF_MEMORY;
+		}
+		result->callback = gatt_read_cb;
+
+		if (read_char_by_handle(gattlib_get_attrib(conn_context), handle, result) == 0) {
+			free(result);
+			return GATTLIB_DEVICE_ERROR;
+		}
+		return GATTLIB_SUCCESS;
+	}
 
 	gattlib_result = malloc(sizeof(struct gattlib_result_read_uuid_t));
 	if (gattlib_result == NULL) {
 		return GATTLIB_OUT_OF_MEMORY;
 	}
+	gattlib_result->conn_context   = conn_context;
 	gattlib_result->buffer         = NULL;
 	gattlib_result->buffer_len     = 0;
 	gattlib_result->callback       = gatt_read_cb;
@@ -164,27 +516,508 @@ int gattlib_read_char_by_uuid_async(gatt_connection_t* connection, uuid_t* uuid,
 	}
 }
 
+// Largest number of handles requested by a single ATT Read Multiple Variable Length request
+#define READ_MULTIPLE_MAX_HANDLES 32
+
+struct gattlib_read_multiple_context_t {
+	struct gattlib_request_group_t group;
+	gattlib_context_t*       conn_context;
+	// Buffer of the caller. Only accessed with the mutex of the group held.
+	gattlib_read_multiple_t* reads;
+	uint16_t*                handles;
+	// Set once the result of a read has been given
+	bool*                    done;
+};
+
+struct gattlib_read_multiple_batch_t {
+	struct gattlib_group_request_t request;
+	int      count;
+	size_t   indexes[READ_MULTIPLE_MAX_HANDLES];
+	uint16_t handles[READ_MULTIPLE_MAX_HANDLES];
+};
+
+struct gattlib_read_multiple_single_t {
+	struct gattlib_group_request_t request;
+	size_t index;
+};
+
+static void read_multiple_context_free(struct gattlib_request_group_t* group) {
+	struct gattlib_read_multiple_context_t* context = (struct gattlib_read_multiple_context_t*)group;
+
+	free(context->handles);
+	free(context->done);
+	free(context);
+}
+
+static void read_multiple_set_result(struct gattlib_read_multiple_context_t* context, size_t index, int ret) {
+	context->reads[index].ret = ret;
+	context->done[index] = true;
+}
+
+static void read_multiple_set_value(struct gattlib_read_multiple_context_t* context, size_t index,
+		const uint8_t *value, size_t value_len)
+{
+	gattlib_read_multiple_t* read = &context->reads[index];
+
+	read->buffer = malloc(value_len > 0 ? value_len : 1);
+	if (read->buffer == NULL) {
+		read_multiple_set_result(context, index, GATTLIB_OUT_OF_MEMORY);
+		return;
+	}
+
+	memcpy(read->buffer, value, value_len);
+	read->buffer_len = value_len;
+	read_multiple_set_result(context, index, GATTLIB_SUCCESS);
+}
+
+static void read_multiple_single_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
+	struct gattlib_read_multiple_single_t* single = user_data;
+	struct gattlib_read_multiple_context_t* context = (struct gattlib_read_multiple_context_t*)single->request.group;
+
+	if (request_group_callback_begin(&single->request)) {
+		if (status != 0) {
+			read_multiple_set_result(context, single->index, att_ecode_to_gattlib_error(status));
+		} else if ((len < 1) || (pdu[0] != ATT_OP_READ_RESP)) {
+			read_multiple_set_result(context, single->index, GATTLIB_DEVICE_ERROR);
+		} else {
+			read_multiple_set_value(context, single->index, pdu + 1, len - 1);
+		}
+	}
+	request_group_callback_end(&single->request);
+}
+
+/* Queue the read of a single characteristic. The mutex of the group must be held. */
+static void read_multiple_single(struct gattlib_read_multiple_context_t* context, size_t index) {
+	struct gattlib_read_multiple_single_t* single;
+	GAttrib* attrib = gattlib_get_attrib(context->conn_context);
+	guint id;
+
+	single = malloc(sizeof(struct gattlib_read_multiple_single_t));
+	if (single == NULL) {
+		read_multiple_set_result(context, index, GATTLIB_OUT_OF_MEMORY);
+		return;
+	}
+	single->index = index;
+
+	request_group_add(&context->group, &single->request, attrib);
+	// gatt_read_char() completes long values with Read Blob requests
+#if BLUEZ_VERSION_MAJOR == 4
+	id = gatt_read_char(attrib, context->handles[index], 0, read_multiple_single_cb, single);
+#else
+	id = gatt_read_char(attrib, context->handles[index], read_multiple_single_cb, single);
+#endif
+	if (!request_group_sent(&context->group, &single->request, id)) {
+		read_multiple_set_result(context, index, GATTLIB_DEVICE_ERROR);
+	}
+}
+
+static void read_multiple_batch_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
+	struct gattlib_read_multiple_batch_t* batch = user_data;
+	struct gattlib_read_multiple_context_t* context = (struct gattlib_read_multiple_context_t*)batch->request.group;
+	const uint8_t *values[READ_MULTIPLE_MAX_HANDLES];
+	uint16_t value_lens[READ_MULTIPLE_MAX_HANDLES];
+	int decoded = 0;
+	int i;
+
+	if (status == ATT_ECODE_REQ_NOT_SUPP) {
+		context->conn_context->read_multi_vl_unsupported = true;
+	}
+
+	if (request_group_callback_begin(&batch->request)) {
+		if (status == 0) {
+			decoded = dec_read_multi_vl_resp(pdu, len, values, value_lens, batch->count);
+			if (decoded < 0) {
+				decoded = 0;
+			}
+		}
+
+		for (i = 0; i < decoded; i++) {
+			read_multiple_set_value(context, batch->indexes[i], values[i], value_lens[i]);
+		}
+
+		// The values that are not in the response (truncated response, one of the handles cannot be read, etc)
+		// are read one by one. It also gives the error of each characteristic.
+		for (; i < batch->count; i++) {
+			read_multiple_single(context, batch->indexes[i]);
+		}
+	}
+	request_group_callback_end(&batch->request);
+}
+
+/* Queue a Read Multiple Variable Length request. The mutex of the group must be held. */
+static bool read_multiple_batch(struct gattlib_read_multiple_context_t* context, const size_t *indexes, int count) {
+	struct gattlib_read_multiple_batch_t* batch;
+	GAttrib* attrib;
+	uint8_t *buf;
+	guint16 plen;
+	guint id;
+	int i;
+#if BLUEZ_VERSION_MAJOR == 4
+	int buflen;
+#else
+	size_t buflen;
+#endif
+
+	batch = malloc(sizeof(struct gattlib_read_multiple_batch_t));
+	if (batch == NULL) {
+		return false;
+	}
+	batch->count = count;
+	for (i = 0; i < count; i++) {
+		batch->indexes[i] = indexes[i];
+		batch->handles[i] = context->handles[indexes[i]];
+	}
+
+	attrib = gattlib_get_attrib(context->conn_context);
+	buf = g_attrib_get_buffer(attrib, &buflen);
+	plen = enc_read_multi_vl_req(batch->handles, count, buf, buflen);
+	if (plen == 0) {
+		free(batch);
+		return false;
+	}
+
+	request_group_add(&context->group, &batch->request, attrib);
+	id = attrib_send_pdu(attrib, buf, plen, read_multiple_batch_cb, batch);
+	return request_group_sent(&context->group, &batch->request, id);
+}
+
+int gattlib_read_multiple(gatt_connection_t* connection, gattlib_read_multiple_t* reads, size_t count) {
+	struct gattlib_read_multiple_context_t* context;
+	gattlib_context_t* conn_context;
+	size_t *indexes;
+	size_t i, resolved = 0;
+	int max_batch;
+	int ret;
+
+	if ((connection == NULL) || ((reads == NULL) && (count > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	context = calloc(1, sizeof(struct gattlib_read_multiple_context_t));
+	if (context == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	request_group_init(&context->group, conn_context, read_multiple_context_free);
+	context->conn_context = conn_context;
+	context->reads        = reads;
+	context->handles      = malloc(count * sizeof(uint16_t) + 1);
+	context->done         = calloc(count + 1, sizeof(bool));
+	indexes               = malloc(count * sizeof(size_t) + 1);
+	if ((context->handles == NULL) || (context->done == NULL) || (indexes == NULL)) {
+		free(indexes);
+		request_group_unref(&context->group);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	for (i = 0; i < count; i++) {
+		reads[i].buffer     = NULL;
+		reads[i].buffer_len = 0;
+		reads[i].ret = get_handle_from_uuid(connection, &reads[i].uuid, &context->handles[i]);
+		if (reads[i].ret == GATTLIB_SUCCESS) {
+			indexes[resolved++] = i;
+		} else {
+			context->done[i] = true;
+		}
+	}
+
+	// The request must fit in the ATT MTU
+	max_batch = MIN(READ_MULTIPLE_MAX_HANDLES, (conn_context->mtu - 1) / 2);
+
+	// All the requests are queued at once. GAttrib sends the next request as soon as the previous one completes.
+	for (i = 0; i < resolved; ) {
+		int batch_count = MIN((size_t)max_batch, resolved - i);
+
+		g_mutex_lock(&context->group.mutex);
+		if (!conn_context->read_multi_vl_unsupported && (batch_count >= 2) &&
+		    read_multiple_batch(context, &indexes[i], batch_count))
+		{
+			i += batch_count;
+		} else {
+			read_multiple_single(context, indexes[i]);
+			i++;
+		}
+		g_mutex_unlock(&context->group.mutex);
+	}
+	free(indexes);
+
+	ret = request_group_wait(conn_context, &context->group);
+	if (ret != GATTLIB_SUCCESS) {
+		// The reads that have not completed take the error of the request
+		for (i = 0; i < count; i++) {
+			if (!context->done[i]) {
+				reads[i].ret = ret;
+			}
+		}
+	} else {
+		for (i = 0; i < count; i++) {
+			if (reads[i].ret != GATTLIB_SUCCESS) {
+				ret = reads[i].ret;
+				break;
+			}
+		}
+	}
+
+	request_group_unref(&context->group);
+	return ret;
+}
+
+struct gattlib_result_write_t {
+	gattlib_context_t* conn_context;
+	int  completed;
+	// The result outlives the caller when the request is abandoned
+	gint ref;
+};
+
+static void gattlib_result_write_unref(struct gattlib_result_write_t* write_result) {
+	if (g_atomic_int_dec_and_test(&write_result->ref)) {
+		free(write_result);
+	}
+}
+
 void gattlib_write_result_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
-	int* write_completed = user_data;
+	struct gattlib_result_write_t* write_result = user_data;
 
-	*write_completed = TRUE;
+	gattlib_request_complete(write_result->conn_context, &write_result->completed);
+	gattlib_result_write_unref(write_result);
+}
+
+/* Drop the cached value of the characteristic written at 'handle' */
+static void invalidate_cached_value(gatt_connection_t* connection, uint16_t handle) {
+	gattlib_context_t* conn_context = connection->context;
+	uuid_t uuid;
+
+	if (get_uuid_from_handle(connection, handle, &uuid) == GATTLIB_SUCCESS) {
+		gattlib_value_cache_invalidate(conn_context->value_cache, &uuid);
+	}
 }
 
 int gattlib_write_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len) {
 	gattlib_context_t* conn_context = connection->context;
-	int write_completed = FALSE;
+	GAttrib* attrib = gattlib_get_attrib(conn_context);
+	struct gattlib_result_write_t* write_result;
+	guint id;
+	int ret;
 
-	guint ret = gatt_write_char(conn_context->attrib, handle, (void*)buffer, buffer_len,
-				    gattlib_write_result_cb, &write_completed);
-	if (ret == 0) {
+	write_result = calloc(1, sizeof(struct gattlib_result_write_t));
+	if (write_result == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	write_result->conn_context = conn_context;
+	// One reference for this function and one for the callback
+	write_result->ref = 2;
+
+	id = gatt_write_char(attrib, handle, (void*)buffer, buffer_len, gattlib_write_result_cb, write_result);
+	if (id == 0) {
+		free(write_result);
 		return 1;
 	}
 
-	// Wait for completion of the event
-	while(write_completed == FALSE) {
-		g_main_context_iteration(g_gattlib_thread.loop_context, FALSE);
+	ret = request_wait(conn_context, &write_result->completed);
+	if ((ret != GATTLIB_SUCCESS) && g_attrib_cancel(attrib, id)) {
+		// The callback is not called once the request has been removed from the queue
+		gattlib_result_write_unref(write_result);
+	}
+	gattlib_result_write_unref(write_result);
+
+	invalidate_cached_value(connection, handle);
+	return ret;
+}
+
+struct gattlib_long_write_t {
+	struct gattlib_request_group_t group;
+	// Buffer of the caller. Only accessed with the mutex of the group held.
+	const uint8_t* value;
+	uint16_t       handle;
+	int            ret;
+};
+
+struct gattlib_prepare_write_t {
+	struct gattlib_group_request_t request;
+	uint16_t offset;
+	uint16_t len;
+};
+
+static void long_write_free(struct gattlib_request_group_t* group) {
+	free(group);
+}
+
+static void prepare_write_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
+	struct gattlib_prepare_write_t* prepare_write = user_data;
+	struct gattlib_long_write_t* long_write = (struct gattlib_long_write_t*)prepare_write->request.group;
+
+	if (!request_group_callback_begin(&prepare_write->request)) {
+		// The caller has given up, the value might not exist anymore
+	} else if (status != 0) {
+		fprintf(stderr, "Prepare Write failed: %s\n", att_ecode2str(status));
+		long_write->ret = att_ecode_to_gattlib_error(status);
+	} else if ((len != 5 + prepare_write->len) || (pdu[0] != ATT_OP_PREP_WRITE_RESP) ||
+		   ((pdu[1] | (pdu[2] << 8)) != long_write->handle) ||
+		   ((pdu[3] | (pdu[4] << 8)) != prepare_write->offset) ||
+		   (memcmp(&pdu[5], long_write->value + prepare_write->offset, prepare_write->len) != 0))
+	{
+		// The server echoes the queued part of the value. A mismatch means it has not been queued as sent.
+		fprintf(stderr, "Prepare Write failed: Value mismatch\n");
+		long_write->ret = GATTLIB_DEVICE_ERROR;
+	}
+	request_group_callback_end(&prepare_write->request);
+}
+
+static void execute_write_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
+	struct gattlib_group_request_t* execute_write = user_data;
+	struct gattlib_long_write_t* long_write = (struct gattlib_long_write_t*)execute_write->group;
+
+	if (request_group_callback_begin(execute_write) && (status != 0)) {
+		fprintf(stderr, "Execute Write failed: %s\n", att_ecode2str(status));
+		if (long_write->ret == GATTLIB_SUCCESS) {
+			long_write->ret = att_ecode_to_gattlib_error(status);
+		}
 	}
-	return 0;
+	request_group_callback_end(execute_write);
+}
+
+/* Queue the Execute Write request that commits or discards the queued segments */
+static void execute_write(struct gattlib_long_write_t* long_write, GAttrib *attrib, uint8_t flags) {
+	struct gattlib_group_request_t* execute_write;
+	uint8_t *buf;
+	guint16 plen;
+	guint id;
+#if BLUEZ_VERSION_MAJOR == 4
+	int buflen;
+#else
+	size_t buflen;
+#endif
+
+	execute_write = malloc(sizeof(struct gattlib_group_request_t));
+	if (execute_write == NULL) {
+		long_write->ret = GATTLIB_OUT_OF_MEMORY;
+		return;
+	}
+
+	g_mutex_lock(&long_write->group.mutex);
+	buf = g_attrib_get_buffer(attrib, &buflen);
+	plen = enc_exec_write_req(flags, buf, buflen);
+	if (plen == 0) {
+		free(execute_write);
+		long_write->ret = GATTLIB_DEVICE_ERROR;
+	} else {
+		request_group_add(&long_write->group, execute_write, attrib);
+		id = attrib_send_pdu(attrib, buf, plen, execute_write_cb, execute_write);
+		if (!request_group_sent(&long_write->group, execute_write, id)) {
+			long_write->ret = GATTLIB_DEVICE_ERROR;
+		}
+	}
+	g_mutex_unlock(&long_write->group.mutex);
+}
+
+int gattlib_write_long_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len) {
+	gattlib_context_t* conn_context = connection->context;
+	// The Prepare Write queue of the server is shared by all the bearers but we keep the whole
+	// sequence on a single bearer to preserve the order of the segments and the Execute Write
+	GAttrib* attrib = gattlib_get_attrib(conn_context);
+	struct gattlib_long_write_t* long_write;
+	uint16_t chunk_len;
+	size_t offset;
+	uint8_t *buf;
+	guint16 plen;
+	guint id;
+	int ret;
+#if BLUEZ_VERSION_MAJOR == 4
+	int buflen;
+#else
+	size_t buflen;
+#endif
+
+	if ((buffer == NULL) || (buffer_len == 0) || (buffer_len > ATT_MAX_VALUE_LEN)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	long_write = calloc(1, sizeof(struct gattlib_long_write_t));
+	if (long_write == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	request_group_init(&long_write->group, conn_context, long_write_free);
+	long_write->value  = buffer;
+	long_write->handle = handle;
+	long_write->ret    = GATTLIB_SUCCESS;
+
+	// The GAttrib buffer is as large as the ATT MTU of the bearer
+	g_attrib_get_buffer(attrib, &buflen);
+	chunk_len = buflen - 5; // Prepare Write header: opcode, handle and offset
+
+	// All the segments are queued at once. GAttrib sends the next one as soon as the previous one is acknowledged.
+	for (offset = 0; offset < buffer_len; offset += chunk_len) {
+		struct gattlib_prepare_write_t* prepare_write = malloc(sizeof(struct gattlib_prepare_write_t));
+		if (prepare_write == NULL) {
+			long_write->ret = GATTLIB_OUT_OF_MEMORY;
+			break;
+		}
+		prepare_write->offset = offset;
+		prepare_write->len    = MIN(chunk_len, buffer_len - offset);
+
+		g_mutex_lock(&long_write->group.mutex);
+		buf = g_attrib_get_buffer(attrib, &buflen);
+		plen = enc_prep_write_req(handle, offset, long_write->value + offset, prepare_write->len, buf, buflen);
+		if (plen == 0) {
+			free(prepare_write);
+			id = 0;
+		} else {
+			request_group_add(&long_write->group, &prepare_write->request, attrib);
+			id = attrib_send_pdu(attrib, buf, plen, prepare_write_cb, prepare_write);
+			if (!request_group_sent(&long_write->group, &prepare_write->request, id)) {
+				id = 0;
+			}
+		}
+		if (id == 0) {
+			long_write->ret = GATTLIB_DEVICE_ERROR;
+		}
+		g_mutex_unlock(&long_write->group.mutex);
+
+		if (id == 0) {
+			break;
+		}
+	}
+
+	// Wait for all the segments to be queued by the server
+	ret = request_group_wait(conn_context, &long_write->group);
+	if (ret != GATTLIB_SUCCESS) {
+		// Ask the server to discard the segments it has queued. Nobody waits for the response.
+		buf = g_attrib_get_buffer(attrib, &buflen);
+		plen = enc_exec_write_req(ATT_CANCEL_ALL_PREP_WRITES, buf, buflen);
+		if (plen > 0) {
+			attrib_send_pdu(attrib, buf, plen, NULL, NULL);
+		}
+		goto EXIT;
+	}
+
+	// All the segments have completed: the group is reused for the Execute Write
+	request_group_reset(&long_write->group);
+
+	// Commit the queued segments or discard them if any of them failed
+	execute_write(long_write, attrib, long_write->ret == GATTLIB_SUCCESS ? ATT_WRITE_ALL_PREP_WRITES : ATT_CANCEL_ALL_PREP_WRITES);
+
+	ret = request_group_wait(conn_context, &long_write->group);
+	if (ret == GATTLIB_SUCCESS) {
+		ret = long_write->ret;
+	}
+
+EXIT:
+	request_group_unref(&long_write->group);
+	invalidate_cached_value(connection, handle);
+	return ret;
+}
+
+int gattlib_write_long_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, const void* buffer, size_t buffer_len) {
+	uint16_t handle = 0;
+	int ret;
+
+	ret = get_handle_from_uuid(connection, uuid, &handle);
+	if (ret) {
+		fprintf(stderr, "Fail to find handle for UUID.\n");
+		return ret;
+	}
+
+	return gattlib_write_long_char_by_handle(connection, handle, buffer, buffer_len);
 }
 
 int gattlib_write_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, const void* buffer, size_t buffer_len) {
@@ -212,6 +1045,12 @@ int gattlib_write_without_response_char_by_handle(gatt_connection_t* connection,
 	return GATTLIB_NOT_SUPPORTED;
 }
 
+int gattlib_write_without_response_set_coalescing(gatt_connection_t* connection, const uuid_t* uuid, int enable)
+{
+	// Only supported in the DBUS API (ie: Bluez > v5.40) at the moment
+	return GATTLIB_NOT_SUPPORTED;
+}
+
 int gattlib_notification_start(gatt_connection_t* connection, const uuid_t* uuid) {
 	uint16_t handle;
 	uint16_t enable_notification = 0x0001;
@@ -225,6 +1064,138 @@ int gattlib_notification_start(gatt_connection_t* connection, const uuid_t* uuid
 	return gattlib_write_char_by_handle(connection, handle + 1, &enable_notification, sizeof(enable_notification));
 }
 
+struct gattlib_notification_multiple_context_t {
+	struct gattlib_request_group_t group;
+	// Buffer of the caller. Only accessed with the mutex of the group held.
+	gattlib_notification_multiple_t* notifications;
+	// Set once the result of a characteristic has been given
+	bool*                            done;
+};
+
+struct gattlib_notification_multiple_write_t {
+	struct gattlib_group_request_t request;
+	size_t index;
+};
+
+static void notification_multiple_context_free(struct gattlib_request_group_t* group) {
+	struct gattlib_notification_multiple_context_t* context = (struct gattlib_notification_multiple_context_t*)group;
+
+	free(context->done);
+	free(context);
+}
+
+static void notification_multiple_write_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
+	struct gattlib_notification_multiple_write_t* write = user_data;
+	struct gattlib_notification_multiple_context_t* context = (struct gattlib_notification_multiple_context_t*)write->request.group;
+
+	if (request_group_callback_begin(&write->request)) {
+		if (status != 0) {
+			fprintf(stderr, "Failed to enable notification: %s\n", att_ecode2str(status));
+			context->notifications[write->index].ret = att_ecode_to_gattlib_error(status);
+		} else {
+			context->notifications[write->index].ret = GATTLIB_SUCCESS;
+		}
+		context->done[write->index] = true;
+	}
+	request_group_callback_end(&write->request);
+}
+
+int gattlib_notification_start_multiple(gatt_connection_t* connection, gattlib_notification_multiple_t* notifications, size_t count) {
+	struct gattlib_notification_multiple_context_t* context;
+	gattlib_context_t* conn_context;
+	uint8_t enable_notification[2] = { 0x01, 0x00 };
+	uint16_t *handles;
+	size_t i;
+	int ret;
+
+	if ((connection == NULL) || ((notifications == NULL) && (count > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	context = calloc(1, sizeof(struct gattlib_notification_multiple_context_t));
+	if (context == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	request_group_init(&context->group, conn_context, notification_multiple_context_free);
+	context->notifications = notifications;
+	context->done          = calloc(count + 1, sizeof(bool));
+	handles                = malloc(count * sizeof(uint16_t) + 1);
+	if ((context->done == NULL) || (handles == NULL)) {
+		free(handles);
+		request_group_unref(&context->group);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	// All the characteristics are resolved before any of them is enabled
+	for (i = 0; i < count; i++) {
+		if (notifications[i].handle != 0) {
+			handles[i] = notifications[i].handle;
+			if (g_hash_table_lookup(conn_context->characteristic_by_handle, GUINT_TO_POINTER(handles[i])) == NULL) {
+				notifications[i].ret = GATTLIB_NOT_FOUND;
+			} else {
+				notifications[i].ret = GATTLIB_SUCCESS;
+			}
+		} else {
+			notifications[i].ret = get_handle_from_uuid(connection, &notifications[i].uuid, &handles[i]);
+		}
+		if (notifications[i].ret != GATTLIB_SUCCESS) {
+			context->done[i] = true;
+		}
+	}
+
+	// All the Client Characteristic Configuration writes are queued at once.
+	// GAttrib sends the next request as soon as the previous one completes.
+	for (i = 0; i < count; i++) {
+		struct gattlib_notification_multiple_write_t* write;
+		GAttrib* attrib = gattlib_get_attrib(conn_context);
+		guint id;
+
+		if (context->done[i]) {
+			continue;
+		}
+
+		write = malloc(sizeof(struct gattlib_notification_multiple_write_t));
+		if (write == NULL) {
+			notifications[i].ret = GATTLIB_OUT_OF_MEMORY;
+			context->done[i] = true;
+			continue;
+		}
+		write->index = i;
+
+		g_mutex_lock(&context->group.mutex);
+		request_group_add(&context->group, &write->request, attrib);
+		id = gatt_write_char(attrib, handles[i] + 1, enable_notification, sizeof(enable_notification),
+				notification_multiple_write_cb, write);
+		if (!request_group_sent(&context->group, &write->request, id)) {
+			notifications[i].ret = GATTLIB_DEVICE_ERROR;
+			context->done[i] = true;
+		}
+		g_mutex_unlock(&context->group.mutex);
+	}
+	free(handles);
+
+	ret = request_group_wait(conn_context, &context->group);
+	if (ret != GATTLIB_SUCCESS) {
+		// The characteristics that have not completed take the error of the request
+		for (i = 0; i < count; i++) {
+			if (!context->done[i]) {
+				notifications[i].ret = ret;
+			}
+		}
+	} else {
+		for (i = 0; i < count; i++) {
+			if (notifications[i].ret != GATTLIB_SUCCESS) {
+				ret = notifications[i].ret;
+				break;
+			}
+		}
+	}
+
+	request_group_unref(&context->group);
+	return ret;
+}
+
 int gattlib_notification_stop(gatt_connection_t* connection, const uuid_t* uuid) {
 	uint16_t handle;
 	uint16_t enable_notification = 0x0000;
@@ -0,0 +1,467 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-or-later
+ *
+ * Copyright (c) 2021-2022, Olivier Martin <olivier@labapart.org>
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gattlib_internal.h"
+
+//
+// The load of an adapter is the number of connections the group has opened with it. Each connection
+// takes a share of the radio time, so new connections go to the least loaded adapter and scans run
+// on the least loaded adapters.
+//
+// An adapter that fails an operation is checked against the list of adapters of the system. If it
+// has disappeared or is down (eg: after a reset), it is skipped until it is back. It is closed once
+// the last connection and scan using it are gone.
+//
+
+// Delay before checking again whether an adapter that went down is back
+#define ADAPTER_GROUP_RETRY_PERIOD_US  (2 * 1000000)
+
+struct gattlib_adapter_group_member {
+	char name[16];
+	void *adapter;   // NULL while the adapter is closed
+	// Set when the adapter has gone down. It is not used for new operations until it is back.
+	bool down;
+	int64_t retry_us;
+
+	unsigned int connection_count;
+	// Connections being established with 'adapter'
+	unsigned int pending_connections;
+	bool scanning;
+};
+
+struct gattlib_adapter_group_connection {
+	struct gattlib_adapter_group_connection *next;
+	gatt_connection_t *connection;
+	struct gattlib_adapter_group_member *member;
+};
+
+struct _gattlib_adapter_group_t {
+	pthread_mutex_t mutex;
+
+	struct gattlib_adapter_group_member *members;
+	size_t member_count;
+
+	struct gattlib_adapter_group_connection *connections;
+
+	// Serialize the calls to the handler of the discovered devices
+	pthread_mutex_t scan_mutex;
+	gattlib_discovered_device_t discovered_device_cb;
+	void *discovered_device_user_data;
+};
+
+struct adapter_group_scan {
+	gattlib_adapter_group_t *group;
+	struct gattlib_adapter_group_member *member;
+	size_t timeout;
+	pthread_t thread;
+	int ret;
+};
+
+static int64_t get_monotonic_time_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool is_adapter_up(const char *name) {
+	gattlib_adapter_info_t *adapters;
+	size_t adapters_count;
+	bool up = false;
+
+	if (gattlib_adapter_list(&adapters, &adapters_count) != GATTLIB_SUCCESS) {
+		return false;
+	}
+
+	for (size_t i = 0; i < adapters_count; i++) {
+		if (strcmp(adapters[i].name, name) == 0) {
+			up = adapters[i].powered;
+			break;
+		}
+	}
+
+	free(adapters);
+	return up;
+}
+
+/* Called with the group mutex locked */
+static bool member_is_available(struct gattlib_adapter_group_member *member, int64_t now_us) {
+	if ((member->adapter != NULL) && !member->down) {
+		return true;
+	} else if (now_us < member->retry_us) {
+		return false;
+	}
+
+	member->retry_us = now_us + ADAPTER_GROUP_RETRY_PERIOD_US;
+	if (!is_adapter_up(member->name)) {
+		return false;
+	}
+
+	// The adapter might still be open for the connections it had when it went down
+	if ((member->adapter == NULL) && (gattlib_adapter_open(member->name, &member->adapter) != GATTLIB_SUCCESS)) {
+		member->adapter = NULL;
+		return false;
+	}
+	member->down = false;
+
+	GATTLIB_LOG(GATTLIB_INFO, "Adapter %s is back in its group", member->name);
+	return true;
+}
+
+/* Called with the group mutex locked. Close the adapter that went down once nothing uses it anymore. */
+static void member_release(struct gattlib_adapter_group_member *member) {
+	if (!member->down || (member->adapter == NULL)) {
+		return;
+	}
+	if ((member->connection_count > 0) || (member->pending_connections > 0) || member->scanning) {
+		return;
+	}
+
+	gattlib_adapter_close(member->adapter);
+	member->adapter = NULL;
+}
+
+/*
+ * Called with the group mutex locked after an operation has failed on the adapter.
+ * Return true if the adapter is still up.
+ */
+static bool member_check(struct gattlib_adapter_group_member *member) {
+	if ((member->adapter == NULL) || member->down) {
+		return false;
+	} else if (is_adapter_up(member->name)) {
+		return true;
+	}
+
+	GATTLIB_LOG(GATTLIB_ERROR, "Adapter %s is down, it is removed from its group", member->name);
+
+	// The connections of the adapter are lost. They keep the adapter open until they are disconnected.
+	member->down = true;
+	member->retry_us = get_monotonic_time_us() + ADAPTER_GROUP_RETRY_PERIOD_US;
+	member_release(member);
+	return false;
+}
+
+/* Called with the group mutex locked */
+static struct gattlib_adapter_group_member* get_least_loaded_member(gattlib_adapter_group_t *group,
+		const bool *excluded)
+{
+	struct gattlib_adapter_group_member *best = NULL;
+	int64_t now_us = get_monotonic_time_us();
+
+	for (size_t i = 0; i < group->member_count; i++) {
+		struct gattlib_adapter_group_member *member = &group->members[i];
+
+		if (excluded[i] || !member_is_available(member, now_us)) {
+			continue;
+		}
+		if ((best == NULL) || (member->connection_count < best->connection_count)) {
+			best = member;
+		}
+	}
+
+	return best;
+}
+
+int gattlib_adapter_group_open(const char **adapter_names, size_t adapters_count, gattlib_adapter_group_t **group) {
+	gattlib_adapter_info_t *adapters = NULL;
+	gattlib_adapter_group_t *new_group;
+	size_t i, opened = 0;
+	int ret;
+
+	if (group == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	if (adapter_names == NULL) {
+		ret = gattlib_adapter_list(&adapters, &adapters_count);
+		if (ret != GATTLIB_SUCCESS) {
+			return ret;
+		}
+	}
+
+	if (adapters_count == 0) {
+		free(adapters);
+		return GATTLIB_NOT_FOUND;
+	}
+
+	new_group = calloc(1, sizeof(gattlib_adapter_group_t));
+	if (new_group == NULL) {
+		free(adapters);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	new_group->members = calloc(adapters_count, sizeof(struct gattlib_adapter_group_member));
+	if (new_group->members == NULL) {
+		free(new_group);
+		free(adapters);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	new_group->member_count = adapters_count;
+
+	for (i = 0; i < adapters_count; i++) {
+		struct gattlib_adapter_group_member *member = &new_group->members[i];
+		const char *name = (adapter_names != NULL) ? adapter_names[i] : adapters[i].name;
+
+		snprintf(member->name, sizeof(member->name), "%s", name);
+
+		// An adapter that cannot be opened yet is retried when the group is used
+		ret = gattlib_adapter_open(member->name, &member->adapter);
+		if (ret != GATTLIB_SUCCESS) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Failed to open adapter %s (error:%d)", member->name, ret);
+			member->adapter = NULL;
+		} else {
+			opened++;
+		}
+	}
+	free(adapters);
+
+	if (opened == 0) {
+		free(new_group->members);
+		free(new_group);
+		return GATTLIB_NOT_FOUND;
+	}
+
+	pthread_mutex_init(&new_group->mutex, NULL);
+	pthread_mutex_init(&new_group->scan_mutex, NULL);
+
+	*group = new_group;
+	return GATTLIB_SUCCESS;
+}
+
+gatt_connection_t *gattlib_adapter_group_connect(gattlib_adapter_group_t *group, const char *dst, unsigned long options) {
+	struct gattlib_adapter_group_connection *group_connection;
+	struct gattlib_adapter_group_member *member;
+	gatt_connection_t *connection = NULL;
+	bool *excluded;
+
+	if ((group == NULL) || (dst == NULL)) {
+		return NULL;
+	}
+
+	group_connection = calloc(1, sizeof(struct gattlib_adapter_group_connection));
+	excluded = calloc(group->member_count, sizeof(bool));
+	if ((group_connection == NULL) || (excluded == NULL)) {
+		free(group_connection);
+		free(excluded);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&group->mutex);
+
+	while ((member = get_least_loaded_member(group, excluded)) != NULL) {
+		// Account the connection while it is established to spread the concurrent connections
+		member->connection_count++;
+		member->pending_connections++;
+		pthread_mutex_unlock(&group->mutex);
+
+		connection = gattlib_connect(member->adapter, dst, options);
+
+		pthread_mutex_lock(&group->mutex);
+		member->pending_connections--;
+		if (connection != NULL) {
+			break;
+		}
+		member->connection_count--;
+		// The adapter might have gone down while connecting
+		member_release(member);
+
+		// Fail over to another adapter only if the failure comes from the adapter
+		if (member_check(member)) {
+			break;
+		}
+		excluded[member - group->members] = true;
+	}
+
+	if (connection != NULL) {
+		group_connection->connection = connection;
+		group_connection->member = member;
+		group_connection->next = group->connections;
+		group->connections = group_connection;
+	} else {
+		free(group_connection);
+	}
+
+	pthread_mutex_unlock(&group->mutex);
+	free(excluded);
+
+	return connection;
+}
+
+int gattlib_adapter_group_disconnect(gattlib_adapter_group_t *group, gatt_connection_t *connection) {
+	struct gattlib_adapter_group_connection **link, *group_connection;
+	int ret;
+
+	if ((group == NULL) || (connection == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	pthread_mutex_lock(&group->mutex);
+	for (link = &group->connections; *link != NULL; link = &(*link)->next) {
+		if ((*link)->connection == connection) {
+			break;
+		}
+	}
+
+	group_connection = *link;
+	if (group_connection == NULL) {
+		pthread_mutex_unlock(&group->mutex);
+		return GATTLIB_NOT_FOUND;
+	}
+	*link = group_connection->next;
+	pthread_mutex_unlock(&group->mutex);
+
+	ret = gattlib_disconnect(connection);
+
+	// The adapter is closed after its last connection if it went down meanwhile
+	pthread_mutex_lock(&group->mutex);
+	group_connection->member->connection_count--;
+	member_release(group_connection->member);
+	pthread_mutex_unlock(&group->mutex);
+
+	free(group_connection);
+	return ret;
+}
+
+static void on_group_discovered_device(void *adapter, const char* addr, const char* name, void *user_data) {
+	gattlib_adapter_group_t *group = user_data;
+
+	pthread_mutex_lock(&group->scan_mutex);
+	group->discovered_device_cb(adapter, addr, name, group->discovered_device_user_data);
+	pthread_mutex_unlock(&group->scan_mutex);
+}
+
+static void *adapter_group_scan_thread(void *arg) {
+	struct adapter_group_scan *scan = arg;
+
+	scan->ret = gattlib_adapter_scan_enable(scan->member->adapter, on_group_discovered_device, scan->timeout, scan->group);
+	return NULL;
+}
+
+int gattlib_adapter_group_scan_enable(gattlib_adapter_group_t *group, gattlib_discovered_device_t discovered_device_cb,
+		size_t timeout, void *user_data)
+{
+	struct adapter_group_scan *scans;
+	unsigned int min_load = UINT32_MAX;
+	int64_t now_us = get_monotonic_time_us();
+	size_t i, scan_count = 0;
+	int ret = GATTLIB_SUCCESS;
+
+	if ((group == NULL) || (discovered_device_cb == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	scans = calloc(group->member_count, sizeof(struct adapter_group_scan));
+	if (scans == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	pthread_mutex_lock(&group->mutex);
+
+	group->discovered_device_cb = discovered_device_cb;
+	group->discovered_device_user_data = user_data;
+
+	for (i = 0; i < group->member_count; i++) {
+		struct gattlib_adapter_group_member *member = &group->members[i];
+
+		if (member_is_available(member, now_us) && (member->connection_count < min_load)) {
+			min_load = member->connection_count;
+		}
+	}
+
+	// Scan with the adapters whose radio time is not taken by more connections than the others
+	for (i = 0; i < group->member_count; i++) {
+		struct gattlib_adapter_group_member *member = &group->members[i];
+
+		if ((member->adapter == NULL) || member->down || member->scanning || (member->connection_count != min_load)) {
+			continue;
+		}
+
+		scans[scan_count].group = group;
+		scans[scan_count].member = member;
+		scans[scan_count].timeout = timeout;
+		if (pthread_create(&scans[scan_count].thread, NULL, adapter_group_scan_thread, &scans[scan_count]) != 0) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Cannot create scan thread for adapter %s", member->name);
+			continue;
+		}
+		member->scanning = true;
+		scan_count++;
+	}
+
+	pthread_mutex_unlock(&group->mutex);
+
+	if (scan_count == 0) {
+		free(scans);
+		return GATTLIB_NOT_FOUND;
+	}
+
+	for (i = 0; i < scan_count; i++) {
+		pthread_join(scans[i].thread, NULL);
+	}
+
+	pthread_mutex_lock(&group->mutex);
+	for (i = 0; i < scan_count; i++) {
+		scans[i].member->scanning = false;
+		if (scans[i].ret != GATTLIB_SUCCESS) {
+			member_check(scans[i].member);
+			ret = scans[i].ret;
+		}
+		member_release(scans[i].member);
+	}
+	pthread_mutex_unlock(&group->mutex);
+
+	free(scans);
+	return ret;
+}
+
+int gattlib_adapter_group_scan_disable(gattlib_adapter_group_t *group) {
+	if (group == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	pthread_mutex_lock(&group->mutex);
+	for (size_t i = 0; i < group->member_count; i++) {
+		struct gattlib_adapter_group_member *member = &group->members[i];
+
+		if (member->scanning) {
+			gattlib_adapter_scan_disable(member->adapter);
+		}
+	}
+	pthread_mutex_unlock(&group->mutex);
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_group_close(gattlib_adapter_group_t *group) {
+	struct gattlib_adapter_group_connection *group_connection;
+
+	if (group == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	while (group->connections != NULL) {
+		group_connection = group->connections;
+		group->connections = group_connection->next;
+		free(group_connection);
+	}
+
+	for (size_t i = 0; i < group->member_count; i++) {
+		if (group->members[i].adapter != NULL) {
+			gattlib_adapter_close(group->members[i].adapter);
+		}
+	}
+
+	pthread_mutex_destroy(&group->scan_mutex);
+	pthread_mutex_destroy(&group->mutex);
+	free(group->members);
+	free(group);
+
+	return GATTLIB_SUCCESS;
+}
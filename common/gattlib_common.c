@@ -185,3 +185,38 @@ int gattlib_uuid_cmp(const uuid_t *uuid1, const uuid_t *uuid2) {
 		return 3;
 	}
 }
+
+static const gattlib_connection_parameters_t m_connection_profiles[] = {
+	// 7.5ms to 11.25ms interval, 1s supervision timeout
+	[GATTLIB_CONNECTION_PROFILE_LOW_LATENCY] = {
+		.min_interval = 6, .max_interval = 9, .latency = 0, .supervision_timeout = 100
+	},
+	// 7.5ms interval, 2s supervision timeout
+	[GATTLIB_CONNECTION_PROFILE_HIGH_THROUGHPUT] = {
+		.min_interval = 6, .max_interval = 6, .latency = 0, .supervision_timeout = 200
+	},
+	// 30ms to 50ms interval, 4.2s supervision timeout
+	[GATTLIB_CONNECTION_PROFILE_BALANCED] = {
+		.min_interval = 24, .max_interval = 40, .latency = 0, .supervision_timeout = 420
+	},
+	// 100ms to 200ms interval, 4 connection events can be skipped, 6s supervision timeout
+	[GATTLIB_CONNECTION_PROFILE_POWER_SAVING] = {
+		.min_interval = 80, .max_interval = 160, .latency = 4, .supervision_timeout = 600
+	},
+};
+
+int gattlib_connection_set_profile(gatt_connection_t* connection, int profile) {
+	int ret;
+
+	if ((profile < 0) || (profile >= (int)(sizeof(m_connection_profiles) / sizeof(m_connection_profiles[0])))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	ret = gattlib_connection_set_parameters(connection, &m_connection_profiles[profile]);
+	if ((ret == GATTLIB_SUCCESS) && (profile == GATTLIB_CONNECTION_PROFILE_HIGH_THROUGHPUT)) {
+		// Best effort: controllers prior to Bluetooth 4.2/5.0 do not support DLE/2M PHY
+		gattlib_connection_set_data_length(connection, 251, 2120);
+		gattlib_connection_set_phy(connection, GATTLIB_PHY_MASK_2M, GATTLIB_PHY_MASK_2M);
+	}
+	return ret;
+}
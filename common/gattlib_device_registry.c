@@ -0,0 +1,472 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-or-later
+ *
+ * Copyright (c) 2021-2022, Olivier Martin <olivier@labapart.org>
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gattlib_internal.h"
+
+//
+// The registry is an open addressing hash table (linear probing) keyed by the 48-bit MAC
+// address. Records are stored inline in the slots so a lookup only touches contiguous memory.
+// The slots are also chained by slot index in a list ordered by 'last_seen' (least recently
+// seen first) so the eviction of the oldest record does not scan the table.
+//
+
+#define REGISTRY_INITIAL_CAPACITY     64
+
+// RSSI is smoothed with an exponential moving average: avg += (rssi - avg) / 2^REGISTRY_RSSI_EMA_SHIFT
+// The average is kept in fixed point with REGISTRY_RSSI_FRACTION_BITS fractional bits.
+#define REGISTRY_RSSI_EMA_SHIFT       2
+#define REGISTRY_RSSI_FRACTION_BITS   4
+
+// End of the list of the slots ordered by 'last_seen'
+#define REGISTRY_LRU_NONE             SIZE_MAX
+
+struct gattlib_device_registry_slot {
+	uint64_t key;       // 0 when the slot is free
+	int32_t rssi_fixed; // Smoothed RSSI in fixed point
+	// Previous (seen before) and next (seen after) slots
+	size_t lru_prev;
+	size_t lru_next;
+	gattlib_device_record_t record;
+};
+
+struct gattlib_device_registry {
+	pthread_mutex_t mutex;
+	struct gattlib_device_registry_slot *slots;
+	size_t capacity; // Always a power of 2
+	size_t count;
+	// Least and most recently seen slots
+	size_t lru_head;
+	size_t lru_tail;
+	// Maximum number of records. 0 when unbounded.
+	size_t max_devices;
+};
+
+static uint64_t mac_to_key(const uint8_t address[6]) {
+	uint64_t key = 0;
+
+	for (int i = 0; i < 6; i++) {
+		key = (key << 8) | address[i];
+	}
+
+	// Bit 48 is always set to never have the reserved key 0 for the address 00:00:00:00:00:00
+	return key | (1ULL << 48);
+}
+
+static size_t key_to_index(uint64_t key, size_t capacity) {
+	// Mix the key (splitmix64 finalizer). MAC addresses of a same vendor share their upper bytes.
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return key & (capacity - 1);
+}
+
+static int64_t get_monotonic_time_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int hex_digit(char c) {
+	if ((c >= '0') && (c <= '9')) {
+		return c - '0';
+	} else if ((c >= 'a') && (c <= 'f')) {
+		return c - 'a' + 10;
+	} else if ((c >= 'A') && (c <= 'F')) {
+		return c - 'A' + 10;
+	} else {
+		return -1;
+	}
+}
+
+int gattlib_string_to_mac(const char *str, uint8_t address[6]) {
+	for (int i = 0; i < 6; i++) {
+		int high = hex_digit(str[0]);
+		int low = (high < 0) ? -1 : hex_digit(str[1]);
+
+		if (low < 0) {
+			return GATTLIB_INVALID_PARAMETER;
+		}
+		if ((i < 5) && (str[2] != ':')) {
+			return GATTLIB_INVALID_PARAMETER;
+		}
+
+		address[i] = (high << 4) | low;
+		str += 3;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+struct gattlib_device_registry* gattlib_device_registry_new(void) {
+	struct gattlib_device_registry *registry = calloc(1, sizeof(struct gattlib_device_registry));
+	if (registry == NULL) {
+		return NULL;
+	}
+
+	registry->slots = calloc(REGISTRY_INITIAL_CAPACITY, sizeof(struct gattlib_device_registry_slot));
+	if (registry->slots == NULL) {
+		free(registry);
+		return NULL;
+	}
+	registry->capacity = REGISTRY_INITIAL_CAPACITY;
+	registry->lru_head = REGISTRY_LRU_NONE;
+	registry->lru_tail = REGISTRY_LRU_NONE;
+	registry->max_devices = GATTLIB_DEVICE_REGISTRY_DEFAULT_MAX_DEVICES;
+
+	pthread_mutex_init(&registry->mutex, NULL);
+	return registry;
+}
+
+void gattlib_device_registry_free(struct gattlib_device_registry *registry) {
+	if (registry == NULL) {
+		return;
+	}
+
+	pthread_mutex_destroy(&registry->mutex);
+	free(registry->slots);
+	free(registry);
+}
+
+static struct gattlib_device_registry_slot* registry_find_slot(struct gattlib_device_registry *registry, uint64_t key) {
+	size_t index = key_to_index(key, registry->capacity);
+
+	// The table is never full. We always end up on the key or on a free slot.
+	while (registry->slots[index].key != 0) {
+		if (registry->slots[index].key == key) {
+			return &registry->slots[index];
+		}
+		index = (index + 1) & (registry->capacity - 1);
+	}
+	return &registry->slots[index];
+}
+
+static void registry_lru_append(struct gattlib_device_registry *registry, size_t index) {
+	registry->slots[index].lru_prev = registry->lru_tail;
+	registry->slots[index].lru_next = REGISTRY_LRU_NONE;
+
+	if (registry->lru_tail == REGISTRY_LRU_NONE) {
+		registry->lru_head = index;
+	} else {
+		registry->slots[registry->lru_tail].lru_next = index;
+	}
+	registry->lru_tail = index;
+}
+
+static void registry_lru_unlink(struct gattlib_device_registry *registry, size_t index) {
+	size_t prev = registry->slots[index].lru_prev;
+	size_t next = registry->slots[index].lru_next;
+
+	if (prev == REGISTRY_LRU_NONE) {
+		registry->lru_head = next;
+	} else {
+		registry->slots[prev].lru_next = next;
+	}
+
+	if (next == REGISTRY_LRU_NONE) {
+		registry->lru_tail = prev;
+	} else {
+		registry->slots[next].lru_prev = prev;
+	}
+}
+
+// Point the neighbours of a slot that has just been moved to 'index' to its new location
+static void registry_lru_relink(struct gattlib_device_registry *registry, size_t index) {
+	size_t prev = registry->slots[index].lru_prev;
+	size_t next = registry->slots[index].lru_next;
+
+	if (prev == REGISTRY_LRU_NONE) {
+		registry->lru_head = index;
+	} else {
+		registry->slots[prev].lru_next = index;
+	}
+
+	if (next == REGISTRY_LRU_NONE) {
+		registry->lru_tail = index;
+	} else {
+		registry->slots[next].lru_prev = index;
+	}
+}
+
+static int registry_grow(struct gattlib_device_registry *registry) {
+	struct gattlib_device_registry_slot *old_slots = registry->slots;
+	size_t old_capacity = registry->capacity;
+	size_t old_index = registry->lru_head;
+
+	registry->slots = calloc(old_capacity * 2, sizeof(struct gattlib_device_registry_slot));
+	if (registry->slots == NULL) {
+		registry->slots = old_slots;
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	registry->capacity = old_capacity * 2;
+	registry->lru_head = REGISTRY_LRU_NONE;
+	registry->lru_tail = REGISTRY_LRU_NONE;
+
+	// Walk the slots in their 'last_seen' order to rebuild the list in the new table
+	while (old_index != REGISTRY_LRU_NONE) {
+		struct gattlib_device_registry_slot *slot = registry_find_slot(registry, old_slots[old_index].key);
+
+		*slot = old_slots[old_index];
+		registry_lru_append(registry, slot - registry->slots);
+		old_index = old_slots[old_index].lru_next;
+	}
+
+	free(old_slots);
+	return GATTLIB_SUCCESS;
+}
+
+static void registry_remove_slot(struct gattlib_device_registry *registry, struct gattlib_device_registry_slot *slot) {
+	size_t hole, index;
+
+	// Backward shift deletion: move back the following entries of the probe sequence
+	// that would not be reachable anymore once the slot is freed.
+	hole = slot - registry->slots;
+	index = hole;
+	registry_lru_unlink(registry, hole);
+	while (true) {
+		index = (index + 1) & (registry->capacity - 1);
+		if (registry->slots[index].key == 0) {
+			break;
+		}
+
+		size_t ideal = key_to_index(registry->slots[index].key, registry->capacity);
+		// Check if 'ideal' is cyclically outside of ]hole, index]
+		if (((index - ideal) & (registry->capacity - 1)) >= ((index - hole) & (registry->capacity - 1))) {
+			registry->slots[hole] = registry->slots[index];
+			registry_lru_relink(registry, hole);
+			hole = index;
+		}
+	}
+	registry->slots[hole].key = 0;
+	registry->count--;
+}
+
+static void registry_evict_oldest(struct gattlib_device_registry *registry) {
+	if (registry->lru_head != REGISTRY_LRU_NONE) {
+		registry_remove_slot(registry, &registry->slots[registry->lru_head]);
+	}
+}
+
+static void registry_update_payload(gattlib_device_record_t *record,
+		const gattlib_advertisement_data_t *advertisement_data, size_t advertisement_data_count,
+		uint16_t manufacturer_id, const uint8_t *manufacturer_data, size_t manufacturer_data_size)
+{
+	if (manufacturer_data != NULL) {
+		record->manufacturer_id = manufacturer_id;
+		record->manufacturer_data_length = MIN(manufacturer_data_size, GATTLIB_ADVERTISEMENT_DATA_MAX_LEN);
+		memcpy(record->manufacturer_data, manufacturer_data, record->manufacturer_data_length);
+	}
+
+	if (advertisement_data != NULL) {
+		record->service_data_count = MIN(advertisement_data_count, (size_t)GATTLIB_DEVICE_RECORD_MAX_SERVICE_DATA);
+		for (size_t i = 0; i < record->service_data_count; i++) {
+			record->service_data[i].uuid = advertisement_data[i].uuid;
+			record->service_data[i].data_length = MIN(advertisement_data[i].data_length, GATTLIB_ADVERTISEMENT_DATA_MAX_LEN);
+			memcpy(record->service_data[i].data, advertisement_data[i].data, record->service_data[i].data_length);
+		}
+	}
+}
+
+int gattlib_device_registry_update(struct gattlib_device_registry *registry, const uint8_t address[6], int16_t rssi,
+		const gattlib_advertisement_data_t *advertisement_data, size_t advertisement_data_count,
+		uint16_t manufacturer_id, const uint8_t *manufacturer_data, size_t manufacturer_data_size)
+{
+	uint64_t key = mac_to_key(address);
+	struct gattlib_device_registry_slot *slot;
+
+	pthread_mutex_lock(&registry->mutex);
+
+	slot = registry_find_slot(registry, key);
+	if (slot->key == 0) {
+		// The registry is full, make room by evicting the least recently seen device
+		if ((registry->max_devices > 0) && (registry->count >= registry->max_devices)) {
+			while (registry->count >= registry->max_devices) {
+				registry_evict_oldest(registry);
+			}
+			slot = registry_find_slot(registry, key);
+		}
+
+		// Keep the load factor under 1/2 to keep probe sequences short
+		if ((registry->count + 1) * 2 > registry->capacity) {
+			int ret = registry_grow(registry);
+			if (ret != GATTLIB_SUCCESS) {
+				pthread_mutex_unlock(&registry->mutex);
+				return ret;
+			}
+			slot = registry_find_slot(registry, key);
+		}
+
+		memset(slot, 0, sizeof(*slot));
+		slot->key = key;
+		memcpy(slot->record.address, address, sizeof(slot->record.address));
+		registry->count++;
+	} else {
+		registry_lru_unlink(registry, slot - registry->slots);
+	}
+	// The device is now the most recently seen one
+	registry_lru_append(registry, slot - registry->slots);
+
+	// A RSSI of 0 means the RSSI is unknown for this observation
+	if (rssi != 0) {
+		if (slot->rssi_fixed == 0) {
+			slot->rssi_fixed = rssi * (1 << REGISTRY_RSSI_FRACTION_BITS);
+		} else {
+			slot->rssi_fixed += ((rssi * (1 << REGISTRY_RSSI_FRACTION_BITS)) - slot->rssi_fixed) >> REGISTRY_RSSI_EMA_SHIFT;
+		}
+		slot->record.last_rssi = rssi;
+		slot->record.rssi = slot->rssi_fixed >> REGISTRY_RSSI_FRACTION_BITS;
+	}
+
+	slot->record.last_seen = get_monotonic_time_us();
+	slot->record.observation_count++;
+	registry_update_payload(&slot->record, advertisement_data, advertisement_data_count,
+			manufacturer_id, manufacturer_data, manufacturer_data_size);
+
+	pthread_mutex_unlock(&registry->mutex);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_device_registry_remove(struct gattlib_device_registry *registry, const uint8_t address[6]) {
+	struct gattlib_device_registry_slot *slot;
+
+	pthread_mutex_lock(&registry->mutex);
+
+	slot = registry_find_slot(registry, mac_to_key(address));
+	if (slot->key == 0) {
+		pthread_mutex_unlock(&registry->mutex);
+		return GATTLIB_NOT_FOUND;
+	}
+	registry_remove_slot(registry, slot);
+
+	pthread_mutex_unlock(&registry->mutex);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_device_registry_get(void *adapter, const char *mac_address, gattlib_device_record_t *record) {
+	struct gattlib_device_registry *registry = gattlib_adapter_get_device_registry(adapter);
+	struct gattlib_device_registry_slot *slot;
+	uint8_t address[6];
+	int ret;
+
+	if (registry == NULL) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+	if ((mac_address == NULL) || (record == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	ret = gattlib_string_to_mac(mac_address, address);
+	if (ret != GATTLIB_SUCCESS) {
+		return ret;
+	}
+
+	pthread_mutex_lock(&registry->mutex);
+
+	slot = registry_find_slot(registry, mac_to_key(address));
+	if (slot->key == 0) {
+		ret = GATTLIB_NOT_FOUND;
+	} else {
+		*record = slot->record;
+		ret = GATTLIB_SUCCESS;
+	}
+
+	pthread_mutex_unlock(&registry->mutex);
+	return ret;
+}
+
+int gattlib_device_registry_snapshot(void *adapter, gattlib_device_record_t **records, size_t *records_count) {
+	struct gattlib_device_registry *registry = gattlib_adapter_get_device_registry(adapter);
+	size_t count = 0;
+
+	if (registry == NULL) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+	if ((records == NULL) || (records_count == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	pthread_mutex_lock(&registry->mutex);
+
+	*records = malloc(MAX(registry->count, 1) * sizeof(gattlib_device_record_t));
+	if (*records == NULL) {
+		pthread_mutex_unlock(&registry->mutex);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	for (size_t i = 0; i < registry->capacity; i++) {
+		if (registry->slots[i].key != 0) {
+			(*records)[count++] = registry->slots[i].record;
+		}
+	}
+	*records_count = count;
+
+	pthread_mutex_unlock(&registry->mutex);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_device_registry_foreach(void *adapter, gattlib_device_record_cb_t record_cb, void *user_data) {
+	struct gattlib_device_registry *registry = gattlib_adapter_get_device_registry(adapter);
+
+	if (registry == NULL) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+	if (record_cb == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	pthread_mutex_lock(&registry->mutex);
+
+	for (size_t i = 0; i < registry->capacity; i++) {
+		if (registry->slots[i].key != 0) {
+			record_cb(adapter, &registry->slots[i].record, user_data);
+		}
+	}
+
+	pthread_mutex_unlock(&registry->mutex);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_device_registry_set_max_devices(void *adapter, size_t max_devices) {
+	struct gattlib_device_registry *registry = gattlib_adapter_get_device_registry(adapter);
+
+	if (registry == NULL) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+	pthread_mutex_lock(&registry->mutex);
+	registry->max_devices = max_devices;
+	if (max_devices > 0) {
+		while (registry->count > max_devices) {
+			registry_evict_oldest(registry);
+		}
+	}
+	pthread_mutex_unlock(&registry->mutex);
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_device_registry_clear(void *adapter) {
+	struct gattlib_device_registry *registry = gattlib_adapter_get_device_registry(adapter);
+
+	if (registry == NULL) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+	pthread_mutex_lock(&registry->mutex);
+	memset(registry->slots, 0, registry->capacity * sizeof(struct gattlib_device_registry_slot));
+	registry->count = 0;
+	registry->lru_head = REGISTRY_LRU_NONE;
+	registry->lru_tail = REGISTRY_LRU_NONE;
+	pthread_mutex_unlock(&registry->mutex);
+
+	return GATTLIB_SUCCESS;
+}
@@ -35,4 +35,47 @@ bool gattlib_has_valid_handler(struct gattlib_handler *handler);
 void gattlib_call_disconnection_handler(struct gattlib_handler *handler);
 void gattlib_call_notification_handler(struct gattlib_handler *handler, const uuid_t* uuid, const uint8_t* data, size_t data_length);
 
+struct gattlib_device_registry;
+
+struct gattlib_device_registry* gattlib_device_registry_new(void);
+void gattlib_device_registry_free(struct gattlib_device_registry *registry);
+int gattlib_device_registry_update(struct gattlib_device_registry *registry, const uint8_t address[6], int16_t rssi,
+		const gattlib_advertisement_data_t *advertisement_data, size_t advertisement_data_count,
+		uint16_t manufacturer_id, const uint8_t *manufacturer_data, size_t manufacturer_data_size);
+int gattlib_device_registry_remove(struct gattlib_device_registry *registry, const uint8_t address[6]);
+
+// Implemented by the backend. Return NULL if the adapter has no device registry.
+struct gattlib_device_registry* gattlib_adapter_get_device_registry(void *adapter);
+
+// Read the value of a characteristic. Used by gattlib_read_coalescer_read() to issue the request.
+typedef int (*gattlib_read_coalescer_read_t)(void* user_data, void** buffer, size_t* buffer_len);
+
+struct gattlib_read_coalescer;
+
+struct gattlib_read_coalescer* gattlib_read_coalescer_new(void);
+void gattlib_read_coalescer_free(struct gattlib_read_coalescer *coalescer);
+// Read the characteristic 'uuid' with 'read' unless another thread is already reading it. In that case,
+// wait for the result of this read and return a copy of its value.
+int gattlib_read_coalescer_read(struct gattlib_read_coalescer *coalescer, const uuid_t* uuid,
+		gattlib_read_coalescer_read_t read, void* user_data, void** buffer, size_t* buffer_len);
+
+struct gattlib_value_cache;
+
+struct gattlib_value_cache* gattlib_value_cache_new(void);
+void gattlib_value_cache_free(struct gattlib_value_cache *cache);
+// A TTL of 0 disables the cache
+void gattlib_value_cache_set_ttl(struct gattlib_value_cache *cache, unsigned int ttl_ms);
+// Return true and a copy of the value if it is in the cache and has not expired
+bool gattlib_value_cache_get(struct gattlib_value_cache *cache, const uuid_t* uuid, void** buffer, size_t* buffer_len);
+// Sequence number to pass to gattlib_value_cache_update_from_read() for a read starting now
+uint64_t gattlib_value_cache_sequence(struct gattlib_value_cache *cache);
+// Store a value read from the device unless the entry has changed since the read started
+void gattlib_value_cache_update_from_read(struct gattlib_value_cache *cache, const uuid_t* uuid,
+		const void* value, size_t value_len, uint64_t sequence);
+// Store a notified value
+void gattlib_value_cache_update(struct gattlib_value_cache *cache, const uuid_t* uuid, const void* value, size_t value_len);
+void gattlib_value_cache_invalidate(struct gattlib_value_cache *cache, const uuid_t* uuid);
+
+int gattlib_string_to_mac(const char *str, uint8_t address[6]);
+
 #endif
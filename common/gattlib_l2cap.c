@@ -0,0 +1,318 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-or-later
+ *
+ * Copyright (c) 2021-2022, Olivier Martin <olivier@labapart.org>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/l2cap.h>
+
+#include "gattlib_internal.h"
+
+//
+// LE Credit Based Connection Oriented Channels are handled by the kernel: it segments the SDUs
+// into PDUs of at most MPS bytes and only sends them while the remote device grants credits.
+// When the remote device runs out of credits, the socket stops being writable.
+//
+
+#ifndef BT_SNDMTU
+  #define BT_SNDMTU  12
+#endif
+#ifndef BT_RCVMTU
+  #define BT_RCVMTU  13
+#endif
+
+// Smallest SDU size allowed by the Bluetooth specification for LE Credit Based channels
+#define L2CAP_LE_MIN_MTU  23
+
+struct _gattlib_l2cap_channel_t {
+	int fd;
+};
+
+static int errno_to_gattlib_error(int err) {
+	switch (err) {
+	case ENOMEM:
+		return GATTLIB_OUT_OF_MEMORY;
+	case EINVAL:
+		return GATTLIB_INVALID_PARAMETER;
+	case EPROTONOSUPPORT:
+	case EOPNOTSUPP:
+	case ENOPROTOOPT:
+		return GATTLIB_NOT_SUPPORTED;
+	case ETIMEDOUT:
+		return GATTLIB_TIMEOUT;
+	default:
+		return GATTLIB_DEVICE_ERROR;
+	}
+}
+
+/* Convert a MAC address into a Bluetooth address, whose bytes are stored in reverse order */
+static int string_to_bdaddr(const char *str, bdaddr_t *bdaddr) {
+	uint8_t address[6];
+	int ret, i;
+
+	ret = gattlib_string_to_mac(str, address);
+	if (ret != GATTLIB_SUCCESS) {
+		return ret;
+	}
+
+	for (i = 0; i < 6; i++) {
+		bdaddr->b[i] = address[5 - i];
+	}
+	return GATTLIB_SUCCESS;
+}
+
+/* Wait for the channel to be ready. A negative timeout waits forever. */
+static int wait_channel(int fd, short events, int timeout_ms) {
+	struct pollfd p = { .fd = fd, .events = events };
+	int ret;
+
+	do {
+		ret = poll(&p, 1, timeout_ms);
+	} while ((ret < 0) && (errno == EINTR));
+
+	if (ret < 0) {
+		return errno_to_gattlib_error(errno);
+	} else if (ret == 0) {
+		return GATTLIB_TIMEOUT;
+	} else if ((p.revents & (POLLERR | POLLHUP)) && !(p.revents & events)) {
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_l2cap_connect(const char *src, const char *dst, uint8_t dst_type, uint16_t psm,
+		const gattlib_l2cap_options_t *options, gattlib_l2cap_channel_t **channel)
+{
+	struct sockaddr_l2 addr;
+	int fd, ret, flags;
+
+	if ((dst == NULL) || (channel == NULL) || (psm == 0) ||
+	    ((dst_type != BDADDR_LE_PUBLIC) && (dst_type != BDADDR_LE_RANDOM))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	if ((options != NULL) && (options->mtu != 0) && (options->mtu < L2CAP_LE_MIN_MTU)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	if ((strlen(dst) != 17) || ((src != NULL) && (strlen(src) != 17))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	fd = socket(PF_BLUETOOTH, SOCK_SEQPACKET | SOCK_CLOEXEC, BTPROTO_L2CAP);
+	if (fd < 0) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to create L2CAP socket: %s", strerror(errno));
+		return errno_to_gattlib_error(errno);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.l2_family = AF_BLUETOOTH;
+	addr.l2_bdaddr_type = BDADDR_LE_PUBLIC;
+	if (src != NULL) {
+		ret = string_to_bdaddr(src, &addr.l2_bdaddr);
+		if (ret != GATTLIB_SUCCESS) {
+			goto ERROR;
+		}
+	}
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to bind L2CAP socket: %s", strerror(errno));
+		ret = errno_to_gattlib_error(errno);
+		goto ERROR;
+	}
+
+	if (options != NULL) {
+		if (options->security_level != 0) {
+			struct bt_security sec = { .level = options->security_level };
+
+			if (setsockopt(fd, SOL_BLUETOOTH, BT_SECURITY, &sec, sizeof(sec)) < 0) {
+				GATTLIB_LOG(GATTLIB_ERROR, "Failed to set L2CAP security level: %s", strerror(errno));
+				ret = errno_to_gattlib_error(errno);
+				goto ERROR;
+			}
+		}
+
+		// The kernel derives the MPS and the initial credits from the receive MTU.
+		// Kernels that only allow it on Enhanced Credit Based channels (without the 'enable_ecred'
+		// parameter of the bluetooth module) reject it with EPERM or EINVAL: the kernel default is kept.
+		if (options->mtu != 0) {
+			if (setsockopt(fd, SOL_BLUETOOTH, BT_RCVMTU, &options->mtu, sizeof(options->mtu)) < 0) {
+				if ((errno == EPERM) || (errno == EINVAL)) {
+					GATTLIB_LOG(GATTLIB_WARNING, "L2CAP receive MTU not supported by the kernel (%s). Use its default.",
+							strerror(errno));
+				} else {
+					GATTLIB_LOG(GATTLIB_ERROR, "Failed to set L2CAP receive MTU: %s", strerror(errno));
+					ret = errno_to_gattlib_error(errno);
+					goto ERROR;
+				}
+			}
+		}
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.l2_family = AF_BLUETOOTH;
+	addr.l2_psm = htobs(psm);
+	addr.l2_bdaddr_type = dst_type;
+	ret = string_to_bdaddr(dst, &addr.l2_bdaddr);
+	if (ret != GATTLIB_SUCCESS) {
+		goto ERROR;
+	}
+
+	// Connect in non-blocking mode to honour the connection timeout
+	flags = fcntl(fd, F_GETFL);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		int err = 0;
+		socklen_t len = sizeof(err);
+
+		if (errno != EINPROGRESS) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Failed to connect L2CAP channel: %s", strerror(errno));
+			ret = errno_to_gattlib_error(errno);
+			goto ERROR;
+		}
+
+		ret = wait_channel(fd, POLLOUT, ((options != NULL) && (options->connect_timeout_ms > 0)) ? options->connect_timeout_ms : -1);
+		if (ret != GATTLIB_SUCCESS) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Failed to connect L2CAP channel (error:%d)", ret);
+			goto ERROR;
+		}
+
+		getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+		if (err != 0) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Failed to connect L2CAP channel: %s", strerror(err));
+			ret = errno_to_gattlib_error(err);
+			goto ERROR;
+		}
+	}
+
+	*channel = calloc(1, sizeof(gattlib_l2cap_channel_t));
+	if (*channel == NULL) {
+		ret = GATTLIB_OUT_OF_MEMORY;
+		goto ERROR;
+	}
+	(*channel)->fd = fd;
+
+	return GATTLIB_SUCCESS;
+
+ERROR:
+	close(fd);
+	return ret;
+}
+
+int gattlib_l2cap_get_mtu(gattlib_l2cap_channel_t *channel, uint16_t *tx_mtu, uint16_t *rx_mtu) {
+	socklen_t len;
+
+	if (channel == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	if (tx_mtu != NULL) {
+		len = sizeof(*tx_mtu);
+		if (getsockopt(channel->fd, SOL_BLUETOOTH, BT_SNDMTU, tx_mtu, &len) < 0) {
+			return errno_to_gattlib_error(errno);
+		}
+	}
+	if (rx_mtu != NULL) {
+		len = sizeof(*rx_mtu);
+		if (getsockopt(channel->fd, SOL_BLUETOOTH, BT_RCVMTU, rx_mtu, &len) < 0) {
+			return errno_to_gattlib_error(errno);
+		}
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_l2cap_get_fd(gattlib_l2cap_channel_t *channel) {
+	if (channel == NULL) {
+		return -1;
+	}
+	return channel->fd;
+}
+
+int gattlib_l2cap_sendv(gattlib_l2cap_channel_t *channel, const struct iovec *iov, int iovcnt, int timeout_ms) {
+	struct msghdr msg;
+	ssize_t ret;
+
+	if ((channel == NULL) || ((iov == NULL) && (iovcnt > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = (struct iovec *)iov;
+	msg.msg_iovlen = iovcnt;
+
+	while (true) {
+		// Each call sends one SDU. MSG_DONTWAIT lets us bound the wait for credits with poll().
+		ret = sendmsg(channel->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (ret >= 0) {
+			return GATTLIB_SUCCESS;
+		} else if (errno == EINTR) {
+			continue;
+		} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+			int wait_ret = wait_channel(channel->fd, POLLOUT, timeout_ms);
+			if (wait_ret != GATTLIB_SUCCESS) {
+				return wait_ret;
+			}
+		} else {
+			return errno_to_gattlib_error(errno);
+		}
+	}
+}
+
+int gattlib_l2cap_recvv(gattlib_l2cap_channel_t *channel, const struct iovec *iov, int iovcnt, size_t *len, int timeout_ms) {
+	struct msghdr msg;
+	ssize_t ret;
+
+	if ((channel == NULL) || (len == NULL) || ((iov == NULL) && (iovcnt > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = (struct iovec *)iov;
+	msg.msg_iovlen = iovcnt;
+
+	while (true) {
+		// Each call receives one SDU. Reading it frees room in the kernel buffer, which returns credits to the remote device.
+		ret = recvmsg(channel->fd, &msg, MSG_DONTWAIT);
+		if (ret > 0) {
+			*len = ret;
+			if (msg.msg_flags & MSG_TRUNC) {
+				// The end of the SDU is lost. The buffers must be at least as large as the MTU of the channel.
+				GATTLIB_LOG(GATTLIB_ERROR, "L2CAP SDU larger than the receive buffers has been truncated");
+				return GATTLIB_INVALID_PARAMETER;
+			}
+			return GATTLIB_SUCCESS;
+		} else if (ret == 0) {
+			// The remote device has closed the channel
+			*len = 0;
+			return GATTLIB_DEVICE_ERROR;
+		} else if (errno == EINTR) {
+			continue;
+		} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+			int wait_ret = wait_channel(channel->fd, POLLIN, timeout_ms);
+			if (wait_ret != GATTLIB_SUCCESS) {
+				return wait_ret;
+			}
+		} else {
+			return errno_to_gattlib_error(errno);
+		}
+	}
+}
+
+int gattlib_l2cap_close(gattlib_l2cap_channel_t *channel) {
+	if (channel == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	close(channel->fd);
+	free(channel);
+	return GATTLIB_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-or-later
+ *
+ * Copyright (c) 2021-2022, Olivier Martin <olivier@labapart.org>
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib_internal.h"
+
+//
+// Single-flight reads: the first thread reading a characteristic (the leader) issues the request.
+// The threads reading the same characteristic meanwhile wait for its result instead of issuing
+// their own request. Each of them receives its own copy of the value.
+//
+
+struct gattlib_read_flight {
+	uuid_t uuid;
+	// Number of threads waiting for the result of the leader
+	int waiters;
+	bool completed;
+	int ret;
+	// Copy of the value for the waiters
+	void* value;
+	size_t value_len;
+	struct gattlib_read_flight *next;
+};
+
+struct gattlib_read_coalescer {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	// Reads in progress
+	struct gattlib_read_flight *flights;
+};
+
+struct gattlib_read_coalescer* gattlib_read_coalescer_new(void) {
+	struct gattlib_read_coalescer *coalescer = calloc(1, sizeof(struct gattlib_read_coalescer));
+	if (coalescer == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_init(&coalescer->mutex, NULL);
+	pthread_cond_init(&coalescer->cond, NULL);
+	return coalescer;
+}
+
+void gattlib_read_coalescer_free(struct gattlib_read_coalescer *coalescer) {
+	if (coalescer == NULL) {
+		return;
+	}
+
+	pthread_cond_destroy(&coalescer->cond);
+	pthread_mutex_destroy(&coalescer->mutex);
+	free(coalescer);
+}
+
+static void flight_free(struct gattlib_read_flight *flight) {
+	free(flight->value);
+	free(flight);
+}
+
+static int flight_copy_value(struct gattlib_read_flight *flight, void** buffer, size_t* buffer_len) {
+	void *value = malloc(flight->value_len > 0 ? flight->value_len : 1);
+	if (value == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	memcpy(value, flight->value, flight->value_len);
+	*buffer     = value;
+	*buffer_len = flight->value_len;
+	return GATTLIB_SUCCESS;
+}
+
+static int read_coalescer_wait(struct gattlib_read_coalescer *coalescer, struct gattlib_read_flight *flight,
+		void** buffer, size_t* buffer_len)
+{
+	int ret;
+
+	flight->waiters++;
+	while (!flight->completed) {
+		pthread_cond_wait(&coalescer->cond, &coalescer->mutex);
+	}
+	flight->waiters--;
+
+	ret = flight->ret;
+	if (ret == GATTLIB_SUCCESS) {
+		ret = flight_copy_value(flight, buffer, buffer_len);
+	}
+
+	// The last waiter releases the result. The leader has already removed it from the list.
+	if (flight->waiters == 0) {
+		flight_free(flight);
+	}
+	return ret;
+}
+
+int gattlib_read_coalescer_read(struct gattlib_read_coalescer *coalescer, const uuid_t* uuid,
+		gattlib_read_coalescer_read_t read, void* user_data, void** buffer, size_t* buffer_len)
+{
+	struct gattlib_read_flight *flight, **prev;
+	int ret;
+
+	if (coalescer == NULL) {
+		return read(user_data, buffer, buffer_len);
+	}
+
+	pthread_mutex_lock(&coalescer->mutex);
+
+	for (flight = coalescer->flights; flight != NULL; flight = flight->next) {
+		if (gattlib_uuid_cmp(&flight->uuid, uuid) == 0) {
+			ret = read_coalescer_wait(coalescer, flight, buffer, buffer_len);
+			pthread_mutex_unlock(&coalescer->mutex);
+			return ret;
+		}
+	}
+
+	flight = calloc(1, sizeof(struct gattlib_read_flight));
+	if (flight == NULL) {
+		pthread_mutex_unlock(&coalescer->mutex);
+		return read(user_data, buffer, buffer_len);
+	}
+	memcpy(&flight->uuid, uuid, sizeof(flight->uuid));
+	flight->next = coalescer->flights;
+	coalescer->flights = flight;
+
+	pthread_mutex_unlock(&coalescer->mutex);
+
+	ret = read(user_data, buffer, buffer_len);
+
+	pthread_mutex_lock(&coalescer->mutex);
+
+	for (prev = &coalescer->flights; *prev != flight; prev = &(*prev)->next);
+	*prev = flight->next;
+
+	flight->ret = ret;
+	if ((ret == GATTLIB_SUCCESS) && (flight->waiters > 0)) {
+		flight->value = malloc(*buffer_len > 0 ? *buffer_len : 1);
+		if (flight->value == NULL) {
+			flight->ret = GATTLIB_OUT_OF_MEMORY;
+		} else {
+			memcpy(flight->value, *buffer, *buffer_len);
+			flight->value_len = *buffer_len;
+		}
+	}
+	flight->completed = true;
+
+	if (flight->waiters == 0) {
+		flight_free(flight);
+	} else {
+		pthread_cond_broadcast(&coalescer->cond);
+	}
+
+	pthread_mutex_unlock(&coalescer->mutex);
+	return ret;
+}
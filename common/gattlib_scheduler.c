@@ -0,0 +1,420 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-or-later
+ *
+ * Copyright (c) 2021-2022, Olivier Martin <olivier@labapart.org>
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gattlib_internal.h"
+
+//
+// The scheduler owns one slot per connection the controller can keep open. Each slot is served by
+// its own worker thread that connects, runs the jobs and keeps the connection open while it is warm.
+//
+// A worker picks the next job among the jobs it is allowed to run:
+//  - the jobs of the device its slot is connected to,
+//  - the jobs of the devices not connected by any slot, if its slot is empty or if it is the
+//    least recently used idle slot and no empty slot is idle.
+// Jobs are ordered by priority, then by deadline. Jobs of warm devices win the ties so that
+// connections are reused before opening new ones.
+//
+
+#define SCHEDULER_NO_DEADLINE  INT64_MAX
+
+struct gattlib_scheduler_job {
+	struct gattlib_scheduler_job *next;
+
+	uint8_t address[6];
+	char dst[18];
+	int priority;
+	int64_t deadline_us;
+	uint64_t sequence;
+
+	gattlib_scheduler_job_cb_t job_cb;
+	void *user_data;
+};
+
+struct gattlib_scheduler_slot {
+	gattlib_scheduler_t *scheduler;
+	pthread_t thread;
+
+	// Device the slot is connected (or connecting) to
+	bool has_address;
+	uint8_t address[6];
+	gatt_connection_t *connection;
+
+	bool busy;
+	int64_t last_used_us;
+};
+
+struct _gattlib_scheduler_t {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool stopping;
+
+	void *adapter;
+	gattlib_scheduler_options_t options;
+
+	// Pending jobs in submission order
+	struct gattlib_scheduler_job *jobs;
+	uint64_t next_sequence;
+
+	struct gattlib_scheduler_slot *slots;
+	unsigned int slot_count;
+};
+
+static int64_t get_monotonic_time_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static struct gattlib_scheduler_slot* find_slot(gattlib_scheduler_t *scheduler, const uint8_t address[6]) {
+	for (unsigned int i = 0; i < scheduler->slot_count; i++) {
+		struct gattlib_scheduler_slot *slot = &scheduler->slots[i];
+
+		if (slot->has_address && (memcmp(slot->address, address, sizeof(slot->address)) == 0)) {
+			return slot;
+		}
+	}
+	return NULL;
+}
+
+/* Return true if the slot can take the job of a device that is not connected */
+static bool slot_can_take_cold_job(gattlib_scheduler_t *scheduler, struct gattlib_scheduler_slot *slot) {
+	if (!slot->has_address) {
+		return true;
+	}
+
+	for (unsigned int i = 0; i < scheduler->slot_count; i++) {
+		struct gattlib_scheduler_slot *other = &scheduler->slots[i];
+
+		if ((other == slot) || other->busy) {
+			continue;
+		}
+		// Leave the job to an empty slot or to a slot that has been idle for longer
+		if (!other->has_address || (other->last_used_us < slot->last_used_us)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Return true if 'job' must run before 'best' */
+static bool job_is_before(const struct gattlib_scheduler_job *job, bool job_warm,
+		const struct gattlib_scheduler_job *best, bool best_warm)
+{
+	if (job->priority != best->priority) {
+		return job->priority > best->priority;
+	} else if (job->deadline_us != best->deadline_us) {
+		return job->deadline_us < best->deadline_us;
+	} else if (job_warm != best_warm) {
+		return job_warm;
+	} else {
+		return job->sequence < best->sequence;
+	}
+}
+
+static void unlink_job(gattlib_scheduler_t *scheduler, struct gattlib_scheduler_job *job) {
+	struct gattlib_scheduler_job **link = &scheduler->jobs;
+
+	while (*link != job) {
+		link = &(*link)->next;
+	}
+	*link = job->next;
+	job->next = NULL;
+}
+
+static struct gattlib_scheduler_job* pop_expired_job(gattlib_scheduler_t *scheduler, int64_t now_us) {
+	for (struct gattlib_scheduler_job *job = scheduler->jobs; job != NULL; job = job->next) {
+		if (job->deadline_us <= now_us) {
+			unlink_job(scheduler, job);
+			return job;
+		}
+	}
+	return NULL;
+}
+
+static struct gattlib_scheduler_job* pop_next_job(gattlib_scheduler_t *scheduler, struct gattlib_scheduler_slot *slot) {
+	struct gattlib_scheduler_job *best = NULL;
+	bool best_warm = false;
+	bool can_take_cold = slot_can_take_cold_job(scheduler, slot);
+
+	for (struct gattlib_scheduler_job *job = scheduler->jobs; job != NULL; job = job->next) {
+		struct gattlib_scheduler_slot *owner = find_slot(scheduler, job->address);
+		bool warm = (owner == slot);
+
+		// The device is connected by another slot, its worker runs the job
+		if ((owner != NULL) && !warm) {
+			continue;
+		}
+		if (!warm && !can_take_cold) {
+			continue;
+		}
+
+		if ((best == NULL) || job_is_before(job, warm, best, best_warm)) {
+			best = job;
+			best_warm = warm;
+		}
+	}
+
+	if (best != NULL) {
+		unlink_job(scheduler, best);
+	}
+	return best;
+}
+
+/* Called with the scheduler mutex locked. The mutex is released while disconnecting. */
+static void slot_close(gattlib_scheduler_t *scheduler, struct gattlib_scheduler_slot *slot) {
+	gatt_connection_t *connection = slot->connection;
+
+	slot->connection = NULL;
+	slot->has_address = false;
+
+	if (connection != NULL) {
+		pthread_mutex_unlock(&scheduler->mutex);
+		gattlib_disconnect(connection);
+		pthread_mutex_lock(&scheduler->mutex);
+	}
+}
+
+static void wait_for_event(gattlib_scheduler_t *scheduler, struct gattlib_scheduler_slot *slot) {
+	int64_t wakeup_us = SCHEDULER_NO_DEADLINE;
+	struct timespec ts;
+
+	if (slot->connection != NULL) {
+		wakeup_us = slot->last_used_us + (int64_t)scheduler->options.idle_timeout_ms * 1000;
+	}
+	for (struct gattlib_scheduler_job *job = scheduler->jobs; job != NULL; job = job->next) {
+		if (job->deadline_us < wakeup_us) {
+			wakeup_us = job->deadline_us;
+		}
+	}
+
+	if (wakeup_us == SCHEDULER_NO_DEADLINE) {
+		pthread_cond_wait(&scheduler->cond, &scheduler->mutex);
+	} else {
+		ts.tv_sec = wakeup_us / 1000000;
+		ts.tv_nsec = (wakeup_us % 1000000) * 1000;
+		pthread_cond_timedwait(&scheduler->cond, &scheduler->mutex, &ts);
+	}
+}
+
+static void* scheduler_worker(void *arg) {
+	struct gattlib_scheduler_slot *slot = arg;
+	gattlib_scheduler_t *scheduler = slot->scheduler;
+	struct gattlib_scheduler_job *job;
+	gatt_connection_t *previous_connection;
+	int ret;
+
+	pthread_mutex_lock(&scheduler->mutex);
+
+	while (!scheduler->stopping) {
+		int64_t now_us = get_monotonic_time_us();
+
+		job = pop_expired_job(scheduler, now_us);
+		if (job != NULL) {
+			pthread_mutex_unlock(&scheduler->mutex);
+			job->job_cb(NULL, GATTLIB_TIMEOUT, job->user_data);
+			free(job);
+			pthread_mutex_lock(&scheduler->mutex);
+			continue;
+		}
+
+		job = pop_next_job(scheduler, slot);
+		if (job == NULL) {
+			// Release the controller slot of a connection that has not been used for a while
+			if ((slot->connection != NULL) &&
+			    (now_us - slot->last_used_us >= (int64_t)scheduler->options.idle_timeout_ms * 1000)) {
+				slot_close(scheduler, slot);
+				pthread_cond_broadcast(&scheduler->cond);
+			} else {
+				wait_for_event(scheduler, slot);
+			}
+			continue;
+		}
+
+		slot->busy = true;
+		if (slot->has_address && (memcmp(slot->address, job->address, sizeof(slot->address)) != 0)) {
+			previous_connection = slot->connection;
+			slot->connection = NULL;
+		} else {
+			previous_connection = NULL;
+		}
+		// Claim the device before connecting so that its other jobs are queued for this slot
+		slot->has_address = true;
+		memcpy(slot->address, job->address, sizeof(slot->address));
+		pthread_mutex_unlock(&scheduler->mutex);
+
+		if (previous_connection != NULL) {
+			gattlib_disconnect(previous_connection);
+		}
+		if (slot->connection == NULL) {
+			slot->connection = gattlib_connect(scheduler->adapter, job->dst, scheduler->options.connection_options);
+		}
+
+		if (slot->connection == NULL) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Scheduler failed to connect to %s", job->dst);
+			job->job_cb(NULL, GATTLIB_DEVICE_ERROR, job->user_data);
+		} else {
+			ret = job->job_cb(slot->connection, GATTLIB_SUCCESS, job->user_data);
+			if (ret != GATTLIB_SUCCESS) {
+				// Do not keep a connection that might be broken
+				gattlib_disconnect(slot->connection);
+				slot->connection = NULL;
+			}
+		}
+		free(job);
+
+		pthread_mutex_lock(&scheduler->mutex);
+		if (slot->connection == NULL) {
+			slot->has_address = false;
+		}
+		slot->busy = false;
+		slot->last_used_us = get_monotonic_time_us();
+		// The other workers might now be allowed to run the jobs of this device or to take cold jobs
+		pthread_cond_broadcast(&scheduler->cond);
+	}
+
+	slot_close(scheduler, slot);
+	pthread_mutex_unlock(&scheduler->mutex);
+	return NULL;
+}
+
+int gattlib_scheduler_new(void *adapter, const gattlib_scheduler_options_t *options, gattlib_scheduler_t **scheduler) {
+	gattlib_scheduler_t *new_scheduler;
+	pthread_condattr_t attr;
+	unsigned int i;
+	int error;
+
+	if ((options == NULL) || (options->max_connections == 0) || (scheduler == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	new_scheduler = calloc(1, sizeof(gattlib_scheduler_t));
+	if (new_scheduler == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	new_scheduler->slots = calloc(options->max_connections, sizeof(struct gattlib_scheduler_slot));
+	if (new_scheduler->slots == NULL) {
+		free(new_scheduler);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	new_scheduler->adapter = adapter;
+	new_scheduler->options = *options;
+
+	pthread_mutex_init(&new_scheduler->mutex, NULL);
+	// Deadlines are expressed in monotonic time
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&new_scheduler->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	for (i = 0; i < options->max_connections; i++) {
+		struct gattlib_scheduler_slot *slot = &new_scheduler->slots[i];
+
+		slot->scheduler = new_scheduler;
+		error = pthread_create(&slot->thread, NULL, &scheduler_worker, slot);
+		if (error != 0) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Cannot create scheduler thread: %s", strerror(error));
+			break;
+		}
+		new_scheduler->slot_count++;
+	}
+
+	if (new_scheduler->slot_count < options->max_connections) {
+		gattlib_scheduler_free(new_scheduler);
+		return GATTLIB_ERROR_INTERNAL;
+	}
+
+	*scheduler = new_scheduler;
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_scheduler_submit(gattlib_scheduler_t *scheduler, const char *dst, int priority, unsigned int deadline_ms,
+		gattlib_scheduler_job_cb_t job_cb, void *user_data)
+{
+	struct gattlib_scheduler_job *job, **link;
+	int ret;
+
+	if ((scheduler == NULL) || (dst == NULL) || (job_cb == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	job = calloc(1, sizeof(struct gattlib_scheduler_job));
+	if (job == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	ret = gattlib_string_to_mac(dst, job->address);
+	if (ret != GATTLIB_SUCCESS) {
+		free(job);
+		return ret;
+	}
+	strncpy(job->dst, dst, sizeof(job->dst) - 1);
+	job->priority = priority;
+	job->job_cb = job_cb;
+	job->user_data = user_data;
+	if (deadline_ms == 0) {
+		job->deadline_us = SCHEDULER_NO_DEADLINE;
+	} else {
+		job->deadline_us = get_monotonic_time_us() + (int64_t)deadline_ms * 1000;
+	}
+
+	pthread_mutex_lock(&scheduler->mutex);
+
+	if (scheduler->stopping) {
+		pthread_mutex_unlock(&scheduler->mutex);
+		free(job);
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	job->sequence = scheduler->next_sequence++;
+	for (link = &scheduler->jobs; *link != NULL; link = &(*link)->next);
+	*link = job;
+
+	pthread_cond_broadcast(&scheduler->cond);
+	pthread_mutex_unlock(&scheduler->mutex);
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_scheduler_free(gattlib_scheduler_t *scheduler) {
+	struct gattlib_scheduler_job *job;
+
+	if (scheduler == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	pthread_mutex_lock(&scheduler->mutex);
+	scheduler->stopping = true;
+	pthread_cond_broadcast(&scheduler->cond);
+	pthread_mutex_unlock(&scheduler->mutex);
+
+	// The workers finish their current job and close their connection
+	for (unsigned int i = 0; i < scheduler->slot_count; i++) {
+		pthread_join(scheduler->slots[i].thread, NULL);
+	}
+
+	while (scheduler->jobs != NULL) {
+		job = scheduler->jobs;
+		scheduler->jobs = job->next;
+
+		job->job_cb(NULL, GATTLIB_CANCELLED, job->user_data);
+		free(job);
+	}
+
+	pthread_cond_destroy(&scheduler->cond);
+	pthread_mutex_destroy(&scheduler->mutex);
+	free(scheduler->slots);
+	free(scheduler);
+
+	return GATTLIB_SUCCESS;
+}
@@ -0,0 +1,206 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-or-later
+ *
+ * Copyright (c) 2021-2022, Olivier Martin <olivier@labapart.org>
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gattlib_internal.h"
+
+//
+// Cache of the characteristic values of a connection. The entries are filled by the reads and
+// refreshed by the notifications and indications. Every change of an entry is stamped with a
+// sequence number so a read that was in flight while a notification came does not overwrite
+// the more recent notified value.
+//
+
+struct gattlib_value_cache_entry {
+	uuid_t uuid;
+	// Entries are kept when invalidated to remember the sequence number of the invalidation
+	bool valid;
+	void* value;
+	size_t value_len;
+	int64_t expiration_us;
+	uint64_t sequence;
+	struct gattlib_value_cache_entry *next;
+};
+
+struct gattlib_value_cache {
+	pthread_mutex_t mutex;
+	// 0 when the cache is disabled
+	unsigned int ttl_ms;
+	uint64_t sequence;
+	struct gattlib_value_cache_entry *entries;
+};
+
+static int64_t get_monotonic_time_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct gattlib_value_cache* gattlib_value_cache_new(void) {
+	struct gattlib_value_cache *cache = calloc(1, sizeof(struct gattlib_value_cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_init(&cache->mutex, NULL);
+	return cache;
+}
+
+static void value_cache_clear(struct gattlib_value_cache *cache) {
+	struct gattlib_value_cache_entry *entry, *next;
+
+	for (entry = cache->entries; entry != NULL; entry = next) {
+		next = entry->next;
+		free(entry->value);
+		free(entry);
+	}
+	cache->entries = NULL;
+}
+
+void gattlib_value_cache_free(struct gattlib_value_cache *cache) {
+	if (cache == NULL) {
+		return;
+	}
+
+	value_cache_clear(cache);
+	pthread_mutex_destroy(&cache->mutex);
+	free(cache);
+}
+
+void gattlib_value_cache_set_ttl(struct gattlib_value_cache *cache, unsigned int ttl_ms) {
+	pthread_mutex_lock(&cache->mutex);
+	cache->ttl_ms = ttl_ms;
+	if (ttl_ms == 0) {
+		value_cache_clear(cache);
+	}
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+static struct gattlib_value_cache_entry* value_cache_lookup(struct gattlib_value_cache *cache, const uuid_t* uuid) {
+	struct gattlib_value_cache_entry *entry;
+
+	for (entry = cache->entries; entry != NULL; entry = entry->next) {
+		if (gattlib_uuid_cmp(&entry->uuid, uuid) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+bool gattlib_value_cache_get(struct gattlib_value_cache *cache, const uuid_t* uuid, void** buffer, size_t* buffer_len) {
+	struct gattlib_value_cache_entry *entry;
+	bool found = false;
+
+	if (cache == NULL) {
+		return false;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+
+	entry = value_cache_lookup(cache, uuid);
+	if ((entry != NULL) && entry->valid && (get_monotonic_time_us() < entry->expiration_us)) {
+		void *value = malloc(entry->value_len > 0 ? entry->value_len : 1);
+		if (value != NULL) {
+			memcpy(value, entry->value, entry->value_len);
+			*buffer     = value;
+			*buffer_len = entry->value_len;
+			found = true;
+		}
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+	return found;
+}
+
+uint64_t gattlib_value_cache_sequence(struct gattlib_value_cache *cache) {
+	uint64_t sequence;
+
+	if (cache == NULL) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+	sequence = cache->sequence;
+	pthread_mutex_unlock(&cache->mutex);
+	return sequence;
+}
+
+/*
+ * Store the value of 'uuid' unless the entry has changed since 'sequence'.
+ * 'value' NULL invalidates the entry.
+ */
+static void value_cache_store(struct gattlib_value_cache *cache, const uuid_t* uuid,
+		const void* value, size_t value_len, uint64_t sequence)
+{
+	struct gattlib_value_cache_entry *entry;
+	void *copy = NULL;
+
+	pthread_mutex_lock(&cache->mutex);
+
+	if (cache->ttl_ms == 0) {
+		goto EXIT;
+	}
+
+	entry = value_cache_lookup(cache, uuid);
+	if ((entry != NULL) && (entry->sequence > sequence)) {
+		// A more recent value has been notified (or the value has been written) during the read
+		goto EXIT;
+	}
+
+	if (value != NULL) {
+		copy = malloc(value_len > 0 ? value_len : 1);
+		if (copy == NULL) {
+			goto EXIT;
+		}
+		memcpy(copy, value, value_len);
+	}
+
+	if (entry == NULL) {
+		entry = calloc(1, sizeof(struct gattlib_value_cache_entry));
+		if (entry == NULL) {
+			free(copy);
+			goto EXIT;
+		}
+		memcpy(&entry->uuid, uuid, sizeof(entry->uuid));
+		entry->next = cache->entries;
+		cache->entries = entry;
+	}
+
+	free(entry->value);
+	entry->value         = copy;
+	entry->value_len     = value_len;
+	entry->valid         = (value != NULL);
+	entry->expiration_us = get_monotonic_time_us() + (int64_t)cache->ttl_ms * 1000;
+	entry->sequence      = ++cache->sequence;
+
+EXIT:
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+void gattlib_value_cache_update_from_read(struct gattlib_value_cache *cache, const uuid_t* uuid,
+		const void* value, size_t value_len, uint64_t sequence)
+{
+	if (cache != NULL) {
+		value_cache_store(cache, uuid, value, value_len, sequence);
+	}
+}
+
+void gattlib_value_cache_update(struct gattlib_value_cache *cache, const uuid_t* uuid, const void* value, size_t value_len) {
+	if (cache != NULL) {
+		value_cache_store(cache, uuid, value, value_len, UINT64_MAX);
+	}
+}
+
+void gattlib_value_cache_invalidate(struct gattlib_value_cache *cache, const uuid_t* uuid) {
+	if (cache != NULL) {
+		value_cache_store(cache, uuid, NULL, 0, UINT64_MAX);
+	}
+}
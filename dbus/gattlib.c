@@ -11,9 +11,41 @@
 
 #include "gattlib_internal.h"
 
-#define CONNECT_TIMEOUT  4
+// Time given to Bluez to resolve the GATT services once connected
+#define CONNECT_TIMEOUT       4
+// Time given to org.bluez.Device1.Connect() to connect to the device
+#define CONNECT_CALL_TIMEOUT  20
+// Time given to the BLE scan to find a device Bluez does not know
+#define CONNECT_DISCOVERY_TIMEOUT  5
+
+enum {
+	CONNECTION_STATE_CONNECTING,  // org.bluez.Device1.Connect() is pending
+	CONNECTION_STATE_DISCOVERING, // Scanning for a device Bluez does not know
+	CONNECTION_STATE_RESOLVING,   // Waiting for the GATT services to be resolved
+	CONNECTION_STATE_CONNECTED,
+	CONNECTION_STATE_RECONNECTING, // Waiting for the next reconnection attempt or for its completion
+	CONNECTION_STATE_RESTORING,   // Reconnected, waiting for the GATT services to be resolved
+	CONNECTION_STATE_DISCONNECTED,
+};
+
+enum {
+	CONNECTION_ATTEMPT_PENDING,
+	CONNECTION_ATTEMPT_ESTABLISHED, // connect_cb has been given the connection
+	CONNECTION_ATTEMPT_FAILED,      // connect_cb has been given NULL
+	CONNECTION_ATTEMPT_CANCELLED,   // Cancelled by gattlib_disconnect(), connect_cb is not called
+};
+
+// Thread running the connection state machines. The DBus replies and the signals of the devices are
+// dispatched there. It is started by the first connection and stopped with the last one.
+static struct {
+	pthread_mutex_t mutex;
+	int             ref;
+	GMainContext*   context;
+	GMainLoop*      loop;
+} m_connect_loop = { .mutex = PTHREAD_MUTEX_INITIALIZER };
 
 static const char *m_dbus_error_unknown_object = "GDBus.Error:org.freedesktop.DBus.Error.UnknownObject";
+static const char *m_dbus_error_already_exists = "GDBus.Error:org.bluez.Error.AlreadyExists";
 
 static void* glib_event_thread(void* main_loop_p) {
 	GMainLoop** main_loop = (GMainLoop**) main_loop_p;
@@ -21,6 +53,130 @@ static void* glib_event_thread(void* main_loop_p) {
 	return NULL;
 }
 
+static void* connect_loop_thread(void* arg) {
+	GMainLoop* loop = arg;
+	GMainContext* context = g_main_loop_get_context(loop);
+
+	g_main_context_push_thread_default(context);
+	g_main_loop_run(loop);
+	g_main_context_pop_thread_default(context);
+	g_main_loop_unref(loop);
+	return NULL;
+}
+
+static GMainContext* connect_loop_acquire(void) {
+	GMainContext* context = NULL;
+	pthread_t thread;
+
+	pthread_mutex_lock(&m_connect_loop.mutex);
+	if (m_connect_loop.ref == 0) {
+		m_connect_loop.context = g_main_context_new();
+		m_connect_loop.loop = g_main_loop_new(m_connect_loop.context, FALSE);
+
+		if (pthread_create(&thread, NULL, connect_loop_thread, g_main_loop_ref(m_connect_loop.loop)) != 0) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Failed to create the connection thread");
+			g_main_loop_unref(m_connect_loop.loop);
+			g_main_loop_unref(m_connect_loop.loop);
+			g_main_context_unref(m_connect_loop.context);
+			goto EXIT;
+		}
+		pthread_detach(thread);
+	}
+	m_connect_loop.ref++;
+	context = m_connect_loop.context;
+
+EXIT:
+	pthread_mutex_unlock(&m_connect_loop.mutex);
+	return context;
+}
+
+/* Return true when called from the thread of the connection state machines (ie: from a user callback) */
+static bool connect_loop_is_current(void) {
+	GMainContext* context = g_main_context_get_thread_default();
+	bool current;
+
+	pthread_mutex_lock(&m_connect_loop.mutex);
+	current = (context != NULL) && (context == m_connect_loop.context);
+	pthread_mutex_unlock(&m_connect_loop.mutex);
+
+	return current;
+}
+
+static void connect_loop_release(void) {
+	pthread_mutex_lock(&m_connect_loop.mutex);
+	m_connect_loop.ref--;
+	if (m_connect_loop.ref == 0) {
+		// The thread releases its own reference on the loop when it exits
+		g_main_loop_quit(m_connect_loop.loop);
+		g_main_loop_unref(m_connect_loop.loop);
+		g_main_context_unref(m_connect_loop.context);
+		m_connect_loop.loop = NULL;
+		m_connect_loop.context = NULL;
+	}
+	pthread_mutex_unlock(&m_connect_loop.mutex);
+}
+
+static void connection_unref(gatt_connection_t* connection);
+static void connection_complete(gatt_connection_t* connection);
+static void connection_failed(gatt_connection_t* connection);
+static void connection_stop_timeout(gattlib_context_t* conn_context);
+static bool connection_reconnect(gatt_connection_t* connection);
+static void connection_schedule_reconnect(gatt_connection_t* connection);
+static void connection_restored(gatt_connection_t* connection);
+
+/*
+ * Handle a change of a property of the device.
+ * Return false once a user callback might have run: it might have disconnected the connection.
+ */
+static bool connection_property_changed(gatt_connection_t* connection, const gchar *key, GVariant *value) {
+	gattlib_context_t* conn_context = connection->context;
+
+	if (strcmp(key, "Connected") == 0) {
+		if (g_variant_get_boolean(value)) {
+			return true;
+		}
+
+		if (conn_context->connection_state == CONNECTION_STATE_RESOLVING) {
+			// The link is lost before the connection is established. The attempt fails
+			// without calling the disconnection handler.
+			GATTLIB_LOG(GATTLIB_ERROR, "Link lost with %s while resolving its services", conn_context->device_object_path);
+			connection_failed(connection);
+			return false;
+		} else if (conn_context->connection_state == CONNECTION_STATE_RESTORING) {
+			// The link is lost again before it has been restored. Try the next reconnection
+			// unless gattlib_disconnect() is closing it.
+			connection_stop_timeout(conn_context);
+			if (!g_atomic_int_get(&conn_context->disconnecting)) {
+				connection_schedule_reconnect(connection);
+				return false;
+			}
+			conn_context->connection_state = CONNECTION_STATE_DISCONNECTED;
+		} else if ((conn_context->connection_state != CONNECTION_STATE_CONNECTED) &&
+		           (conn_context->connection_state != CONNECTION_STATE_DISCONNECTED)) {
+			// The pending DBus call of the connection (or reconnection) reports its failure
+			return true;
+		}
+
+		// Disconnection case. The handler is called once the reconnection has failed.
+		if ((conn_context->connection_state == CONNECTION_STATE_CONNECTED) && connection_reconnect(connection)) {
+			return true;
+		}
+		if (gattlib_has_valid_handler(&connection->disconnection)) {
+			gattlib_call_disconnection_handler(&connection->disconnection);
+		}
+		return false;
+	} else if (strcmp(key, "ServicesResolved") == 0) {
+		if (g_variant_get_boolean(value) && (conn_context->connection_state == CONNECTION_STATE_RESOLVING)) {
+			// Tell we are now connected
+			connection_complete(connection);
+			return false;
+		} else if (g_variant_get_boolean(value) && (conn_context->connection_state == CONNECTION_STATE_RESTORING)) {
+			connection_restored(connection);
+		}
+	}
+	return true;
+}
+
 gboolean on_handle_device_property_change(
 	    OrgBluezGattCharacteristic1 *object,
 	    GVariant *arg_changed_properties,
@@ -35,28 +191,20 @@ gboolean on_handle_device_property_change(
 		GVariantIter *iter;
 		const gchar *key;
 		GVariant *value;
+		bool proceed = true;
+
+		// The user callbacks might disconnect the connection: it is kept until we are done with it
+		g_atomic_int_inc(&conn_context->ref);
 
 		g_variant_get (arg_changed_properties, "a{sv}", &iter);
-		while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
+		while (proceed && g_variant_iter_next (iter, "{&sv}", &key, &value)) {
 			GATTLIB_LOG(GATTLIB_DEBUG, "DBUS: device_property_change: %s: %s", key, g_variant_print(value, TRUE));
-			if (strcmp(key, "Connected") == 0) {
-				if (!g_variant_get_boolean(value)) {
-					// Disconnection case
-					if (gattlib_has_valid_handler(&connection->disconnection)) {
-						gattlib_call_disconnection_handler(&connection->disconnection);
-					}
-				}
-			} else if (strcmp(key, "ServicesResolved") == 0) {
-				if (g_variant_get_boolean(value)) {
-					// Stop the timeout for connection
-					g_source_remove(conn_context->connection_timeout);
-
-					// Tell we are now connected
-					g_main_loop_quit(conn_context->connection_loop);
-				}
-			}
+			proceed = connection_property_changed(connection, key, value);
+			g_variant_unref(value);
 		}
 		g_variant_iter_free(iter);
+
+		connection_unref(connection);
 	}
 	return TRUE;
 }
@@ -108,20 +256,640 @@ void get_device_path_from_mac(const char *adapter_name, const char *mac_address,
 	snprintf(object_path, object_path_len, "/org/bluez/%s/dev_%s", adapter, device_address_str);
 }
 
-/**
- * @param src		Local Adaptater interface
- * @param dst		Remote Bluetooth address
- * @param dst_type	Set LE address type (either BDADDR_LE_PUBLIC or BDADDR_LE_RANDOM)
- * @param sec_level	Set security level (either BT_IO_SEC_LOW, BT_IO_SEC_MEDIUM, BT_IO_SEC_HIGH)
- * @param psm       Specify the PSM for GATT/ATT over BR/EDR
- * @param mtu       Specify the MTU size
+int gattlib_set_event_loop_count(unsigned int count)
+{
+	// The D-Bus proxies of all the connections are dispatched by the same GMainContext
+	return (count == 1) ? GATTLIB_SUCCESS : GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_set_connection_attempt_timeout(unsigned int timeout_s)
+{
+	// Each step of the connection establishment has its own timeout
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+static void connection_set_timeout_source(gatt_connection_t* connection, GSource* source, GSourceFunc function) {
+	gattlib_context_t* conn_context = connection->context;
+
+	if (conn_context->connection_timeout != NULL) {
+		g_source_destroy(conn_context->connection_timeout);
+		g_source_unref(conn_context->connection_timeout);
+	}
+
+	conn_context->connection_timeout = source;
+	g_source_set_callback(conn_context->connection_timeout, function, connection, NULL);
+	g_source_attach(conn_context->connection_timeout, g_main_context_get_thread_default());
+}
+
+static void connection_set_timeout(gatt_connection_t* connection, guint interval, GSourceFunc function) {
+	connection_set_timeout_source(connection, g_timeout_source_new_seconds(interval), function);
+}
+
+static void connection_stop_timeout(gattlib_context_t* conn_context) {
+	if (conn_context->connection_timeout != NULL) {
+		g_source_destroy(conn_context->connection_timeout);
+		g_source_unref(conn_context->connection_timeout);
+		conn_context->connection_timeout = NULL;
+	}
+}
+
+static void connection_stop_discovery(gattlib_context_t* conn_context) {
+	OrgBluezAdapter1 *adapter_proxy;
+
+	// The scan only runs while connecting. The adapter might have been released since.
+	if (conn_context->discovery_subscription == 0) {
+		return;
+	}
+	adapter_proxy = conn_context->adapter->adapter_proxy;
+
+	g_dbus_connection_signal_unsubscribe(g_dbus_proxy_get_connection(G_DBUS_PROXY(adapter_proxy)),
+			conn_context->discovery_subscription);
+	conn_context->discovery_subscription = 0;
+
+	if (conn_context->discovery_started) {
+		conn_context->discovery_started = false;
+		org_bluez_adapter1_call_stop_discovery(adapter_proxy, NULL, NULL, NULL);
+	}
+}
+
+static void connection_free(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+
+	connection_stop_timeout(conn_context);
+	connection_stop_discovery(conn_context);
+	g_clear_object(&conn_context->connection_cancellable);
+	g_clear_object(&conn_context->operation_cancellable);
+	g_mutex_clear(&conn_context->operation_mutex);
+	free_all_coalesced_writes(conn_context);
+	g_mutex_clear(&conn_context->coalesced_writes_mutex);
+	gattlib_read_coalescer_free(conn_context->read_coalescer);
+	gattlib_value_cache_free(conn_context->value_cache);
+
+	if (conn_context->device != NULL) {
+		g_signal_handlers_disconnect_by_data(conn_context->device, connection);
+		g_object_unref(conn_context->device);
+	}
+	free(conn_context->device_object_path);
+
+	connect_loop_release();
+
+	free(conn_context);
+	free(connection);
+}
+
+static void connection_unref(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+
+	if (g_atomic_int_dec_and_test(&conn_context->ref)) {
+		connection_free(connection);
+	}
+}
+
+static gboolean on_connection_unref(gpointer user_data) {
+	connection_unref(user_data);
+	return FALSE;
+}
+
+static void connection_failed(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+	gatt_connect_cb_t connect_cb = conn_context->connect_cb;
+	void* user_data = conn_context->connect_user_data;
+
+	// Bluez might still complete a connection we gave up on
+	if ((conn_context->device != NULL) && g_cancellable_is_cancelled(conn_context->connection_cancellable)) {
+		org_bluez_device1_call_disconnect(conn_context->device, NULL, NULL, NULL);
+	}
+
+	// destroy default adapter
+	if (conn_context->default_adapter) {
+		gattlib_adapter_close(conn_context->adapter);
+	}
+	connection_stop_timeout(conn_context);
+	connection_stop_discovery(conn_context);
+	conn_context->connection_state = CONNECTION_STATE_DISCONNECTED;
+
+	// The connection stays valid until the callback returns: the caller might be cancelling the attempt meanwhile
+	if (g_atomic_int_compare_and_exchange(&conn_context->attempt_state, CONNECTION_ATTEMPT_PENDING, CONNECTION_ATTEMPT_FAILED) &&
+	    (connect_cb != NULL))
+	{
+		connect_cb(NULL, user_data);
+	}
+
+	connection_unref(connection);
+}
+
+static void connection_complete(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+	GDBusObjectManager *device_manager;
+
+	connection_stop_timeout(conn_context);
+
+	// Get list of objects belonging to Device Manager
+	device_manager = get_device_manager_from_adapter(conn_context->adapter);
+	if (device_manager == NULL) {
+		connection_failed(connection);
+		return;
+	}
+	conn_context->dbus_objects = g_dbus_object_manager_get_objects(device_manager);
+	conn_context->connection_state = CONNECTION_STATE_CONNECTED;
+
+	// Set up a new GMainLoop to handle notification/indication events.
+	conn_context->connection_loop = g_main_loop_new(NULL, 0);
+	pthread_create(&conn_context->event_thread, NULL, glib_event_thread, &conn_context->connection_loop);
+
+	// From now, gattlib_disconnect() closes an established connection
+	if (!g_atomic_int_compare_and_exchange(&conn_context->attempt_state, CONNECTION_ATTEMPT_PENDING, CONNECTION_ATTEMPT_ESTABLISHED)) {
+		// gattlib_disconnect() has cancelled the attempt meanwhile
+		g_main_loop_quit(conn_context->connection_loop);
+		pthread_join(conn_context->event_thread, NULL);
+		g_main_loop_unref(conn_context->connection_loop);
+		conn_context->connection_loop = NULL;
+		g_list_free_full(conn_context->dbus_objects, g_object_unref);
+		conn_context->dbus_objects = NULL;
+
+		g_cancellable_cancel(conn_context->connection_cancellable);
+		connection_failed(connection);
+		return;
+	}
+
+	if (conn_context->connect_cb != NULL) {
+		conn_context->connect_cb(connection, conn_context->connect_user_data);
+	}
+}
+
+static gboolean on_connection_timeout(gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+
+	if (conn_context->connection_state == CONNECTION_STATE_RESOLVING) {
+		// We assume the GATT services to be available even if Bluez has not reported it
+		connection_complete(connection);
+	} else if (conn_context->connection_state == CONNECTION_STATE_RESTORING) {
+		connection_restored(connection);
+	} else if (conn_context->connection_state == CONNECTION_STATE_DISCOVERING) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Device '%s' cannot be found", conn_context->device_object_path);
+
+		g_source_unref(conn_context->connection_timeout);
+		conn_context->connection_timeout = NULL;
+		connection_failed(connection);
+	} else {
+		GATTLIB_LOG(GATTLIB_ERROR, "Connection to %s timed out", conn_context->device_object_path);
+
+		// The pending DBus call completes with G_IO_ERROR_CANCELLED and ends the connection attempt
+		g_source_unref(conn_context->connection_timeout);
+		conn_context->connection_timeout = NULL;
+		g_cancellable_cancel(conn_context->connection_cancellable);
+	}
+
+	return FALSE;
+}
+
+static void connection_lookup_device(gatt_connection_t* connection);
+
+static void on_device_connected(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+	GError *error = NULL;
+
+	org_bluez_device1_call_connect_finish(conn_context->device, res, &error);
+	if (error) {
+		if (strncmp(error->message, m_dbus_error_unknown_object, strlen(m_dbus_error_unknown_object)) == 0) {
+			// Bluez does not know the device: it has not been scanned nor paired
+			if (!conn_context->device_lookup_done) {
+				g_error_free(error);
+				connection_lookup_device(connection);
+				return;
+			}
+			GATTLIB_LOG(GATTLIB_ERROR, "Device '%s' cannot be found", conn_context->device_object_path);
+		}  else {
+			GATTLIB_LOG(GATTLIB_ERROR, "Device connected error (device:%s): %s",
+				conn_context->device_object_path,
+				error->message);
+		}
+
+		g_error_free(error);
+		connection_failed(connection);
+		return;
+	}
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 40)
+	// The services might have been resolved by a previous connection
+	if (org_bluez_device1_get_services_resolved(conn_context->device)) {
+		connection_complete(connection);
+		return;
+	}
+#endif
+
+	// Wait for the property 'ServicesResolved' to be changed. We assume 'org.bluez.GattService1
+	// and 'org.bluez.GattCharacteristic1' to be advertised at that moment.
+	conn_context->connection_state = CONNECTION_STATE_RESOLVING;
+	connection_set_timeout(connection, CONNECT_TIMEOUT, on_connection_timeout);
+}
+
+static void on_device_proxy_ready(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+	GError *error = NULL;
+
+	conn_context->device = org_bluez_device1_proxy_new_for_bus_finish(res, &error);
+	if (conn_context->device == NULL) {
+		if (error) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Failed to connect to DBus Bluez Device: %s", error->message);
+			g_error_free(error);
+		}
+		connection_failed(connection);
+		return;
+	}
+
+	// Register a handle for notification
+	g_signal_connect(conn_context->device,
+		"g-properties-changed",
+		G_CALLBACK (on_handle_device_property_change),
+		connection);
+
+	org_bluez_device1_call_connect(conn_context->device, conn_context->connection_cancellable,
+		on_device_connected, connection);
+}
+
+static void connection_open_device(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+
+	org_bluez_device1_proxy_new_for_bus(
+			G_BUS_TYPE_SYSTEM,
+			G_DBUS_PROXY_FLAGS_NONE,
+			"org.bluez",
+			conn_context->device_object_path,
+			conn_context->connection_cancellable,
+			on_device_proxy_ready,
+			connection);
+}
+
+static void on_device_discovered(GDBusConnection *bus, const gchar *sender_name, const gchar *object_path,
+		const gchar *interface_name, const gchar *signal_name, GVariant *parameters, gpointer user_data)
+{
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+	const gchar *added_object_path;
+
+	g_variant_get(parameters, "(&o@a{sa{sv}})", &added_object_path, NULL);
+	if (strcmp(added_object_path, conn_context->device_object_path) != 0) {
+		return;
+	}
+
+	connection_stop_discovery(conn_context);
+
+	conn_context->connection_state = CONNECTION_STATE_CONNECTING;
+	connection_set_timeout(connection, CONNECT_CALL_TIMEOUT, on_connection_timeout);
+	connection_open_device(connection);
+}
+
+static void on_discovery_started(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+	OrgBluezAdapter1 *adapter_proxy = ORG_BLUEZ_ADAPTER1(source_object);
+	GError *error = NULL;
+
+	org_bluez_adapter1_call_start_discovery_finish(adapter_proxy, res, &error);
+	if (error) {
+		// The scan might already be running (eg: started by gattlib_adapter_scan_enable()). It is not ours to stop.
+		GATTLIB_LOG(GATTLIB_DEBUG, "Failed to start the scan for '%s': %s", conn_context->device_object_path, error->message);
+		g_error_free(error);
+	} else if (conn_context->discovery_subscription != 0) {
+		conn_context->discovery_started = true;
+	} else {
+		// The scan is not needed anymore: the device has been found or the attempt has ended meanwhile
+		org_bluez_adapter1_call_stop_discovery(adapter_proxy, NULL, NULL, NULL);
+	}
+
+	connection_unref(connection);
+}
+
+/* Scan until Bluez reports the device */
+static void connection_start_discovery(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+	OrgBluezAdapter1 *adapter_proxy = conn_context->adapter->adapter_proxy;
+
+	conn_context->connection_state = CONNECTION_STATE_DISCOVERING;
+	connection_set_timeout(connection, CONNECT_DISCOVERY_TIMEOUT, on_connection_timeout);
+
+	conn_context->discovery_subscription = g_dbus_connection_signal_subscribe(
+			g_dbus_proxy_get_connection(G_DBUS_PROXY(adapter_proxy)),
+			"org.bluez",
+			"org.freedesktop.DBus.ObjectManager",
+			"InterfacesAdded",
+			"/",
+			NULL,
+			G_DBUS_SIGNAL_FLAGS_NONE,
+			on_device_discovered,
+			connection,
+			NULL);
+
+	// The connection is kept until the reply: the state machines are not blocked meanwhile
+	g_atomic_int_inc(&conn_context->ref);
+	org_bluez_adapter1_call_start_discovery(adapter_proxy, NULL, on_discovery_started, connection);
+}
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 48)
+static void on_device_created(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+	GError *error = NULL;
+
+	org_bluez_adapter1_call_connect_device_finish(conn_context->adapter->adapter_proxy, NULL, res, &error);
+	if (error == NULL) {
+		// Bluez has created the device and connected it
+		connection_open_device(connection);
+	} else if (g_cancellable_is_cancelled(conn_context->connection_cancellable)) {
+		g_error_free(error);
+		connection_failed(connection);
+	} else if (strncmp(error->message, m_dbus_error_already_exists, strlen(m_dbus_error_already_exists)) == 0) {
+		// The device has been discovered in the meantime
+		g_error_free(error);
+		connection_open_device(connection);
+	} else {
+		// org.bluez.Adapter1.ConnectDevice() is only available when bluetoothd runs with '--experimental'
+		GATTLIB_LOG(GATTLIB_DEBUG, "Failed to create device '%s': %s", conn_context->device_object_path, error->message);
+		g_error_free(error);
+		connection_start_discovery(connection);
+	}
+}
+#endif
+
+/* Bluez does not know the device. Ask Bluez to connect it directly or scan for it. */
+static void connection_lookup_device(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+
+	conn_context->device_lookup_done = true;
+
+	// The proxy is created again once the device exists
+	g_signal_handlers_disconnect_by_data(conn_context->device, connection);
+	g_clear_object(&conn_context->device);
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 48)
+	GVariantBuilder properties;
+
+	g_variant_builder_init(&properties, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&properties, "{sv}", "Address", g_variant_new_string(conn_context->device_address));
+	g_variant_builder_add(&properties, "{sv}", "AddressType",
+			g_variant_new_string(conn_context->random_address ? "random" : "public"));
+
+	org_bluez_adapter1_call_connect_device(conn_context->adapter->adapter_proxy,
+			g_variant_builder_end(&properties),
+			conn_context->connection_cancellable,
+			on_device_created,
+			connection);
+#else
+	connection_start_discovery(connection);
+#endif
+}
+
+static void on_device_reconnected(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+	GError *error = NULL;
+
+	conn_context->reconnect_call_pending = false;
+
+	org_bluez_device1_call_connect_finish(conn_context->device, res, &error);
+
+	// gattlib_disconnect() has left the connection to us
+	if (g_atomic_int_get(&conn_context->disconnecting)) {
+		g_clear_error(&error);
+		connection_unref(connection);
+		return;
+	}
+
+	if (error) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to reconnect (device:%s): %s", conn_context->device_object_path, error->message);
+		g_error_free(error);
+		connection_schedule_reconnect(connection);
+		return;
+	}
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 40)
+	if (org_bluez_device1_get_services_resolved(conn_context->device)) {
+		connection_restored(connection);
+		return;
+	}
+#endif
+
+	conn_context->connection_state = CONNECTION_STATE_RESTORING;
+	connection_set_timeout(connection, CONNECT_TIMEOUT, on_connection_timeout);
+}
+
+static gboolean on_reconnect_timer(gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+
+	g_cancellable_reset(conn_context->connection_cancellable);
+	connection_set_timeout(connection, CONNECT_CALL_TIMEOUT, on_connection_timeout);
+
+	conn_context->reconnect_call_pending = true;
+	org_bluez_device1_call_connect(conn_context->device, conn_context->connection_cancellable,
+		on_device_reconnected, connection);
+
+	return FALSE;
+}
+
+/* Wait before the next reconnection attempt. Give up once all the attempts have failed. */
+static void connection_schedule_reconnect(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+	const gattlib_reconnect_policy_t* policy = &conn_context->reconnect_policy;
+	guint64 delay_ms;
+
+	if (conn_context->reconnect_attempt >= policy->max_attempts) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to reconnect to %s after %u attempts",
+				conn_context->device_object_path, conn_context->reconnect_attempt);
+
+		connection_stop_timeout(conn_context);
+		conn_context->connection_state = CONNECTION_STATE_DISCONNECTED;
+		if (gattlib_has_valid_handler(&connection->disconnection)) {
+			gattlib_call_disconnection_handler(&connection->disconnection);
+		}
+		return;
+	}
+
+	// Exponential backoff
+	delay_ms = policy->initial_delay_ms;
+	for (unsigned int i = 0; (i < conn_context->reconnect_attempt) && (delay_ms < policy->max_delay_ms); i++) {
+		delay_ms *= 2;
+	}
+	delay_ms = MIN(delay_ms, policy->max_delay_ms);
+
+	// Jitter to spread the reconnections of the devices lost at the same time
+	if ((policy->jitter_percent > 0) && (delay_ms > 0)) {
+		gint64 jitter_ms = delay_ms * MIN(policy->jitter_percent, 100) / 100;
+
+		delay_ms += g_random_int_range(-jitter_ms, jitter_ms + 1);
+	}
+
+	conn_context->reconnect_attempt++;
+	conn_context->connection_state = CONNECTION_STATE_RECONNECTING;
+	connection_set_timeout_source(connection, g_timeout_source_new(delay_ms), on_reconnect_timer);
+}
+
+/* Called on the loss of the link. Return false if the connection must not be reconnected. */
+static bool connection_reconnect(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+
+	if ((conn_context->reconnect_policy.max_attempts == 0) || g_atomic_int_get(&conn_context->disconnecting)) {
+		return false;
+	}
+
+	GATTLIB_LOG(GATTLIB_INFO, "Link lost with %s, reconnecting", conn_context->device_object_path);
+
+	// The ATT MTU is negotiated again by the new link
+	conn_context->mtu = 0;
+	conn_context->reconnect_attempt = 0;
+	connection_schedule_reconnect(connection);
+	return true;
+}
+
+static void connection_restored(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context = connection->context;
+
+	connection_stop_timeout(conn_context);
+	conn_context->connection_state = CONNECTION_STATE_CONNECTED;
+	conn_context->reconnect_attempt = 0;
+	// Drop the ATT MTU that might have been retrieved while the link was being restored
+	conn_context->mtu = 0;
+
+	// The GATT database of the device is expected to be unchanged: the discovered objects are kept
+	if (!g_atomic_int_get(&conn_context->disconnecting)) {
+		restore_all_notifications(conn_context);
+	}
+}
+
+struct reconnect_policy_update {
+	gatt_connection_t*         connection;
+	gattlib_reconnect_policy_t policy;
+};
+
+static gboolean on_reconnect_policy_update(gpointer user_data) {
+	struct reconnect_policy_update* update = user_data;
+	gattlib_context_t* conn_context = update->connection->context;
+
+	conn_context->reconnect_policy = update->policy;
+	free(update);
+	return FALSE;
+}
+
+int gattlib_connection_set_reconnect_policy(gatt_connection_t* connection, const gattlib_reconnect_policy_t *policy) {
+	gattlib_context_t* conn_context;
+	struct reconnect_policy_update* update;
+
+	if (connection == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	update = calloc(1, sizeof(struct reconnect_policy_update));
+	if (update == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	update->connection = connection;
+	if (policy != NULL) {
+		update->policy = *policy;
+	}
+
+	// The policy is used by the thread of the connection state machines
+	g_main_context_invoke(conn_context->connect_context, on_reconnect_policy_update, update);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_connection_set_timeout(gatt_connection_t* connection, unsigned int timeout_ms) {
+	gattlib_context_t* conn_context;
+
+	if ((connection == NULL) || (timeout_ms > G_MAXINT)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	g_atomic_int_set(&conn_context->operation_timeout_ms, timeout_ms > 0 ? (gint)timeout_ms : -1);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_connection_cancel(gatt_connection_t* connection) {
+	gattlib_context_t* conn_context;
+
+	if (connection == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	// The operations started from now use a new GCancellable
+	g_mutex_lock(&conn_context->operation_mutex);
+	g_cancellable_cancel(conn_context->operation_cancellable);
+	g_object_unref(conn_context->operation_cancellable);
+	conn_context->operation_cancellable = g_cancellable_new();
+	g_mutex_unlock(&conn_context->operation_mutex);
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_connection_set_value_cache(gatt_connection_t* connection, unsigned int ttl_ms) {
+	gattlib_context_t* conn_context;
+
+	if (connection == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	if (conn_context->value_cache == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	gattlib_value_cache_set_ttl(conn_context->value_cache, ttl_ms);
+	return GATTLIB_SUCCESS;
+}
+
+/*
+ * Apply the timeout of the connection to the D-Bus calls of 'proxy' and return the GCancellable
+ * of the operation. The caller releases it with g_object_unref().
  */
-gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long options)
+GCancellable* connection_operation_begin(gattlib_context_t* conn_context, gpointer proxy) {
+	GCancellable* cancellable;
+
+	g_dbus_proxy_set_default_timeout(G_DBUS_PROXY(proxy), g_atomic_int_get(&conn_context->operation_timeout_ms));
+
+	g_mutex_lock(&conn_context->operation_mutex);
+	cancellable = g_object_ref(conn_context->operation_cancellable);
+	g_mutex_unlock(&conn_context->operation_mutex);
+
+	return cancellable;
+}
+
+int connection_operation_error(GError *error) {
+	if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		return GATTLIB_CANCELLED;
+	} else if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) ||
+		   g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_TIMEOUT) ||
+		   g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_NO_REPLY))
+	{
+		return GATTLIB_TIMEOUT;
+	} else {
+		return GATTLIB_ERROR_DBUS;
+	}
+}
+
+/* Start the connection establishment. It runs on the thread of the connection state machines. */
+static gboolean connection_start(gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+
+	connection_set_timeout(connection, CONNECT_CALL_TIMEOUT, on_connection_timeout);
+	connection_open_device(connection);
+
+	return FALSE;
+}
+
+gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
+				unsigned long options,
+				gatt_connect_cb_t connect_cb, void* data)
 {
 	struct gattlib_adapter *gattlib_adapter = adapter;
 	const char* adapter_name = NULL;
-	GDBusObjectManager *device_manager;
-	GError *error = NULL;
+	GMainContext* connect_context;
+	GSource* source;
 	char object_path[100];
 
 	// In case NULL is passed, we initialized default adapter
@@ -140,9 +908,19 @@ gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long
 
 	gattlib_context_t* conn_context = calloc(sizeof(gattlib_context_t), 1);
 	if (conn_context == NULL) {
-		return NULL;
+		goto CLOSE_ADAPTER;
 	}
 	conn_context->adapter = gattlib_adapter;
+	conn_context->default_adapter = (adapter == NULL);
+	conn_context->ref = 1;
+	conn_context->connection_state = CONNECTION_STATE_CONNECTING;
+	conn_context->attempt_state = CONNECTION_ATTEMPT_PENDING;
+	conn_context->connect_cb = connect_cb;
+	conn_context->connect_user_data = data;
+	strncpy(conn_context->device_address, dst, sizeof(conn_context->device_address) - 1);
+	// Public address is assumed unless only the random address type is given
+	conn_context->random_address = (options & (GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_PUBLIC | GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM))
+			== GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM;
 
 	gatt_connection_t* connection = calloc(sizeof(gatt_connection_t), 1);
 	if (connection == NULL) {
@@ -151,74 +929,35 @@ gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long
 		connection->context = conn_context;
 	}
 
-	OrgBluezDevice1* device = org_bluez_device1_proxy_new_for_bus_sync(
-			G_BUS_TYPE_SYSTEM,
-			G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
-			"org.bluez",
-			object_path,
-			NULL,
-			&error);
-	if (device == NULL) {
-		if (error) {
-			GATTLIB_LOG(GATTLIB_ERROR, "Failed to connect to DBus Bluez Device: %s", error->message);
-			g_error_free(error);
-		}
+	conn_context->device_object_path = strdup(object_path);
+	if (conn_context->device_object_path == NULL) {
 		goto FREE_CONNECTION;
-	} else {
-		conn_context->device = device;
-		conn_context->device_object_path = strdup(object_path);
 	}
 
-	// Register a handle for notification
-	g_signal_connect(device,
-		"g-properties-changed",
-		G_CALLBACK (on_handle_device_property_change),
-		connection);
-
-	error = NULL;
-	org_bluez_device1_call_connect_sync(device, NULL, &error);
-	if (error) {
-		if (strncmp(error->message, m_dbus_error_unknown_object, strlen(m_dbus_error_unknown_object)) == 0) {
-			// You might have this error if the computer has not scanned or has not already had
-			// pairing information about the targetted device.
-			GATTLIB_LOG(GATTLIB_ERROR, "Device '%s' cannot be found", dst);
-		}  else {
-			GATTLIB_LOG(GATTLIB_ERROR, "Device connected error (device:%s): %s",
-				conn_context->device_object_path,
-				error->message);
-		}
-
-		g_error_free(error);
-		goto FREE_DEVICE;
+	connect_context = connect_loop_acquire();
+	if (connect_context == NULL) {
+		goto FREE_OBJECT_PATH;
 	}
-
-	// Wait for the property 'UUIDs' to be changed. We assume 'org.bluez.GattService1
-	// and 'org.bluez.GattCharacteristic1' to be advertised at that moment.
-	conn_context->connection_loop = g_main_loop_new(NULL, 0);
-
-	conn_context->connection_timeout = g_timeout_add_seconds(CONNECT_TIMEOUT, stop_scan_func,
-								 conn_context->connection_loop);
-	g_main_loop_run(conn_context->connection_loop);
-	g_main_loop_unref(conn_context->connection_loop);
-	// Set the attribute to NULL even if not required
-	conn_context->connection_loop = NULL;
-
-	// Get list of objects belonging to Device Manager
-	device_manager = get_device_manager_from_adapter(conn_context->adapter);
-    if (device_manager == NULL) {
-        goto FREE_DEVICE;
-    }
-	conn_context->dbus_objects = g_dbus_object_manager_get_objects(device_manager);
-
-	// Set up a new GMainLoop to handle notification/indication events.
-	conn_context->connection_loop = g_main_loop_new(NULL, 0);
-	pthread_create(&conn_context->event_thread, NULL, glib_event_thread, &conn_context->connection_loop);
+	conn_context->connect_context = connect_context;
+	conn_context->connection_cancellable = g_cancellable_new();
+	conn_context->operation_timeout_ms = -1;
+	conn_context->operation_cancellable = g_cancellable_new();
+	g_mutex_init(&conn_context->operation_mutex);
+	g_mutex_init(&conn_context->coalesced_writes_mutex);
+	conn_context->read_coalescer = gattlib_read_coalescer_new();
+	conn_context->value_cache = gattlib_value_cache_new();
+
+	// From now, the connection is owned by the thread of the connection state machines. The attempt
+	// is not started in place when called from a callback running on that thread.
+	source = g_idle_source_new();
+	g_source_set_callback(source, connection_start, connection, NULL);
+	g_source_attach(source, connect_context);
+	g_source_unref(source);
 
 	return connection;
 
-FREE_DEVICE:
+FREE_OBJECT_PATH:
 	free(conn_context->device_object_path);
-	g_object_unref(conn_context->device);
 
 FREE_CONNECTION:
 	free(connection);
@@ -226,52 +965,150 @@ FREE_CONNECTION:
 FREE_CONN_CONTEXT:
 	free(conn_context);
 
+CLOSE_ADAPTER:
 	// destroy default adapter
-	if(adapter == NULL)
-	{
+	if (adapter == NULL) {
 		gattlib_adapter_close(gattlib_adapter);
 	}
 
 	return NULL;
 }
 
-gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
-				unsigned long options,
-				gatt_connect_cb_t connect_cb, void* data)
+struct connect_sync_t {
+	GMutex             mutex;
+	GCond              cond;
+	bool               done;
+	gatt_connection_t* connection;
+};
+
+static void connect_sync_cb(gatt_connection_t* connection, void* user_data) {
+	struct connect_sync_t* connect_sync = user_data;
+
+	g_mutex_lock(&connect_sync->mutex);
+	connect_sync->connection = connection;
+	connect_sync->done = true;
+	g_cond_signal(&connect_sync->cond);
+	g_mutex_unlock(&connect_sync->mutex);
+}
+
+/**
+ * @param src		Local Adaptater interface
+ * @param dst		Remote Bluetooth address
+ * @param options	Options to connect to BLE device. See `GATTLIB_CONNECTION_OPTIONS_*`
+ */
+gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long options)
 {
-	gatt_connection_t *connection;
+	struct connect_sync_t connect_sync = { .done = false, .connection = NULL };
+	// Called from a callback (eg: a disconnection handler reconnecting the device)
+	bool nested = connect_loop_is_current();
+
+	g_mutex_init(&connect_sync.mutex);
+	g_cond_init(&connect_sync.cond);
+
+	if (gattlib_connect_async(adapter, dst, options, connect_sync_cb, &connect_sync) != NULL) {
+		if (nested) {
+			// Waiting for the thread of the connection state machines would deadlock: run them from here
+			while (!connect_sync.done) {
+				g_main_context_iteration(g_main_context_get_thread_default(), TRUE);
+			}
+		} else {
+			g_mutex_lock(&connect_sync.mutex);
+			while (!connect_sync.done) {
+				g_cond_wait(&connect_sync.cond, &connect_sync.mutex);
+			}
+			g_mutex_unlock(&connect_sync.mutex);
+		}
+	}
+
+	g_cond_clear(&connect_sync.cond);
+	g_mutex_clear(&connect_sync.mutex);
+	return connect_sync.connection;
+}
 
-	connection = gattlib_connect(adapter, dst, options);
-	if ((connection != NULL) && (connect_cb != NULL)) {
-		connect_cb(connection, data);
+/* Free the connection once the thread of the connection state machines does not use it anymore */
+static gboolean connection_dispose(gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+
+	if (conn_context->reconnect_call_pending) {
+		// The connection is freed when the pending reconnection completes
+		g_cancellable_cancel(conn_context->connection_cancellable);
+	} else {
+		connection_unref(connection);
 	}
+	return FALSE;
+}
 
-	return connection;
+/* Cancel the connection attempt. It runs on the thread of the connection state machines. */
+static gboolean connection_cancel_attempt(gpointer user_data) {
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+
+	switch (conn_context->connection_state) {
+	case CONNECTION_STATE_CONNECTING:
+		// The pending DBus call completes with G_IO_ERROR_CANCELLED and ends the connection attempt
+		g_cancellable_cancel(conn_context->connection_cancellable);
+		break;
+	case CONNECTION_STATE_DISCOVERING:
+	case CONNECTION_STATE_RESOLVING:
+		// No DBus call is pending. The device Bluez might have connected is disconnected.
+		g_cancellable_cancel(conn_context->connection_cancellable);
+		connection_failed(connection);
+		break;
+	default:
+		// The connection attempt has already ended
+		break;
+	}
+
+	connection_unref(connection);
+	return FALSE;
 }
 
 int gattlib_disconnect(gatt_connection_t* connection) {
-	gattlib_context_t* conn_context = connection->context;
+	gattlib_context_t* conn_context;
 	GError *error = NULL;
 
+	if (connection == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	// Do not reconnect on the loss of the link we are about to close
+	g_atomic_int_set(&conn_context->disconnecting, TRUE);
+
+	// Keep the connection until we know whether its attempt is still in progress
+	g_atomic_int_inc(&conn_context->ref);
+	if (g_atomic_int_compare_and_exchange(&conn_context->attempt_state, CONNECTION_ATTEMPT_PENDING, CONNECTION_ATTEMPT_CANCELLED)) {
+		// The connection is freed once the attempt has been cancelled
+		g_main_context_invoke(conn_context->connect_context, connection_cancel_attempt, connection);
+		return GATTLIB_SUCCESS;
+	} else if (g_atomic_int_get(&conn_context->attempt_state) != CONNECTION_ATTEMPT_ESTABLISHED) {
+		// The attempt has failed. The connection is freed once its callback has returned.
+		g_main_context_invoke(conn_context->connect_context, on_connection_unref, connection);
+		return GATTLIB_SUCCESS;
+	}
+	// The thread of the connection state machines holds its own reference until connection_dispose()
+	g_atomic_int_add(&conn_context->ref, -1);
+
 	org_bluez_device1_call_disconnect_sync(conn_context->device, NULL, &error);
 	if (error) {
 		GATTLIB_LOG(GATTLIB_ERROR, "Failed to disconnect DBus Bluez Device: %s", error->message);
 		g_error_free(error);
 	}
 
-	free(conn_context->device_object_path);
-	g_object_unref(conn_context->device);
 	g_list_free_full(conn_context->dbus_objects, g_object_unref);
 	g_main_loop_quit(conn_context->connection_loop);
 	pthread_join(conn_context->event_thread, NULL);
 	g_main_loop_unref(conn_context->connection_loop);
 	disconnect_all_notifications(conn_context);
-	
-	free(conn_context->adapter->adapter_name);
-	free(conn_context->adapter);
 
-	free(connection->context);
-	free(connection);
+	// The adapter given by the caller (eg: by an adapter group) is still used by its other connections
+	if (conn_context->default_adapter) {
+		gattlib_adapter_close(conn_context->adapter);
+	}
+	conn_context->adapter = NULL;
+
+	g_main_context_invoke(conn_context->connect_context, connection_dispose, connection);
 	return GATTLIB_SUCCESS;
 }
 
@@ -883,6 +1720,87 @@ int get_bluez_device_from_mac(struct gattlib_adapter *adapter, const char *mac_a
 	return GATTLIB_SUCCESS;
 }
 
+int gattlib_connection_set_parameters(gatt_connection_t* connection, const gattlib_connection_parameters_t *parameters)
+{
+	// Bluez does not expose the LE connection parameters on DBus
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_connection_set_data_length(gatt_connection_t* connection, uint16_t tx_octets, uint16_t tx_time)
+{
+	// Bluez does not expose the LE Data Length Extension on DBus
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_connection_set_phy(gatt_connection_t* connection, uint8_t tx_phys, uint8_t rx_phys)
+{
+	// Bluez does not expose the LE PHY on DBus
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_get_link_info(gatt_connection_t* connection, gattlib_link_info_t *info)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_get_mtu(gatt_connection_t* connection, uint16_t *mtu)
+{
+	gattlib_context_t* conn_context;
+	GDBusObjectManager *device_manager;
+	size_t device_object_path_len;
+	int ret = GATTLIB_NOT_SUPPORTED;
+
+	if ((connection == NULL) || (mtu == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// Bluez prior to v5.62 does not expose the 'MTU' property. The MTU is then only known once
+	// gattlib_write_char_by_uuid_stream_open() has acquired a characteristic.
+	conn_context = connection->context;
+	if (conn_context->mtu > 0) {
+		*mtu = conn_context->mtu;
+		return GATTLIB_SUCCESS;
+	}
+
+	device_manager = get_device_manager_from_adapter(conn_context->adapter);
+	if (device_manager == NULL) {
+		return GATTLIB_ERROR_DBUS;
+	}
+
+	device_object_path_len = strlen(conn_context->device_object_path);
+
+	// All the characteristics of the device share the same ATT MTU
+	for (GList *l = conn_context->dbus_objects; (l != NULL) && (ret != GATTLIB_SUCCESS); l = l->next) {
+		GDBusObject *object = l->data;
+		const char* object_path = g_dbus_object_get_object_path(G_DBUS_OBJECT(object));
+
+		// Only consider the objects of this device
+		if ((strncmp(object_path, conn_context->device_object_path, device_object_path_len) != 0) ||
+		    (object_path[device_object_path_len] != '/')) {
+			continue;
+		}
+
+		GDBusInterface *interface = g_dbus_object_manager_get_interface(device_manager, object_path, "org.bluez.GattCharacteristic1");
+		if (interface == NULL) {
+			continue;
+		}
+
+		GVariant *mtu_variant = g_dbus_proxy_get_cached_property(G_DBUS_PROXY(interface), "MTU");
+		if (mtu_variant) {
+			*mtu = g_variant_get_uint16(mtu_variant);
+			g_variant_unref(mtu_variant);
+			ret = GATTLIB_SUCCESS;
+		}
+
+		g_object_unref(interface);
+	}
+
+	if (ret == GATTLIB_SUCCESS) {
+		conn_context->mtu = *mtu;
+	}
+	return ret;
+}
+
 int gattlib_get_rssi(gatt_connection_t *connection, int16_t *rssi)
 {
 	if (connection == NULL) {
@@ -7,6 +7,82 @@
 #include "gattlib_internal.h"
 
 
+int gattlib_adapter_list(gattlib_adapter_info_t **adapters, size_t *adapters_count) {
+	GDBusObjectManager *device_manager;
+	GError *error = NULL;
+	GList *objects, *l;
+
+	if ((adapters == NULL) || (adapters_count == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	device_manager = g_dbus_object_manager_client_new_for_bus_sync(
+			G_BUS_TYPE_SYSTEM,
+			G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+			"org.bluez",
+			"/",
+			NULL, NULL, NULL, NULL,
+			&error);
+	if (device_manager == NULL) {
+		if (error) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Failed to get Bluez Device Manager: %s", error->message);
+			g_error_free(error);
+		} else {
+			GATTLIB_LOG(GATTLIB_ERROR, "Failed to get Bluez Device Manager.");
+		}
+		return GATTLIB_ERROR_DBUS;
+	}
+
+	objects = g_dbus_object_manager_get_objects(device_manager);
+
+	*adapters = calloc(g_list_length(objects) + 1, sizeof(gattlib_adapter_info_t));
+	if (*adapters == NULL) {
+		g_list_free_full(objects, g_object_unref);
+		g_object_unref(device_manager);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	*adapters_count = 0;
+
+	for (l = objects; l != NULL; l = l->next) {
+		const char* object_path = g_dbus_object_get_object_path(G_DBUS_OBJECT(l->data));
+		gattlib_adapter_info_t *info = &(*adapters)[*adapters_count];
+
+		GDBusInterface *interface = g_dbus_object_manager_get_interface(device_manager, object_path, "org.bluez.Adapter1");
+		if (!interface) {
+			continue;
+		}
+		g_object_unref(interface);
+
+		error = NULL;
+		OrgBluezAdapter1 *adapter_proxy = org_bluez_adapter1_proxy_new_for_bus_sync(
+				G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE,
+				"org.bluez",
+				object_path,
+				NULL, &error);
+		if (adapter_proxy == NULL) {
+			if (error) {
+				GATTLIB_LOG(GATTLIB_ERROR, "Failed to get adapter %s: %s", object_path, error->message);
+				g_error_free(error);
+			}
+			continue;
+		}
+
+		// The adapter name is the last element of its object path (eg: '/org/bluez/hci0')
+		snprintf(info->name, sizeof(info->name), "%s", strrchr(object_path, '/') + 1);
+		if (org_bluez_adapter1_get_address(adapter_proxy) != NULL) {
+			snprintf(info->address, sizeof(info->address), "%s", org_bluez_adapter1_get_address(adapter_proxy));
+		}
+		info->powered = org_bluez_adapter1_get_powered(adapter_proxy) ? 1 : 0;
+		(*adapters_count)++;
+
+		g_object_unref(adapter_proxy);
+	}
+
+	g_list_free_full(objects, g_object_unref);
+	g_object_unref(device_manager);
+	return GATTLIB_SUCCESS;
+}
+
 int gattlib_adapter_open(const char* adapter_name, void** adapter) {
 	char object_path[20];
 	OrgBluezAdapter1 *adapter_proxy;
@@ -98,6 +174,174 @@ GDBusObjectManager *get_device_manager_from_adapter(struct gattlib_adapter *gatt
 	return gattlib_adapter->device_manager;
 }
 
+struct gattlib_device_registry* gattlib_adapter_get_device_registry(void *adapter) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	struct gattlib_device_registry *device_registry;
+
+	if (gattlib_adapter == NULL) {
+		return NULL;
+	}
+
+	// The registry is allocated on first use (BLE scan or query) as most adapters are only used to connect
+	device_registry = g_atomic_pointer_get(&gattlib_adapter->device_registry);
+	if (device_registry == NULL) {
+		device_registry = gattlib_device_registry_new();
+		if (device_registry == NULL) {
+			return NULL;
+		}
+
+		if (!g_atomic_pointer_compare_and_exchange(&gattlib_adapter->device_registry, NULL, device_registry)) {
+			// Another thread has allocated it meanwhile
+			gattlib_device_registry_free(device_registry);
+			device_registry = g_atomic_pointer_get(&gattlib_adapter->device_registry);
+		}
+	}
+	return device_registry;
+}
+
+static void device_registry_update_from_device1(struct gattlib_adapter* gattlib_adapter, const uint8_t address[6], OrgBluezDevice1* device1)
+{
+	gattlib_advertisement_data_t *advertisement_data = NULL;
+	size_t advertisement_data_count = 0;
+	uint16_t manufacturer_id = 0;
+	uint8_t *manufacturer_data = NULL;
+	size_t manufacturer_data_size = 0;
+	struct gattlib_device_registry *device_registry = gattlib_adapter_get_device_registry(gattlib_adapter);
+
+	if (device_registry == NULL) {
+		return;
+	}
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 40)
+	int ret = get_advertisement_data_from_device(device1,
+			&advertisement_data, &advertisement_data_count,
+			&manufacturer_id, &manufacturer_data, &manufacturer_data_size);
+	if (ret != GATTLIB_SUCCESS) {
+		// Only record the RSSI
+		advertisement_data_count = 0;
+		manufacturer_data_size = 0;
+	}
+#endif
+
+	gattlib_device_registry_update(device_registry, address,
+			org_bluez_device1_get_rssi(device1),
+			advertisement_data, advertisement_data_count,
+			manufacturer_id, manufacturer_data, manufacturer_data_size);
+
+	for (size_t i = 0; i < advertisement_data_count; i++) {
+		free(advertisement_data[i].data);
+	}
+	free(advertisement_data);
+	free(manufacturer_data);
+}
+
+static void discovered_device_free(gpointer data)
+{
+	struct gattlib_discovered_device *discovered_device = data;
+
+	g_free(discovered_device->address);
+	g_free(discovered_device->object_path);
+	g_free(discovered_device);
+}
+
+static void discovered_device_evict(struct gattlib_adapter* gattlib_adapter, struct gattlib_discovered_device *discovered_device)
+{
+	GATTLIB_LOG(GATTLIB_DEBUG, "Evict device %s from the BLE scan table", discovered_device->address);
+
+	g_queue_unlink(&gattlib_adapter->ble_scan.discovered_devices_lru, &discovered_device->lru_link);
+
+	// Ask Bluez to forget the device. We do not wait for the answer to not stall the scan loop.
+	if ((gattlib_adapter->scan_device_table.flags & GATTLIB_SCAN_DEVICE_TABLE_REMOVE_EVICTED) && discovered_device->removable) {
+		org_bluez_adapter1_call_remove_device(gattlib_adapter->adapter_proxy, discovered_device->object_path, NULL, NULL, NULL);
+	}
+
+	if (gattlib_adapter->device_registry) {
+		uint8_t address[6];
+
+		if (gattlib_string_to_mac(discovered_device->address, address) == GATTLIB_SUCCESS) {
+			gattlib_device_registry_remove(gattlib_adapter->device_registry, address);
+		}
+	}
+
+	// The hash table owns the device. It is freed by 'discovered_device_free()'
+	g_hash_table_remove(gattlib_adapter->ble_scan.discovered_devices, discovered_device->address);
+}
+
+static gboolean discovered_devices_timeout_func(gpointer data)
+{
+	struct gattlib_adapter* gattlib_adapter = data;
+	gint64 device_timeout = (gint64)gattlib_adapter->scan_device_table.device_timeout * G_USEC_PER_SEC;
+	gint64 now = g_get_monotonic_time();
+	GList *head;
+
+	// The LRU list is ordered by 'last_seen'. We can stop at the first device that is not idle.
+	while ((head = g_queue_peek_head_link(&gattlib_adapter->ble_scan.discovered_devices_lru)) != NULL) {
+		struct gattlib_discovered_device *discovered_device = head->data;
+
+		if (now - discovered_device->last_seen < device_timeout) {
+			break;
+		}
+
+		discovered_device_evict(gattlib_adapter, discovered_device);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void discovered_devices_batch_flush(struct gattlib_adapter* gattlib_adapter)
+{
+	GArray *batch = gattlib_adapter->ble_scan.batch;
+
+	if ((batch == NULL) || (batch->len == 0)) {
+		return;
+	}
+
+#if defined(WITH_PYTHON)
+	// In case of Python support, we ensure we acquire the GIL (Global Intepreter Lock) to have
+	// a thread-safe Python execution. It is only acquired once for the whole batch.
+	PyGILState_STATE d_gstate;
+	d_gstate = PyGILState_Ensure();
+#endif
+
+	gattlib_adapter->scan_batch.callback(gattlib_adapter,
+		(const gattlib_discovered_device_info_t *)batch->data, batch->len,
+		gattlib_adapter->ble_scan.discovered_device_user_data);
+
+#if defined(WITH_PYTHON)
+	PyGILState_Release(d_gstate);
+#endif
+
+	for (guint i = 0; i < batch->len; i++) {
+		gattlib_discovered_device_info_t *device = &g_array_index(batch, gattlib_discovered_device_info_t, i);
+		g_free((char*)device->addr);
+		g_free((char*)device->name);
+	}
+	g_array_set_size(batch, 0);
+}
+
+static gboolean discovered_devices_batch_timeout_func(gpointer data)
+{
+	discovered_devices_batch_flush(data);
+	return G_SOURCE_CONTINUE;
+}
+
+static void discovered_devices_batch_add(struct gattlib_adapter* gattlib_adapter, const char *addr, const char *name)
+{
+	gattlib_discovered_device_info_t device = {
+		.addr = g_strdup(addr),
+		.name = g_strdup(name),
+	};
+
+	g_array_append_val(gattlib_adapter->ble_scan.batch, device);
+
+	if ((gattlib_adapter->scan_batch.max_devices > 0) &&
+	    (gattlib_adapter->ble_scan.batch->len >= gattlib_adapter->scan_batch.max_devices))
+	{
+		discovered_devices_batch_flush(gattlib_adapter);
+	}
+}
+
 static void device_manager_on_device1_signal(const char* device1_path, struct gattlib_adapter* gattlib_adapter)
 {
 	GError *error = NULL;
@@ -123,16 +367,46 @@ static void device_manager_on_device1_signal(const char* device1_path, struct ga
 			return;
 		}
 
-		// Check if the device is already part of the list
-		GSList *item = g_slist_find_custom(gattlib_adapter->ble_scan.discovered_devices, address, (GCompareFunc)g_ascii_strcasecmp);
+		// Check if the device is already part of the table
+		struct gattlib_discovered_device *discovered_device = g_hash_table_lookup(gattlib_adapter->ble_scan.discovered_devices, address);
+		bool is_new_device = (discovered_device == NULL);
+
+		if (is_new_device) {
+			// First time this device is in the table
+			discovered_device = g_new0(struct gattlib_discovered_device, 1);
+			discovered_device->address = g_strdup(address);
+			discovered_device->object_path = g_strdup(device1_path);
+			discovered_device->lru_link.data = discovered_device;
+
+			g_hash_table_insert(gattlib_adapter->ble_scan.discovered_devices, discovered_device->address, discovered_device);
+		} else {
+			// Move the device at the tail of the LRU list
+			g_queue_unlink(&gattlib_adapter->ble_scan.discovered_devices_lru, &discovered_device->lru_link);
+		}
+
+		uint8_t mac[6];
+		if (gattlib_string_to_mac(address, mac) == GATTLIB_SUCCESS) {
+			device_registry_update_from_device1(gattlib_adapter, mac, device1);
+		}
 
-		// First time this device is in the list
-		if (item == NULL) {
-			// Add the device to the list
-			gattlib_adapter->ble_scan.discovered_devices = g_slist_append(gattlib_adapter->ble_scan.discovered_devices, g_strdup(address));
+		discovered_device->last_seen = g_get_monotonic_time();
+		discovered_device->removable = !org_bluez_device1_get_paired(device1) && !org_bluez_device1_get_connected(device1);
+		g_queue_push_tail_link(&gattlib_adapter->ble_scan.discovered_devices_lru, &discovered_device->lru_link);
+
+		// Ensure the table does not exceed its capacity by evicting the least recently seen device
+		if ((gattlib_adapter->scan_device_table.max_devices > 0) &&
+		    (g_hash_table_size(gattlib_adapter->ble_scan.discovered_devices) > gattlib_adapter->scan_device_table.max_devices))
+		{
+			discovered_device_evict(gattlib_adapter, g_queue_peek_head(&gattlib_adapter->ble_scan.discovered_devices_lru));
 		}
 
-		if ((item == NULL) || (gattlib_adapter->ble_scan.enabled_filters & GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE)) {
+		bool report_device = is_new_device || (gattlib_adapter->ble_scan.enabled_filters & GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE);
+
+		if (report_device && gattlib_adapter->ble_scan.batch) {
+			discovered_devices_batch_add(gattlib_adapter,
+				org_bluez_device1_get_address(device1),
+				org_bluez_device1_get_name(device1));
+		} else if (report_device) {
 #if defined(WITH_PYTHON)
 			// In case of Python support, we ensure we acquire the GIL (Global Intepreter Lock) to have
 			// a thread-safe Python execution.
@@ -206,6 +480,19 @@ static void* _ble_scan_loop(void* args) {
 			stop_scan_func, gattlib_adapter->ble_scan.scan_loop);
 	}
 
+	// Periodically evict the devices that have not been seen for 'device_timeout' seconds
+	if (gattlib_adapter->scan_device_table.device_timeout > 0) {
+		gattlib_adapter->ble_scan.device_timeout_id = g_timeout_add_seconds(
+			MAX(gattlib_adapter->scan_device_table.device_timeout / 2, 1),
+			discovered_devices_timeout_func, gattlib_adapter);
+	}
+
+	// Deliver the pending discovered devices at least every 'period_ms' milliseconds
+	if (gattlib_adapter->ble_scan.batch && (gattlib_adapter->scan_batch.period_ms > 0)) {
+		gattlib_adapter->ble_scan.batch_timeout_id = g_timeout_add(gattlib_adapter->scan_batch.period_ms,
+			discovered_devices_batch_timeout_func, gattlib_adapter);
+	}
+
 	// And start the loop...
 	g_main_loop_run(gattlib_adapter->ble_scan.scan_loop);
 	// At this point, either the timeout expired (and automatically was removed) or scan_disable was called, removing the timer.
@@ -216,12 +503,30 @@ static void* _ble_scan_loop(void* args) {
 	g_signal_handler_disconnect(G_DBUS_OBJECT_MANAGER(gattlib_adapter->device_manager), gattlib_adapter->ble_scan.added_signal_id);
 	g_signal_handler_disconnect(G_DBUS_OBJECT_MANAGER(gattlib_adapter->device_manager), gattlib_adapter->ble_scan.changed_signal_id);
 
+	if (gattlib_adapter->ble_scan.device_timeout_id) {
+		g_source_remove(gattlib_adapter->ble_scan.device_timeout_id);
+		gattlib_adapter->ble_scan.device_timeout_id = 0;
+	}
+
+	// Deliver the remaining discovered devices
+	if (gattlib_adapter->ble_scan.batch) {
+		if (gattlib_adapter->ble_scan.batch_timeout_id) {
+			g_source_remove(gattlib_adapter->ble_scan.batch_timeout_id);
+			gattlib_adapter->ble_scan.batch_timeout_id = 0;
+		}
+
+		discovered_devices_batch_flush(gattlib_adapter);
+		g_array_free(gattlib_adapter->ble_scan.batch, TRUE);
+		gattlib_adapter->ble_scan.batch = NULL;
+	}
+
 	// Ensure BLE device discovery is stopped
 	gattlib_adapter_scan_disable(gattlib_adapter);
 
-	// Free discovered device list
-	g_slist_foreach(gattlib_adapter->ble_scan.discovered_devices, (GFunc)g_free, NULL);
-	g_slist_free(gattlib_adapter->ble_scan.discovered_devices);
+	// Free discovered device table. The LRU list only chains links embedded in the devices.
+	g_queue_init(&gattlib_adapter->ble_scan.discovered_devices_lru);
+	g_hash_table_destroy(gattlib_adapter->ble_scan.discovered_devices);
+	gattlib_adapter->ble_scan.discovered_devices = NULL;
 	return 0;
 }
 
@@ -285,6 +590,11 @@ static int _gattlib_adapter_scan_enable_with_filter(void *adapter, uuid_t **uuid
 	gattlib_adapter->ble_scan.ble_scan_timeout = timeout;
 	gattlib_adapter->ble_scan.discovered_device_callback = discovered_device_cb;
 	gattlib_adapter->ble_scan.discovered_device_user_data = user_data;
+	gattlib_adapter->ble_scan.discovered_devices = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, discovered_device_free);
+	g_queue_init(&gattlib_adapter->ble_scan.discovered_devices_lru);
+	if (gattlib_adapter->scan_batch.callback) {
+		gattlib_adapter->ble_scan.batch = g_array_new(FALSE, FALSE, sizeof(gattlib_discovered_device_info_t));
+	}
 
 	gattlib_adapter->ble_scan.added_signal_id = g_signal_connect(G_DBUS_OBJECT_MANAGER(device_manager),
 	                    "object-added",
@@ -302,6 +612,17 @@ static int _gattlib_adapter_scan_enable_with_filter(void *adapter, uuid_t **uuid
 	if (error) {
 		GATTLIB_LOG(GATTLIB_ERROR, "Failed to start discovery: %s", error->message);
 		g_error_free(error);
+
+		// Undo the BLE scan setup as the scan loop will not run
+		g_signal_handler_disconnect(G_DBUS_OBJECT_MANAGER(device_manager), gattlib_adapter->ble_scan.added_signal_id);
+		g_signal_handler_disconnect(G_DBUS_OBJECT_MANAGER(device_manager), gattlib_adapter->ble_scan.changed_signal_id);
+		if (gattlib_adapter->ble_scan.batch) {
+			g_array_free(gattlib_adapter->ble_scan.batch, TRUE);
+			gattlib_adapter->ble_scan.batch = NULL;
+		}
+		g_queue_init(&gattlib_adapter->ble_scan.discovered_devices_lru);
+		g_hash_table_destroy(gattlib_adapter->ble_scan.discovered_devices);
+		gattlib_adapter->ble_scan.discovered_devices = NULL;
 		return GATTLIB_ERROR_DBUS;
 	}
 
@@ -352,6 +673,54 @@ int gattlib_adapter_scan_enable(void* adapter, gattlib_discovered_device_t disco
 			discovered_device_cb, timeout, user_data);
 }
 
+int gattlib_adapter_scan_enable_with_reports(void* adapter, gattlib_advertising_report_cb_t advertising_report_cb, size_t timeout, void *user_data)
+{
+	// Bluez does not expose the raw advertising reports on DBus
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_scan_set_parameters(void *adapter, const gattlib_scan_parameters_t *parameters)
+{
+	// Bluez manages the scan parameters of the controller
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_scan_set_accept_list(void *adapter, const gattlib_accept_list_entry_t *entries, size_t entries_count)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_scan_set_device_table(void *adapter, size_t max_devices, size_t device_timeout, uint32_t flags)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_adapter->scan_device_table.max_devices = max_devices;
+	gattlib_adapter->scan_device_table.device_timeout = device_timeout;
+	gattlib_adapter->scan_device_table.flags = flags;
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_scan_set_batch(void *adapter, gattlib_discovered_devices_t discovered_devices_cb,
+		size_t batch_period_ms, size_t batch_max_devices)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_adapter->scan_batch.callback = discovered_devices_cb;
+	gattlib_adapter->scan_batch.period_ms = batch_period_ms;
+	gattlib_adapter->scan_batch.max_devices = batch_max_devices;
+
+	return GATTLIB_SUCCESS;
+}
+
 int gattlib_adapter_scan_disable(void* adapter) {
 	struct gattlib_adapter *gattlib_adapter = adapter;
 
@@ -385,6 +754,7 @@ int gattlib_adapter_close(void* adapter)
 	if (gattlib_adapter->device_manager)
 		g_object_unref(gattlib_adapter->device_manager);
 	g_object_unref(gattlib_adapter->adapter_proxy);
+	gattlib_device_registry_free(gattlib_adapter->device_registry);
 	free(gattlib_adapter->adapter_name);
 	free(gattlib_adapter);
 
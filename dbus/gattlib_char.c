@@ -204,42 +204,51 @@ static struct dbus_characteristic get_characteristic_from_handle(gatt_connection
 	return dbus_characteristic;
 }
 
-static int read_gatt_characteristic(struct dbus_characteristic *dbus_characteristic, void **buffer, size_t* buffer_len) {
+static int get_value_from_variant(GVariant *value, void **buffer, size_t* buffer_len) {
+	gsize n_elements = 0;
+	gconstpointer const_buffer = g_variant_get_fixed_array(value, &n_elements, sizeof(guchar));
+	if (const_buffer) {
+		*buffer = malloc(n_elements);
+		if (*buffer == NULL) {
+			return GATTLIB_OUT_OF_MEMORY;
+		}
+
+		*buffer_len = n_elements;
+		memcpy(*buffer, const_buffer, n_elements);
+	} else {
+		*buffer_len = 0;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+static int read_gatt_characteristic(gattlib_context_t* conn_context, struct dbus_characteristic *dbus_characteristic,
+		void **buffer, size_t* buffer_len)
+{
+	GCancellable *cancellable = connection_operation_begin(conn_context, dbus_characteristic->gatt);
 	GVariant *out_value;
 	GError *error = NULL;
-	int ret = GATTLIB_SUCCESS;
+	int ret;
 
 #if BLUEZ_VERSION < BLUEZ_VERSIONS(5, 40)
 	org_bluez_gatt_characteristic1_call_read_value_sync(
-		dbus_characteristic->gatt, &out_value, NULL, &error);
+		dbus_characteristic->gatt, &out_value, cancellable, &error);
 #else
 	GVariantBuilder *options =  g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
 	org_bluez_gatt_characteristic1_call_read_value_sync(
-			dbus_characteristic->gatt, g_variant_builder_end(options), &out_value, NULL, &error);
+			dbus_characteristic->gatt, g_variant_builder_end(options), &out_value, cancellable, &error);
 	g_variant_builder_unref(options);
 #endif
+	g_object_unref(cancellable);
 	if (error != NULL) {
 		GATTLIB_LOG(GATTLIB_ERROR, "Failed to read DBus GATT characteristic: %s", error->message);
+		ret = connection_operation_error(error);
 		g_error_free(error);
-		return GATTLIB_ERROR_DBUS;
+		return ret;
 	}
 
-	gsize n_elements = 0;
-	gconstpointer const_buffer = g_variant_get_fixed_array(out_value, &n_elements, sizeof(guchar));
-	if (const_buffer) {
-		*buffer = malloc(n_elements);
-		if (*buffer == NULL) {
-			ret = GATTLIB_OUT_OF_MEMORY;
-			goto EXIT;
-		}
+	ret = get_value_from_variant(out_value, buffer, buffer_len);
 
-		*buffer_len = n_elements;
-		memcpy(*buffer, const_buffer, n_elements);
-	} else {
-		*buffer_len = 0;
-	}
-
-EXIT:
 	g_variant_unref(out_value);
 	return ret;
 }
@@ -262,8 +271,17 @@ static int read_battery_level(struct dbus_characteristic *dbus_characteristic, v
 }
 #endif
 
-int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, void **buffer, size_t *buffer_len) {
-	struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, uuid);
+struct read_char_request {
+	gatt_connection_t* connection;
+	const uuid_t*      uuid;
+};
+
+/* Resolve and read the characteristic. It is issued by the read coalescer. */
+static int read_char_by_uuid(void* user_data, void **buffer, size_t *buffer_len) {
+	struct read_char_request* request = user_data;
+	gatt_connection_t* connection = request->connection;
+
+	struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, request->uuid);
 	if (dbus_characteristic.type == TYPE_NONE) {
 		return GATTLIB_NOT_FOUND;
 	}
@@ -277,7 +295,7 @@ int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, void
 
 		assert(dbus_characteristic.type == TYPE_GATT);
 
-		ret = read_gatt_characteristic(&dbus_characteristic, buffer, buffer_len);
+		ret = read_gatt_characteristic(connection->context, &dbus_characteristic, buffer, buffer_len);
 
 		g_object_unref(dbus_characteristic.gatt);
 
@@ -285,6 +303,29 @@ int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, void
 	}
 }
 
+int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, void **buffer, size_t *buffer_len) {
+	gattlib_context_t* conn_context = connection->context;
+	struct read_char_request request = {
+		.connection = connection,
+		.uuid       = uuid,
+	};
+	uint64_t cache_sequence;
+	int ret;
+
+	if (gattlib_value_cache_get(conn_context->value_cache, uuid, buffer, buffer_len)) {
+		return GATTLIB_SUCCESS;
+	}
+	cache_sequence = gattlib_value_cache_sequence(conn_context->value_cache);
+
+	// The threads reading this characteristic at the same time share the same D-Bus call
+	ret = gattlib_read_coalescer_read(conn_context->read_coalescer, uuid,
+			read_char_by_uuid, &request, buffer, buffer_len);
+	if (ret == GATTLIB_SUCCESS) {
+		gattlib_value_cache_update_from_read(conn_context->value_cache, uuid, *buffer, *buffer_len, cache_sequence);
+	}
+	return ret;
+}
+
 int gattlib_read_char_by_uuid_async(gatt_connection_t* connection, uuid_t* uuid, gatt_read_cb_t gatt_read_cb) {
 	int ret = GATTLIB_SUCCESS;
 
@@ -307,22 +348,24 @@ int gattlib_read_char_by_uuid_async(gatt_connection_t* connection, uuid_t* uuid,
 	}
 #endif
 
+	GCancellable *cancellable = connection_operation_begin(connection->context, dbus_characteristic.gatt);
 	GVariant *out_value;
 	GError *error = NULL;
 
 #if BLUEZ_VERSION < BLUEZ_VERSIONS(5, 40)
 	org_bluez_gatt_characteristic1_call_read_value_sync(
-		dbus_characteristic.gatt, &out_value, NULL, &error);
+		dbus_characteristic.gatt, &out_value, cancellable, &error);
 #else
 	GVariantBuilder *options =  g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
 	org_bluez_gatt_characteristic1_call_read_value_sync(
-			dbus_characteristic.gatt, g_variant_builder_end(options), &out_value, NULL, &error);
+			dbus_characteristic.gatt, g_variant_builder_end(options), &out_value, cancellable, &error);
 	g_variant_builder_unref(options);
 #endif
+	g_object_unref(cancellable);
 	if (error != NULL) {
 		GATTLIB_LOG(GATTLIB_ERROR, "Failed to read DBus GATT characteristic: %s", error->message);
+		ret = connection_operation_error(error);
 		g_error_free(error);
-		ret = GATTLIB_ERROR_DBUS;
 		goto EXIT;
 	}
 
@@ -339,29 +382,279 @@ EXIT:
 	return ret;
 }
 
-static int write_char(struct dbus_characteristic *dbus_characteristic, const void* buffer, size_t buffer_len, uint32_t options)
+static void invalidate_cached_value(gattlib_context_t* conn_context, OrgBluezGattCharacteristic1 *gatt) {
+	const gchar *uuid_str = org_bluez_gatt_characteristic1_get_uuid(gatt);
+	uuid_t uuid;
+
+	if ((uuid_str != NULL) && (gattlib_string_to_uuid(uuid_str, MAX_LEN_UUID_STR + 1, &uuid) == GATTLIB_SUCCESS)) {
+		gattlib_value_cache_invalidate(conn_context->value_cache, &uuid);
+	}
+}
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 40)
+//
+// Coalesced writes without response: a single write per characteristic is in progress. The value
+// written meanwhile replaces the value waiting to be sent, so only the latest one is sent next.
+// The completions are dispatched to the thread-default context of the writer, that is the global
+// default context run by the connection event thread.
+//
+struct coalesced_write {
+	gint ref;
+	GMutex mutex;
+	OrgBluezGattCharacteristic1 *gatt;
+	bool in_flight;
+	// Latest value waiting for the write in progress to complete
+	GBytes *pending;
+	// Set when coalescing is disabled or the connection is closed. No more value is sent.
+	bool closed;
+};
+
+static void coalesced_write_unref(struct coalesced_write *write) {
+	if (!g_atomic_int_dec_and_test(&write->ref)) {
+		return;
+	}
+
+	if (write->pending != NULL) {
+		g_bytes_unref(write->pending);
+	}
+	g_object_unref(write->gatt);
+	g_mutex_clear(&write->mutex);
+	free(write);
+}
+
+static void coalesced_write_send(struct coalesced_write *write, GBytes *value);
+
+static void on_coalesced_write_done(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+	struct coalesced_write *write = user_data;
+	GError *error = NULL;
+	GBytes *next;
+
+	org_bluez_gatt_characteristic1_call_write_value_finish(write->gatt, res, &error);
+	if (error != NULL) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to write DBus GATT characteristic: %s", error->message);
+		g_error_free(error);
+	}
+
+	g_mutex_lock(&write->mutex);
+	next = write->pending;
+	write->pending = NULL;
+	write->in_flight = (next != NULL);
+	g_mutex_unlock(&write->mutex);
+
+	if (next != NULL) {
+		// The reference of the write in progress is passed to the next one
+		coalesced_write_send(write, next);
+		g_bytes_unref(next);
+	} else {
+		coalesced_write_unref(write);
+	}
+}
+
+static void coalesced_write_send(struct coalesced_write *write, GBytes *value) {
+	GVariantBuilder *variant_options = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+
+	g_variant_builder_add(variant_options, "{sv}", "type", g_variant_new("s", "command"));
+
+	org_bluez_gatt_characteristic1_call_write_value(write->gatt,
+		g_variant_new_from_bytes(G_VARIANT_TYPE("ay"), value, TRUE),
+		g_variant_builder_end(variant_options), NULL,
+		(GAsyncReadyCallback) on_coalesced_write_done, write);
+	g_variant_builder_unref(variant_options);
+}
+
+/* Called with 'coalesced_writes_mutex' locked */
+static GList* find_coalesced_write(gattlib_context_t* conn_context, OrgBluezGattCharacteristic1 *gatt) {
+	const gchar *object_path = g_dbus_proxy_get_object_path(G_DBUS_PROXY(gatt));
+	GList *l;
+
+	for (l = conn_context->coalesced_writes; l != NULL; l = l->next) {
+		struct coalesced_write *entry = l->data;
+
+		if (g_strcmp0(g_dbus_proxy_get_object_path(G_DBUS_PROXY(entry->gatt)), object_path) == 0) {
+			return l;
+		}
+	}
+	return NULL;
+}
+
+static struct coalesced_write* get_coalesced_write(gattlib_context_t* conn_context, OrgBluezGattCharacteristic1 *gatt) {
+	struct coalesced_write *write = NULL;
+	GList *l;
+
+	g_mutex_lock(&conn_context->coalesced_writes_mutex);
+	l = find_coalesced_write(conn_context, gatt);
+	if (l != NULL) {
+		write = l->data;
+		g_atomic_int_inc(&write->ref);
+	}
+	g_mutex_unlock(&conn_context->coalesced_writes_mutex);
+
+	return write;
+}
+
+static void coalesced_write_value(struct coalesced_write *write, const void* buffer, size_t buffer_len) {
+	GBytes *value = g_bytes_new(buffer, buffer_len);
+	bool send = false;
+
+	g_mutex_lock(&write->mutex);
+	if (write->closed) {
+		// Coalescing has been disabled meanwhile, the value is dropped
+	} else if (write->in_flight) {
+		if (write->pending != NULL) {
+			g_bytes_unref(write->pending);
+		}
+		write->pending = g_bytes_ref(value);
+	} else {
+		write->in_flight = true;
+		send = true;
+	}
+	g_mutex_unlock(&write->mutex);
+
+	if (send) {
+		// This reference is released when no more value is pending
+		g_atomic_int_inc(&write->ref);
+		coalesced_write_send(write, value);
+	}
+	g_bytes_unref(value);
+}
+
+static void coalesced_write_close(struct coalesced_write *write) {
+	g_mutex_lock(&write->mutex);
+	write->closed = true;
+	if (write->pending != NULL) {
+		g_bytes_unref(write->pending);
+		write->pending = NULL;
+	}
+	g_mutex_unlock(&write->mutex);
+
+	coalesced_write_unref(write);
+}
+#endif
+
+void free_all_coalesced_writes(gattlib_context_t* conn_context) {
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 40)
+	g_mutex_lock(&conn_context->coalesced_writes_mutex);
+	g_list_free_full(conn_context->coalesced_writes, (GDestroyNotify) coalesced_write_close);
+	conn_context->coalesced_writes = NULL;
+	g_mutex_unlock(&conn_context->coalesced_writes_mutex);
+#endif
+}
+
+int gattlib_write_without_response_set_coalescing(gatt_connection_t* connection, const uuid_t* uuid, int enable) {
+#if BLUEZ_VERSION < BLUEZ_VERSIONS(5, 40)
+	// Bluez does not support the options of WriteValue() prior to v5.40
+	return GATTLIB_NOT_SUPPORTED;
+#else
+	gattlib_context_t* conn_context;
+	struct coalesced_write *write;
+
+	if ((connection == NULL) || (uuid == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, uuid);
+	if (dbus_characteristic.type == TYPE_NONE) {
+		return GATTLIB_NOT_FOUND;
+	} else if (dbus_characteristic.type == TYPE_BATTERY_LEVEL) {
+		return GATTLIB_NOT_SUPPORTED; // Battery level does not support write
+	} else {
+		assert(dbus_characteristic.type == TYPE_GATT);
+	}
+
+	if (!enable) {
+		GList *l;
+
+		// The lookup and the removal are atomic: only one of concurrent callers releases the write
+		g_mutex_lock(&conn_context->coalesced_writes_mutex);
+		l = find_coalesced_write(conn_context, dbus_characteristic.gatt);
+		if (l != NULL) {
+			write = l->data;
+			conn_context->coalesced_writes = g_list_delete_link(conn_context->coalesced_writes, l);
+		} else {
+			write = NULL;
+		}
+		g_mutex_unlock(&conn_context->coalesced_writes_mutex);
+
+		if (write != NULL) {
+			// Release the reference of the list. The write in progress holds its own reference.
+			coalesced_write_close(write);
+		}
+		g_object_unref(dbus_characteristic.gatt);
+		return GATTLIB_SUCCESS;
+	}
+
+	write = calloc(1, sizeof(struct coalesced_write));
+	if (write == NULL) {
+		g_object_unref(dbus_characteristic.gatt);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	write->ref = 1;
+	g_mutex_init(&write->mutex);
+	// The proxy is owned by the coalesced write
+	write->gatt = dbus_characteristic.gatt;
+
+	g_mutex_lock(&conn_context->coalesced_writes_mutex);
+	if (find_coalesced_write(conn_context, write->gatt) == NULL) {
+		conn_context->coalesced_writes = g_list_append(conn_context->coalesced_writes, write);
+		write = NULL;
+	}
+	g_mutex_unlock(&conn_context->coalesced_writes_mutex);
+
+	if (write != NULL) {
+		// Coalescing is already enabled on this characteristic
+		coalesced_write_unref(write);
+	}
+	return GATTLIB_SUCCESS;
+#endif
+}
+
+static int write_char(gattlib_context_t* conn_context, struct dbus_characteristic *dbus_characteristic,
+		const void* buffer, size_t buffer_len, uint32_t options)
 {
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 40)
+	if ((options & BLUEZ_GATT_WRITE_VALUE_TYPE_MASK) == BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE) {
+		struct coalesced_write *write = get_coalesced_write(conn_context, dbus_characteristic->gatt);
+		if (write != NULL) {
+			coalesced_write_value(write, buffer, buffer_len);
+			coalesced_write_unref(write);
+
+			invalidate_cached_value(conn_context, dbus_characteristic->gatt);
+			return GATTLIB_SUCCESS;
+		}
+	}
+#endif
+
 	GVariant *value = g_variant_new_from_data(G_VARIANT_TYPE ("ay"), buffer, buffer_len, TRUE, NULL, NULL);
+	GCancellable *cancellable = connection_operation_begin(conn_context, dbus_characteristic->gatt);
 	GError *error = NULL;
 	int ret = GATTLIB_SUCCESS;
 
 #if BLUEZ_VERSION < BLUEZ_VERSIONS(5, 40)
-	org_bluez_gatt_characteristic1_call_write_value_sync(dbus_characteristic->gatt, value, NULL, &error);
+	org_bluez_gatt_characteristic1_call_write_value_sync(dbus_characteristic->gatt, value, cancellable, &error);
 #else
 	GVariantBuilder *variant_options = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
 
 	if ((options & BLUEZ_GATT_WRITE_VALUE_TYPE_MASK) == BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE) {
 		g_variant_builder_add(variant_options, "{sv}", "type", g_variant_new("s", "command"));
+	} else if ((options & BLUEZ_GATT_WRITE_VALUE_TYPE_MASK) == BLUEZ_GATT_WRITE_VALUE_TYPE_RELIABLE_WRITE) {
+		// Bluez segments the value with Prepare Write requests and commits it with Execute Write
+		g_variant_builder_add(variant_options, "{sv}", "type", g_variant_new("s", "reliable"));
 	}
 
-	org_bluez_gatt_characteristic1_call_write_value_sync(dbus_characteristic->gatt, value, g_variant_builder_end(variant_options), NULL, &error);
+	org_bluez_gatt_characteristic1_call_write_value_sync(dbus_characteristic->gatt, value, g_variant_builder_end(variant_options), cancellable, &error);
 	g_variant_builder_unref(variant_options);
 #endif
+	g_object_unref(cancellable);
+
+	// Drop the cached value of the characteristic, the write might have changed it
+	invalidate_cached_value(conn_context, dbus_characteristic->gatt);
 
 	if (error != NULL) {
 		GATTLIB_LOG(GATTLIB_ERROR, "Failed to write DBus GATT characteristic: %s", error->message);
+		ret = connection_operation_error(error);
 		g_error_free(error);
-		return GATTLIB_ERROR_DBUS;
+		return ret;
 	}
 
 	//
@@ -385,7 +678,7 @@ int gattlib_write_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, cons
 		assert(dbus_characteristic.type == TYPE_GATT);
 	}
 
-	ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
+	ret = write_char(connection->context, &dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
 
 	g_object_unref(dbus_characteristic.gatt);
 	return ret;
@@ -400,7 +693,41 @@ int gattlib_write_char_by_handle(gatt_connection_t* connection, uint16_t handle,
 		return GATTLIB_NOT_FOUND;
 	}
 
-	ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
+	ret = write_char(connection->context, &dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
+
+	g_object_unref(dbus_characteristic.gatt);
+	return ret;
+}
+
+int gattlib_write_long_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, const void* buffer, size_t buffer_len)
+{
+	int ret;
+
+	struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, uuid);
+	if (dbus_characteristic.type == TYPE_NONE) {
+		return GATTLIB_NOT_FOUND;
+	} else if (dbus_characteristic.type == TYPE_BATTERY_LEVEL) {
+		return GATTLIB_NOT_SUPPORTED; // Battery level does not support write
+	} else {
+		assert(dbus_characteristic.type == TYPE_GATT);
+	}
+
+	ret = write_char(connection->context, &dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_RELIABLE_WRITE);
+
+	g_object_unref(dbus_characteristic.gatt);
+	return ret;
+}
+
+int gattlib_write_long_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len)
+{
+	int ret;
+
+	struct dbus_characteristic dbus_characteristic = get_characteristic_from_handle(connection, handle);
+	if (dbus_characteristic.type == TYPE_NONE) {
+		return GATTLIB_NOT_FOUND;
+	}
+
+	ret = write_char(connection->context, &dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_RELIABLE_WRITE);
 
 	g_object_unref(dbus_characteristic.gatt);
 	return ret;
@@ -419,7 +746,7 @@ int gattlib_write_without_response_char_by_uuid(gatt_connection_t* connection, u
 		assert(dbus_characteristic.type == TYPE_GATT);
 	}
 
-	ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE);
+	ret = write_char(connection->context, &dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE);
 
 	g_object_unref(dbus_characteristic.gatt);
 	return ret;
@@ -434,12 +761,114 @@ int gattlib_write_without_response_char_by_handle(gatt_connection_t* connection,
 		return GATTLIB_NOT_FOUND;
 	}
 
-	ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE);
+	ret = write_char(connection->context, &dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE);
 
 	g_object_unref(dbus_characteristic.gatt);
 	return ret;
 }
 
+struct read_multiple_request {
+	OrgBluezGattCharacteristic1 *gatt;
+	gattlib_read_multiple_t* read;
+	int* pending;
+};
+
+static void on_read_multiple_value(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+	struct read_multiple_request* request = user_data;
+	GVariant *out_value = NULL;
+	GError *error = NULL;
+
+	org_bluez_gatt_characteristic1_call_read_value_finish(request->gatt, &out_value, res, &error);
+	if (error != NULL) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to read DBus GATT characteristic: %s", error->message);
+		request->read->ret = connection_operation_error(error);
+		g_error_free(error);
+	} else {
+		request->read->ret = get_value_from_variant(out_value, &request->read->buffer, &request->read->buffer_len);
+		g_variant_unref(out_value);
+	}
+
+	g_object_unref(request->gatt);
+	(*request->pending)--;
+	free(request);
+}
+
+int gattlib_read_multiple(gatt_connection_t* connection, gattlib_read_multiple_t* reads, size_t count) {
+	GMainContext *context;
+	int pending = 0;
+	size_t i;
+	int ret;
+
+	if ((connection == NULL) || ((reads == NULL) && (count > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// Bluez does not expose ATT Read Multiple. Instead we issue all the reads before waiting for the values.
+	// The completions are dispatched to a private main context to not depend on a running main loop.
+	context = g_main_context_new();
+	g_main_context_push_thread_default(context);
+
+	for (i = 0; i < count; i++) {
+		struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, &reads[i].uuid);
+		struct read_multiple_request* request;
+		GCancellable *cancellable;
+
+		reads[i].buffer     = NULL;
+		reads[i].buffer_len = 0;
+
+		if (dbus_characteristic.type == TYPE_NONE) {
+			reads[i].ret = GATTLIB_NOT_FOUND;
+			continue;
+		}
+#if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
+		else if (dbus_characteristic.type == TYPE_BATTERY_LEVEL) {
+			reads[i].ret = read_battery_level(&dbus_characteristic, &reads[i].buffer, &reads[i].buffer_len);
+			continue;
+		}
+#endif
+
+		request = malloc(sizeof(struct read_multiple_request));
+		if (request == NULL) {
+			g_object_unref(dbus_characteristic.gatt);
+			reads[i].ret = GATTLIB_OUT_OF_MEMORY;
+			continue;
+		}
+		request->gatt    = dbus_characteristic.gatt;
+		request->read    = &reads[i];
+		request->pending = &pending;
+		pending++;
+
+		cancellable = connection_operation_begin(connection->context, dbus_characteristic.gatt);
+#if BLUEZ_VERSION < BLUEZ_VERSIONS(5, 40)
+		org_bluez_gatt_characteristic1_call_read_value(
+			dbus_characteristic.gatt, cancellable, on_read_multiple_value, request);
+#else
+		GVariantBuilder *options =  g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+		org_bluez_gatt_characteristic1_call_read_value(
+			dbus_characteristic.gatt, g_variant_builder_end(options), cancellable, on_read_multiple_value, request);
+		g_variant_builder_unref(options);
+#endif
+		g_object_unref(cancellable);
+	}
+
+	// Wait for completion of the reads
+	while (pending > 0) {
+		g_main_context_iteration(context, TRUE);
+	}
+
+	g_main_context_pop_thread_default(context);
+	g_main_context_unref(context);
+
+	ret = GATTLIB_SUCCESS;
+	for (i = 0; i < count; i++) {
+		if (reads[i].ret != GATTLIB_SUCCESS) {
+			ret = reads[i].ret;
+			break;
+		}
+	}
+	return ret;
+}
+
 void gattlib_characteristic_free_value(void *ptr) {
 	free(ptr);
 }
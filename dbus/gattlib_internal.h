@@ -43,27 +43,112 @@ typedef struct {
 	// These attributes are needed to handle incoming events from GLib
 	pthread_t event_thread;
 	GMainLoop *connection_loop;
-	// ID of the timeout to know if we managed to connect to the device
-	guint connection_timeout;
+
+	// References held by the thread of the connection state machines and by gattlib_disconnect()
+	// while it cancels the connection attempt
+	gint ref;
+
+	// Connection establishment. It runs on the thread of the connection state machines.
+	int connection_state;
+	// Outcome of the connection attempt. It arbitrates between the connection state machines and
+	// gattlib_disconnect() cancelling the attempt.
+	gint attempt_state;
+	// Timeout of the current step of the connection establishment
+	GSource* connection_timeout;
+	// Cancel the pending DBus calls of the connection establishment
+	GCancellable* connection_cancellable;
+	gatt_connect_cb_t connect_cb;
+	void* connect_user_data;
+	// Set when the adapter has been opened by gattlib_connect() and must be closed with the connection
+	bool default_adapter;
+	// Address of the device to create it in Bluez when it has not been discovered yet
+	char device_address[18];
+	bool random_address;
+	// Set once we have asked Bluez to create the device (or to discover it)
+	bool device_lookup_done;
+	// Subscription to 'InterfacesAdded' while scanning for the device
+	guint discovery_subscription;
+	// Set when the scan has been started by us. A scan that was already running is left running.
+	bool discovery_started;
+	// Context of the thread of the connection state machines
+	GMainContext* connect_context;
+
+	// Automatic reconnection after the loss of the link (see gattlib_connection_set_reconnect_policy())
+	gattlib_reconnect_policy_t reconnect_policy;
+	unsigned int reconnect_attempt;
+	// Set while org.bluez.Device1.Connect() is pending for a reconnection
+	bool reconnect_call_pending;
+	// Set by gattlib_disconnect() to not reconnect
+	gint disconnecting;
 
 	// List of DBUS Object managed by 'adapter->device_manager'
 	GList *dbus_objects;
 
 	// List of 'OrgBluezGattCharacteristic1*' which has an attached notification
 	GList *notified_characteristics;
+
+	// ATT MTU of the connection. 0 until it has been retrieved from Bluez for the current link
+	uint16_t mtu;
+
+	// Concurrent reads of a same characteristic share a single D-Bus call
+	struct gattlib_read_coalescer* read_coalescer;
+	// Values of the characteristics (see gattlib_connection_set_value_cache())
+	struct gattlib_value_cache* value_cache;
+
+	// Timeout of the GATT operations in milliseconds, -1 for the D-Bus default (see gattlib_connection_set_timeout())
+	gint operation_timeout_ms;
+	// Cancel the GATT operations in progress (see gattlib_connection_cancel()). Protected by 'operation_mutex'.
+	GCancellable* operation_cancellable;
+	GMutex operation_mutex;
+
+	// List of 'struct coalesced_write*' (see gattlib_write_without_response_set_coalescing()).
+	// Protected by 'coalesced_writes_mutex'.
+	GList *coalesced_writes;
+	GMutex coalesced_writes_mutex;
 } gattlib_context_t;
 
+// Device seen during BLE scan. It is indexed by its address in 'ble_scan.discovered_devices'
+// and chained in 'ble_scan.discovered_devices_lru' from the least to the most recently seen.
+struct gattlib_discovered_device {
+	char *address;
+	char *object_path;
+	gint64 last_seen;
+	// Set when the device was neither paired nor connected the last time we saw it
+	bool removable;
+	GList lru_link;
+};
+
 struct gattlib_adapter {
 	GDBusObjectManager *device_manager;
 
 	OrgBluezAdapter1 *adapter_proxy;
 	char* adapter_name;
 
+	// Devices seen by BLE scanning. It is kept after the end of the BLE scan.
+	// Allocated on first use by gattlib_adapter_get_device_registry().
+	struct gattlib_device_registry *device_registry;
+
+	// Bounds of the table of discovered devices (see gattlib_adapter_scan_set_device_table())
+	struct {
+		size_t max_devices;
+		size_t device_timeout;
+		uint32_t flags;
+	} scan_device_table;
+
+	// Batched delivery of discovered devices (see gattlib_adapter_scan_set_batch())
+	struct {
+		gattlib_discovered_devices_t callback;
+		size_t period_ms;
+		size_t max_devices;
+	} scan_batch;
+
 	// Internal attributes only needed during BLE scanning
 	struct {
-		// This list is used to stored discovered devices during BLE scan.
-		// The list is freed when the BLE scanning is completed.
-		GSList *discovered_devices;
+		// This table is used to stored discovered devices during BLE scan.
+		// The table is freed when the BLE scanning is completed.
+		GHashTable *discovered_devices;
+		GQueue discovered_devices_lru;
+		guint device_timeout_id;
 
 		int added_signal_id;
 		int changed_signal_id;
@@ -77,6 +162,10 @@ struct gattlib_adapter {
 		uint32_t enabled_filters;
 		gattlib_discovered_device_t discovered_device_callback;
 		void *discovered_device_user_data;
+
+		// Array of 'gattlib_discovered_device_info_t' waiting to be delivered when batching is enabled
+		GArray *batch;
+		guint batch_timeout_id;
 	} ble_scan;
 };
 
@@ -107,6 +196,18 @@ int get_bluez_device_from_mac(struct gattlib_adapter *adapter, const char *mac_a
 
 struct dbus_characteristic get_characteristic_from_uuid(gatt_connection_t* connection, const uuid_t* uuid);
 
+GCancellable* connection_operation_begin(gattlib_context_t* conn_context, gpointer proxy);
+int connection_operation_error(GError *error);
+
+void free_all_coalesced_writes(gattlib_context_t* conn_context);
+
 void disconnect_all_notifications(gattlib_context_t* conn_context);
+void restore_all_notifications(gattlib_context_t* conn_context);
+
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 40)
+int get_advertisement_data_from_device(OrgBluezDevice1 *bluez_device1,
+		gattlib_advertisement_data_t **advertisement_data, size_t *advertisement_data_count,
+		uint16_t *manufacturer_id, uint8_t **manufacturer_data, size_t *manufacturer_data_size);
+#endif
 
 #endif
@@ -26,33 +26,37 @@ gboolean on_handle_battery_level_property_change(
 {
 	static guint8 percentage;
 	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
 
 	GATTLIB_LOG(GATTLIB_DEBUG, "DBUS: on_handle_battery_level_property_change: changed_properties:%s invalidated_properties:%s",
 			g_variant_print(arg_changed_properties, TRUE),
 			arg_invalidated_properties);
 
-	if (gattlib_has_valid_handler(&connection->notification)) {
-		// Retrieve 'Value' from 'arg_changed_properties'
-		if (g_variant_n_children (arg_changed_properties) > 0) {
-			GVariantIter *iter;
-			const gchar *key;
-			GVariant *value;
+	// Retrieve 'Value' from 'arg_changed_properties'
+	if (g_variant_n_children (arg_changed_properties) > 0) {
+		GVariantIter *iter;
+		const gchar *key;
+		GVariant *value;
+
+		g_variant_get (arg_changed_properties, "a{sv}", &iter);
+		while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
+			if (strcmp(key, "Percentage") == 0) {
+				//TODO: by declaring 'percentage' as a 'static' would mean we could have issue in case of multiple
+				//      GATT connection notifiying to Battery level
+				percentage = g_variant_get_byte(value);
 
-			g_variant_get (arg_changed_properties, "a{sv}", &iter);
-			while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
-				if (strcmp(key, "Percentage") == 0) {
-					//TODO: by declaring 'percentage' as a 'static' would mean we could have issue in case of multiple
-					//      GATT connection notifiying to Battery level
-					percentage = g_variant_get_byte(value);
+				gattlib_value_cache_update(conn_context->value_cache, &m_battery_level_uuid,
+						&percentage, sizeof(percentage));
 
+				if (gattlib_has_valid_handler(&connection->notification)) {
 					gattlib_call_notification_handler(&connection->notification,
 							&m_battery_level_uuid,
 							(const uint8_t*)&percentage, sizeof(percentage));
-					break;
 				}
+				break;
 			}
-			g_variant_iter_free(iter);
 		}
+		g_variant_iter_free(iter);
 	}
 	return TRUE;
 }
@@ -65,42 +69,46 @@ static gboolean on_handle_characteristic_property_change(
 	    gpointer user_data)
 {
 	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
 
-	if (gattlib_has_valid_handler(&connection->notification)) {
-		// Retrieve 'Value' from 'arg_changed_properties'
-		if (g_variant_n_children (arg_changed_properties) > 0) {
-			GVariantIter *iter;
-			const gchar *key = NULL;
-			GVariant *value = NULL;
+	// Retrieve 'Value' from 'arg_changed_properties'
+	if (g_variant_n_children (arg_changed_properties) > 0) {
+		GVariantIter *iter;
+		const gchar *key = NULL;
+		GVariant *value = NULL;
 
-			g_variant_get (arg_changed_properties, "a{sv}", &iter);
-			while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
-				GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_characteristic_property_change: %s:%s",
-						key, g_variant_print(value, TRUE));
+		g_variant_get (arg_changed_properties, "a{sv}", &iter);
+		while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
+			GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_characteristic_property_change: %s:%s",
+					key, g_variant_print(value, TRUE));
 
-				if (strcmp(key, "Value") == 0) {
-					uuid_t uuid;
-					size_t data_length;
-					const uint8_t* data = g_variant_get_fixed_array(value, &data_length, sizeof(guchar));
+			if (strcmp(key, "Value") == 0) {
+				uuid_t uuid;
+				size_t data_length;
+				const uint8_t* data = g_variant_get_fixed_array(value, &data_length, sizeof(guchar));
 
-					gattlib_string_to_uuid(
-							org_bluez_gatt_characteristic1_get_uuid(object),
-							MAX_LEN_UUID_STR + 1,
-							&uuid);
+				gattlib_string_to_uuid(
+						org_bluez_gatt_characteristic1_get_uuid(object),
+						MAX_LEN_UUID_STR + 1,
+						&uuid);
 
+				// The cached value is refreshed even if there is no notification handler
+				gattlib_value_cache_update(conn_context->value_cache, &uuid, data, data_length);
+
+				if (gattlib_has_valid_handler(&connection->notification)) {
 					gattlib_call_notification_handler(&connection->notification,
 							&uuid, data, data_length);
-
-					// As per https://developer.gnome.org/glib/stable/glib-GVariant.html#g-variant-iter-loop, clean up `key` and `value`.
-					g_variant_unref(value);
-					break;
+				} else {
+					GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_characteristic_property_change: not a notification handler");
 				}
-			}
 
-			g_variant_iter_free(iter);
+				// As per https://developer.gnome.org/glib/stable/glib-GVariant.html#g-variant-iter-loop, clean up `key` and `value`.
+				g_variant_unref(value);
+				break;
+			}
 		}
-	} else {
-		GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_characteristic_property_change: not a notification handler");
+
+		g_variant_iter_free(iter);
 	}
 	return TRUE;
 }
@@ -112,38 +120,42 @@ static gboolean on_handle_characteristic_indication(
 	    gpointer user_data)
 {
 	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+
+	// Retrieve 'Value' from 'arg_changed_properties'
+	if (g_variant_n_children (arg_changed_properties) > 0) {
+		GVariantIter *iter;
+		const gchar *key;
+		GVariant *value;
 
-	if (gattlib_has_valid_handler(&connection->indication)) {
-		// Retrieve 'Value' from 'arg_changed_properties'
-		if (g_variant_n_children (arg_changed_properties) > 0) {
-			GVariantIter *iter;
-			const gchar *key;
-			GVariant *value;
+		g_variant_get (arg_changed_properties, "a{sv}", &iter);
+		while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
+			GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_indication_property_change: %s:%s",
+					key, g_variant_print(value, TRUE));
 
-			g_variant_get (arg_changed_properties, "a{sv}", &iter);
-			while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
-				GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_indication_property_change: %s:%s",
-						key, g_variant_print(value, TRUE));
+			if (strcmp(key, "Value") == 0) {
+				uuid_t uuid;
+				size_t data_length;
+				const uint8_t* data = g_variant_get_fixed_array(value, &data_length, sizeof(guchar));
 
-				if (strcmp(key, "Value") == 0) {
-					uuid_t uuid;
-					size_t data_length;
-					const uint8_t* data = g_variant_get_fixed_array(value, &data_length, sizeof(guchar));
+				gattlib_string_to_uuid(
+						org_bluez_gatt_characteristic1_get_uuid(object),
+						MAX_LEN_UUID_STR + 1,
+						&uuid);
 
-					gattlib_string_to_uuid(
-							org_bluez_gatt_characteristic1_get_uuid(object),
-							MAX_LEN_UUID_STR + 1,
-							&uuid);
+				// The cached value is refreshed even if there is no indication handler
+				gattlib_value_cache_update(conn_context->value_cache, &uuid, data, data_length);
 
+				if (gattlib_has_valid_handler(&connection->indication)) {
 					gattlib_call_notification_handler(&connection->indication,
 							&uuid, data, data_length);
-					break;
+				} else {
+					GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_indication_property_change: Not a valid indication handler");
 				}
+				break;
 			}
-			g_variant_iter_free(iter);
 		}
-	} else {
-		GATTLIB_LOG(GATTLIB_DEBUG, "on_handle_indication_property_change: Not a valid indication handler");
+		g_variant_iter_free(iter);
 	}
 	return TRUE;
 }
@@ -194,13 +206,17 @@ static int connect_signal_to_characteristic_uuid(gatt_connection_t* connection,
 	memcpy(&notification_handle->uuid, uuid, sizeof(*uuid));
 	conn_context->notified_characteristics = g_list_append(conn_context->notified_characteristics, notification_handle);
 
+	GCancellable *cancellable = connection_operation_begin(conn_context, dbus_characteristic.gatt);
 	GError *error = NULL;
-	org_bluez_gatt_characteristic1_call_start_notify_sync(dbus_characteristic.gatt, NULL, &error);
+	org_bluez_gatt_characteristic1_call_start_notify_sync(dbus_characteristic.gatt, cancellable, &error);
+	g_object_unref(cancellable);
 
 	if (error) {
+		int ret = connection_operation_error(error);
+
 		GATTLIB_LOG(GATTLIB_ERROR, "Failed to start DBus GATT notification: %s", error->message);
 		g_error_free(error);
-		return GATTLIB_ERROR_DBUS;
+		return ret;
 	} else {
 		return GATTLIB_SUCCESS;
 	}
@@ -227,9 +243,11 @@ static int disconnect_signal_to_characteristic_uuid(gatt_connection_t* connectio
 
 	g_signal_handler_disconnect(notification_handle->gatt, notification_handle->signal_id);
 
+	GCancellable *cancellable = connection_operation_begin(conn_context, notification_handle->gatt);
 	GError *error = NULL;
 	org_bluez_gatt_characteristic1_call_stop_notify_sync(
-			notification_handle->gatt, NULL, &error);
+			notification_handle->gatt, cancellable, &error);
+	g_object_unref(cancellable);
 
 	free(notification_handle);
 
@@ -246,6 +264,244 @@ int gattlib_notification_start(gatt_connection_t* connection, const uuid_t* uuid
 	return connect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_property_change);
 }
 
+struct notification_multiple_request {
+	OrgBluezGattCharacteristic1 *gatt;
+	gattlib_notification_multiple_t* notification;
+	int* pending;
+};
+
+static void on_notification_multiple_started(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+	struct notification_multiple_request* request = user_data;
+	GError *error = NULL;
+
+	org_bluez_gatt_characteristic1_call_start_notify_finish(request->gatt, res, &error);
+	if (error) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to start DBus GATT notification: %s", error->message);
+		request->notification->ret = connection_operation_error(error);
+		g_error_free(error);
+	} else {
+		request->notification->ret = GATTLIB_SUCCESS;
+	}
+
+	(*request->pending)--;
+	free(request);
+}
+
+static bool notification_multiple_match(gattlib_notification_multiple_t* notification, const uuid_t* uuid, int handle) {
+	if (notification->handle != 0) {
+		return notification->handle == handle;
+	} else {
+		return gattlib_uuid_cmp(&notification->uuid, uuid) == 0;
+	}
+}
+
+/*
+ * Resolve all the characteristics in a single pass over the D-Bus objects of the device.
+ * The UUID is read from the object manager cache, a proxy is only created for the requested characteristics.
+ */
+static void get_characteristics_for_notifications(gatt_connection_t* connection,
+		gattlib_notification_multiple_t* notifications, size_t count, struct dbus_characteristic* dbus_characteristics)
+{
+	gattlib_context_t* conn_context = connection->context;
+	GDBusObjectManager *device_manager = get_device_manager_from_adapter(conn_context->adapter);
+	size_t device_path_len = strlen(conn_context->device_object_path);
+	size_t i;
+
+	if (device_manager == NULL) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Gattlib context not initialized.");
+		return;
+	}
+
+	for (GList *l = conn_context->dbus_objects; l != NULL; l = l->next) {
+		GDBusObject *object = l->data;
+		const char* object_path = g_dbus_object_get_object_path(G_DBUS_OBJECT(object));
+		OrgBluezGattCharacteristic1 *characteristic = NULL;
+		GDBusInterface *interface;
+		GVariant *uuid_variant;
+		uuid_t characteristic_uuid;
+		int char_handle = 0;
+
+		// Only consider the objects of this device
+		if ((strncmp(object_path, conn_context->device_object_path, device_path_len) != 0) ||
+		    (object_path[device_path_len] != '/'))
+		{
+#if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
+			if (strcmp(object_path, conn_context->device_object_path) != 0) {
+				continue;
+			}
+
+			interface = g_dbus_object_manager_get_interface(device_manager, object_path, "org.bluez.Battery1");
+			if (interface == NULL) {
+				continue;
+			}
+			g_object_unref(interface);
+
+			for (i = 0; i < count; i++) {
+				if ((dbus_characteristics[i].type != TYPE_NONE) || (notifications[i].handle != 0) ||
+				    (gattlib_uuid_cmp(&notifications[i].uuid, &m_battery_level_uuid) != 0))
+				{
+					continue;
+				}
+
+				dbus_characteristics[i].battery = org_bluez_battery1_proxy_new_for_bus_sync(
+						G_BUS_TYPE_SYSTEM, G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+						"org.bluez", object_path, NULL, NULL);
+				if (dbus_characteristics[i].battery != NULL) {
+					dbus_characteristics[i].type = TYPE_BATTERY_LEVEL;
+				}
+			}
+#endif
+			continue;
+		}
+
+		interface = g_dbus_object_manager_get_interface(device_manager, object_path, "org.bluez.GattCharacteristic1");
+		if (interface == NULL) {
+			continue;
+		}
+
+		uuid_variant = g_dbus_proxy_get_cached_property(G_DBUS_PROXY(interface), "UUID");
+		g_object_unref(interface);
+		if (uuid_variant == NULL) {
+			continue;
+		}
+		gattlib_string_to_uuid(g_variant_get_string(uuid_variant, NULL), MAX_LEN_UUID_STR + 1, &characteristic_uuid);
+		g_variant_unref(uuid_variant);
+
+		// Object path is in the form '/org/bluez/hci0/dev_DE_79_A2_A1_E9_FA/service0024/char0025'.
+		// We convert the last 4 hex characters into the handle
+		sscanf(object_path + strlen(object_path) - 4, "%x", &char_handle);
+
+		for (i = 0; i < count; i++) {
+			if ((dbus_characteristics[i].type != TYPE_NONE) ||
+			    !notification_multiple_match(&notifications[i], &characteristic_uuid, char_handle))
+			{
+				continue;
+			}
+
+			if (characteristic == NULL) {
+				characteristic = org_bluez_gatt_characteristic1_proxy_new_for_bus_sync(
+						G_BUS_TYPE_SYSTEM, G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+						"org.bluez", object_path, NULL, NULL);
+				if (characteristic == NULL) {
+					break;
+				}
+				dbus_characteristics[i].gatt = characteristic;
+			} else {
+				dbus_characteristics[i].gatt = g_object_ref(characteristic);
+			}
+			dbus_characteristics[i].type = TYPE_GATT;
+		}
+	}
+}
+
+int gattlib_notification_start_multiple(gatt_connection_t* connection, gattlib_notification_multiple_t* notifications, size_t count) {
+	gattlib_context_t* conn_context;
+	struct dbus_characteristic* dbus_characteristics;
+	GMainContext *context;
+	int pending = 0;
+	size_t i;
+	int ret;
+
+	if ((connection == NULL) || ((notifications == NULL) && (count > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	dbus_characteristics = calloc(count + 1, sizeof(struct dbus_characteristic));
+	if (dbus_characteristics == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	// The proxies are created before pushing the private main context. Their signals must be
+	// dispatched to the main context of the connection as for gattlib_notification_start().
+	get_characteristics_for_notifications(connection, notifications, count, dbus_characteristics);
+
+	// The completions are dispatched to a private main context to not depend on a running main loop
+	context = g_main_context_new();
+	g_main_context_push_thread_default(context);
+
+	for (i = 0; i < count; i++) {
+		struct gattlib_notification_handle *notification_handle;
+		struct notification_multiple_request* request;
+		GCancellable *cancellable;
+		gulong signal_id;
+
+		if (dbus_characteristics[i].type == TYPE_NONE) {
+			GATTLIB_LOG(GATTLIB_ERROR, "GATT characteristic %d not found", (int)i);
+			notifications[i].ret = GATTLIB_NOT_FOUND;
+			continue;
+		}
+#if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
+		else if (dbus_characteristics[i].type == TYPE_BATTERY_LEVEL) {
+			g_signal_connect(dbus_characteristics[i].battery,
+				"g-properties-changed",
+				G_CALLBACK (on_handle_battery_level_property_change),
+				connection);
+
+			notifications[i].ret = GATTLIB_SUCCESS;
+			continue;
+		}
+#endif
+
+		signal_id = g_signal_connect(dbus_characteristics[i].gatt,
+			"g-properties-changed",
+			G_CALLBACK(on_handle_characteristic_property_change),
+			connection);
+		if (signal_id == 0) {
+			GATTLIB_LOG(GATTLIB_ERROR, "Failed to connect signal to DBus GATT notification");
+			g_object_unref(dbus_characteristics[i].gatt);
+			notifications[i].ret = GATTLIB_ERROR_DBUS;
+			continue;
+		}
+
+		notification_handle = malloc(sizeof(struct gattlib_notification_handle));
+		request = malloc(sizeof(struct notification_multiple_request));
+		if ((notification_handle == NULL) || (request == NULL)) {
+			g_signal_handler_disconnect(dbus_characteristics[i].gatt, signal_id);
+			g_object_unref(dbus_characteristics[i].gatt);
+			free(notification_handle);
+			free(request);
+			notifications[i].ret = GATTLIB_OUT_OF_MEMORY;
+			continue;
+		}
+
+		// Add signal to the list
+		notification_handle->gatt = dbus_characteristics[i].gatt;
+		notification_handle->signal_id = signal_id;
+		gattlib_string_to_uuid(org_bluez_gatt_characteristic1_get_uuid(dbus_characteristics[i].gatt),
+				MAX_LEN_UUID_STR + 1, &notification_handle->uuid);
+		conn_context->notified_characteristics = g_list_append(conn_context->notified_characteristics, notification_handle);
+
+		request->gatt         = dbus_characteristics[i].gatt;
+		request->notification = &notifications[i];
+		request->pending      = &pending;
+		pending++;
+
+		cancellable = connection_operation_begin(conn_context, dbus_characteristics[i].gatt);
+		org_bluez_gatt_characteristic1_call_start_notify(dbus_characteristics[i].gatt, cancellable,
+				on_notification_multiple_started, request);
+		g_object_unref(cancellable);
+	}
+
+	// Wait for completion of the requests
+	while (pending > 0) {
+		g_main_context_iteration(context, TRUE);
+	}
+
+	g_main_context_pop_thread_default(context);
+	g_main_context_unref(context);
+	free(dbus_characteristics);
+
+	ret = GATTLIB_SUCCESS;
+	for (i = 0; i < count; i++) {
+		if (notifications[i].ret != GATTLIB_SUCCESS) {
+			ret = notifications[i].ret;
+			break;
+		}
+	}
+	return ret;
+}
+
 int gattlib_notification_stop(gatt_connection_t* connection, const uuid_t* uuid) {
 	return disconnect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_property_change);
 }
@@ -268,3 +524,23 @@ static void end_notification(void *notified_characteristic) {
 void disconnect_all_notifications(gattlib_context_t* conn_context) {
 	g_list_free_full(g_steal_pointer(&conn_context->notified_characteristics), end_notification);
 }
+
+static void on_notification_restored(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+	OrgBluezGattCharacteristic1 *gatt = ORG_BLUEZ_GATT_CHARACTERISTIC1(source_object);
+	GError *error = NULL;
+
+	org_bluez_gatt_characteristic1_call_start_notify_finish(gatt, res, &error);
+	if (error) {
+		GATTLIB_LOG(GATTLIB_ERROR, "Failed to restore DBus GATT notification: %s", error->message);
+		g_error_free(error);
+	}
+}
+
+void restore_all_notifications(gattlib_context_t* conn_context) {
+	// Issue all the requests at once rather than waiting for each reply
+	for (GList *l = conn_context->notified_characteristics; l != NULL; l = l->next) {
+		struct gattlib_notification_handle *notification_handle = l->data;
+
+		org_bluez_gatt_characteristic1_call_start_notify(notification_handle->gatt, NULL, on_notification_restored, NULL);
+	}
+}
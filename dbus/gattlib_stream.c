@@ -64,6 +64,9 @@ int gattlib_write_char_by_uuid_stream_open(gatt_connection_t* connection, uuid_t
 	// We abuse the pointer 'stream' to pass the 'File Descriptor'
 	*stream = (gatt_stream_t*)(unsigned long)fd;
 
+	// Keep the MTU for gattlib_get_mtu()
+	((gattlib_context_t*)connection->context)->mtu = *mtu;
+
 	return GATTLIB_SUCCESS;
 }
 
@@ -70,6 +70,21 @@ class GattlibAdvertisementData(Structure):
                 ("data_length", c_size_t)]
 
 
+# typedef struct {
+#     char    name[16];
+#     char    address[18];
+#     uint8_t powered;
+# } gattlib_adapter_info_t;
+class GattlibAdapterInfo(Structure):
+    _fields_ = [("name", c_char * 16),
+                ("address", c_char * 18),
+                ("powered", c_uint8)]
+
+
+# int gattlib_adapter_list(gattlib_adapter_info_t **adapters, size_t *adapters_count);
+gattlib_adapter_list = gattlib.gattlib_adapter_list
+gattlib_adapter_list.argtypes = [POINTER(POINTER(GattlibAdapterInfo)), POINTER(c_size_t)]
+
 # int gattlib_adapter_open(const char* adapter_name, void** adapter);
 gattlib_adapter_open = gattlib.gattlib_adapter_open
 gattlib_adapter_open.argtypes = [c_char_p, POINTER(c_void_p)]
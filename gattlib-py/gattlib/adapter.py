@@ -49,8 +49,17 @@ class Adapter:
 
     @staticmethod
     def list():
-        # TODO: Add support
-        return []
+        _adapters = POINTER(GattlibAdapterInfo)()
+        _adapters_count = c_size_t(0)
+        ret = gattlib_adapter_list(byref(_adapters), byref(_adapters_count))
+        handle_return(ret)
+
+        adapters = []
+        for i in range(0, _adapters_count.value):
+            adapters.append(Adapter(_adapters[i].name))
+
+        gattlib_characteristic_free_value(_adapters)
+        return adapters
 
     def open(self):
         ret = gattlib_adapter_open(self._name, byref(self._adapter))
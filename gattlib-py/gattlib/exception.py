@@ -11,6 +11,8 @@ GATTLIB_OUT_OF_MEMORY = 3
 GATTLIB_NOT_SUPPORTED = 4
 GATTLIB_DEVICE_ERROR = 5
 GATTLIB_ERROR_DBUS = 6
+GATTLIB_TIMEOUT = 9
+GATTLIB_CANCELLED = 10
 
 
 class GattlibException(Exception):
@@ -45,6 +47,14 @@ class DBusError(GattlibException):
     pass
 
 
+class Timeout(GattlibException):
+    pass
+
+
+class Cancelled(GattlibException):
+    pass
+
+
 def handle_return(ret):
     if ret == GATTLIB_INVALID_PARAMETER:
         raise InvalidParameter()
@@ -58,6 +68,10 @@ def handle_return(ret):
         raise DeviceError()
     elif ret == GATTLIB_ERROR_DBUS:
         raise DBusError()
+    elif ret == GATTLIB_TIMEOUT:
+        raise Timeout()
+    elif ret == GATTLIB_CANCELLED:
+        raise Cancelled()
     elif ret == -22: # From '-EINVAL'
         raise ValueError("Gattlib value error")
     elif ret != 0:
@@ -12,6 +12,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <sys/uio.h>
 
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/sdp.h>
@@ -44,6 +45,8 @@ extern "C" {
 #define GATTLIB_ERROR_DBUS          6
 #define GATTLIB_ERROR_BLUEZ         7
 #define GATTLIB_ERROR_INTERNAL      8
+#define GATTLIB_TIMEOUT             9
+#define GATTLIB_CANCELLED           10
 //@}
 
 /**
@@ -75,11 +78,22 @@ extern "C" {
 #define GATTLIB_CONNECTION_OPTIONS_LEGACY_BT_SEC_LOW        (1 << 2)
 #define GATTLIB_CONNECTION_OPTIONS_LEGACY_BT_SEC_MEDIUM     (1 << 3)
 #define GATTLIB_CONNECTION_OPTIONS_LEGACY_BT_SEC_HIGH       (1 << 4)
+#define GATTLIB_CONNECTION_OPTIONS_LEGACY_EATT_BEARERS(value) (((value) & 0x7) << 5) //< Number of Enhanced ATT bearers on 3 bits (up to 7)
+#define GATTLIB_CONNECTION_OPTIONS_LEGACY_EVENT_LOOP(value) ((((value) + 1) & 0x7) << 8) //< Event loop to assign the connection to (from 0 to 6)
 #define GATTLIB_CONNECTION_OPTIONS_LEGACY_PSM(value)        (((value) & 0x3FF) << 11) //< We encode PSM on 10 bits (up to 1023)
 #define GATTLIB_CONNECTION_OPTIONS_LEGACY_MTU(value)        (((value) & 0x3FF) << 21) //< We encode MTU on 10 bits (up to 1023)
 
-#define GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_PSM(options)  (((options) >> 11) && 0x3FF)
-#define GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_MTU(options)  (((options) >> 21) && 0x3FF)
+#define GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_PSM(options)  (((options) >> 11) & 0x3FF)
+#define GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_MTU(options)  (((options) >> 21) & 0x3FF)
+#define GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_EATT_BEARERS(options) (((options) >> 5) & 0x7)
+#define GATTLIB_CONNECTION_OPTIONS_LEGACY_GET_EVENT_LOOP(options) ((int)(((options) >> 8) & 0x7) - 1)
+
+/// ATT MTU requested at connection when GATTLIB_CONNECTION_OPTIONS_LEGACY_MTU() is not set.
+/// It allows 244 bytes of payload per ATT PDU, that fits in a single LE Data Length Extension packet.
+#define GATTLIB_DEFAULT_ATT_MTU                             247
+
+/// Time in seconds given to a connection attempt when gattlib_set_connection_attempt_timeout() has not been called.
+#define GATTLIB_DEFAULT_CONNECTION_ATTEMPT_TIMEOUT          6
 
 #define GATTLIB_CONNECTION_OPTIONS_LEGACY_DEFAULT \
 		GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_PUBLIC | \
@@ -87,6 +101,35 @@ extern "C" {
 		GATTLIB_CONNECTION_OPTIONS_LEGACY_BT_SEC_LOW
 //@}
 
+/**
+ * @name Connection parameter profiles for gattlib_connection_set_profile()
+ */
+//@{
+#define GATTLIB_CONNECTION_PROFILE_LOW_LATENCY              0 ///< 7.5ms to 11.25ms interval, no slave latency, 1s supervision timeout. Minimizes the latency of the requests
+#define GATTLIB_CONNECTION_PROFILE_HIGH_THROUGHPUT          1 ///< 7.5ms interval, no slave latency, 2s supervision timeout. For bulk transfers
+#define GATTLIB_CONNECTION_PROFILE_BALANCED                 2 ///< 30ms to 50ms interval, no slave latency, 4.2s supervision timeout. Trade-off between latency and power
+#define GATTLIB_CONNECTION_PROFILE_POWER_SAVING             3 ///< 100ms to 200ms interval, slave latency of 4, 6s supervision timeout. For idle links
+//@}
+
+/**
+ * @name LE PHYs reported by gattlib_get_link_info()
+ */
+//@{
+#define GATTLIB_PHY_1M                                      1
+#define GATTLIB_PHY_2M                                      2
+#define GATTLIB_PHY_CODED                                   3
+//@}
+
+/**
+ * @name LE PHY masks for gattlib_connection_set_phy()
+ */
+//@{
+#define GATTLIB_PHY_MASK_1M                                 (1 << 0)
+#define GATTLIB_PHY_MASK_2M                                 (1 << 1)
+#define GATTLIB_PHY_MASK_CODED                              (1 << 2)
+#define GATTLIB_PHY_MASK_ALL                                (GATTLIB_PHY_MASK_1M | GATTLIB_PHY_MASK_2M | GATTLIB_PHY_MASK_CODED)
+//@}
+
 /**
  * @name Discover filter
  */
@@ -97,6 +140,29 @@ extern "C" {
 #define GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE               (1 << 2)
 //@}
 
+/**
+ * @name Bluetooth LE address types
+ */
+//@{
+#define GATTLIB_ADDRESS_TYPE_PUBLIC                         0x00
+#define GATTLIB_ADDRESS_TYPE_RANDOM                         0x01
+//@}
+
+/**
+ * @name Scan types for gattlib_adapter_scan_set_parameters()
+ */
+//@{
+#define GATTLIB_SCAN_TYPE_PASSIVE                           0x00 ///< Only listen to advertisements
+#define GATTLIB_SCAN_TYPE_ACTIVE                            0x01 ///< Also send scan requests to get scan responses
+//@}
+
+/**
+ * @name Options for gattlib_adapter_scan_set_device_table()
+ */
+//@{
+#define GATTLIB_SCAN_DEVICE_TABLE_REMOVE_EVICTED            (1 << 0) ///< Ask Bluez to remove the evicted devices that are neither paired nor connected
+//@}
+
 /**
  * @name Gattlib Eddystone types
  */
@@ -128,6 +194,9 @@ extern "C" {
 
 typedef struct _gatt_connection_t gatt_connection_t;
 typedef struct _gatt_stream_t gatt_stream_t;
+typedef struct _gattlib_l2cap_channel_t gattlib_l2cap_channel_t;
+typedef struct _gattlib_scheduler_t gattlib_scheduler_t;
+typedef struct _gattlib_adapter_group_t gattlib_adapter_group_t;
 
 /**
  * Structure to represent a GATT Service and its data in the BLE advertisement packet
@@ -138,6 +207,38 @@ typedef struct {
 	size_t   data_length;  /**< Length of data attached to the GATT Service */
 } gattlib_advertisement_data_t;
 
+/**
+ * @name Limits of the data stored by the device registry
+ */
+//@{
+#define GATTLIB_ADVERTISEMENT_DATA_MAX_LEN                  31 ///< Maximum length of an advertisement payload
+#define GATTLIB_DEVICE_RECORD_MAX_SERVICE_DATA              4
+#define GATTLIB_DEVICE_REGISTRY_DEFAULT_MAX_DEVICES         1024 ///< Default maximum number of devices in the registry
+//@}
+
+/**
+ * Structure to represent a device in the registry filled by Bluetooth scanning.
+ * Payloads longer than `GATTLIB_ADVERTISEMENT_DATA_MAX_LEN` are truncated.
+ */
+typedef struct {
+	uint8_t  address[6];        /**< MAC address of the device (most significant byte first) */
+	int64_t  last_seen;         /**< Monotonic time (CLOCK_MONOTONIC) in microseconds when the device was last seen */
+	int16_t  rssi;              /**< Smoothed RSSI. 0 if the RSSI has never been reported. */
+	int16_t  last_rssi;         /**< Last reported RSSI */
+	uint32_t observation_count; /**< Number of times the device has been seen */
+
+	uint16_t manufacturer_id;                                         /**< ID of the Manufacturer */
+	uint8_t  manufacturer_data[GATTLIB_ADVERTISEMENT_DATA_MAX_LEN];   /**< Data following Manufacturer ID */
+	size_t   manufacturer_data_length;                                /**< Length of manufacturer_data */
+
+	size_t   service_data_count;                                      /**< Number of elements in service_data */
+	struct {
+		uuid_t   uuid;                                            /**< UUID of the GATT Service */
+		uint8_t  data[GATTLIB_ADVERTISEMENT_DATA_MAX_LEN];        /**< Data attached to the GATT Service */
+		size_t   data_length;                                     /**< Length of data */
+	} service_data[GATTLIB_DEVICE_RECORD_MAX_SERVICE_DATA];
+} gattlib_device_record_t;
+
 typedef void (*gattlib_event_handler_t)(const uuid_t* uuid, const uint8_t* data, size_t data_length, void* user_data);
 
 /**
@@ -158,6 +259,24 @@ typedef void (*gattlib_disconnection_handler_t)(void* user_data);
  */
 typedef void (*gattlib_discovered_device_t)(void *adapter, const char* addr, const char* name, void *user_data);
 
+/**
+ * Structure to represent a BLE device discovered by Bluetooth scanning
+ */
+typedef struct {
+	const char* addr;  /**< MAC address of the BLE device */
+	const char* name;  /**< Name of BLE device if advertised, NULL otherwise */
+} gattlib_discovered_device_info_t;
+
+/**
+ * @brief Handler called with a batch of discovered BLE devices
+ *
+ * @param adapter is the adapter that has found the BLE devices
+ * @param devices is the array of discovered BLE devices. It is only valid during the call.
+ * @param devices_count is the number of elements in the devices array
+ * @param user_data  Data defined when enabling Bluetooth scanning
+ */
+typedef void (*gattlib_discovered_devices_t)(void *adapter, const gattlib_discovered_device_info_t *devices, size_t devices_count, void *user_data);
+
 /**
  * @brief Handler called on new discovered BLE device
  *
@@ -176,6 +295,73 @@ typedef void (*gattlib_discovered_device_with_data_t)(void *adapter, const char*
 		uint16_t manufacturer_id, uint8_t *manufacturer_data, size_t manufacturer_data_size,
 		void *user_data);
 
+/**
+ * @brief Handler called for each device of the registry by gattlib_device_registry_foreach()
+ *
+ * @param adapter is the adapter the device has been seen
+ * @param record is the device record. It is only valid during the call.
+ * @param user_data  Data defined when calling `gattlib_device_registry_foreach()`
+ */
+typedef void (*gattlib_device_record_cb_t)(void *adapter, const gattlib_device_record_t *record, void *user_data);
+
+/**
+ * @name Bits of the event type of an advertising report
+ *
+ * They follow the Event_Type of the HCI LE Extended Advertising Report event.
+ * Legacy advertising reports are converted into this format.
+ */
+//@{
+#define GATTLIB_ADVERTISING_REPORT_CONNECTABLE              (1 << 0)
+#define GATTLIB_ADVERTISING_REPORT_SCANNABLE                (1 << 1)
+#define GATTLIB_ADVERTISING_REPORT_DIRECTED                 (1 << 2)
+#define GATTLIB_ADVERTISING_REPORT_SCAN_RESPONSE            (1 << 3)
+#define GATTLIB_ADVERTISING_REPORT_LEGACY                   (1 << 4)
+#define GATTLIB_ADVERTISING_REPORT_DATA_STATUS_MASK         (3 << 5) ///< 0 when the data is complete
+//@}
+
+#define GATTLIB_ADVERTISING_REPORT_TX_POWER_UNKNOWN         127
+
+/**
+ * Structure to represent a raw advertising report received by Bluetooth scanning
+ */
+typedef struct {
+	uint8_t        addr[6];      /**< MAC address of the BLE device (most significant byte first) */
+	uint8_t        addr_type;    /**< Address type as defined by HCI (0: Public, 1: Random, ...) */
+	uint16_t       event_type;   /**< Combination of `GATTLIB_ADVERTISING_REPORT_*` bits */
+	int8_t         rssi;         /**< RSSI in dBm. 127 if not available */
+	int8_t         tx_power;     /**< TX Power in dBm. GATTLIB_ADVERTISING_REPORT_TX_POWER_UNKNOWN if not available */
+	const uint8_t* data;         /**< Advertising data */
+	size_t         data_length;  /**< Length of the advertising data */
+} gattlib_advertising_report_t;
+
+/**
+ * @brief Handler called for each advertising report received by Bluetooth scanning
+ *
+ * @param adapter is the adapter that has received the advertising report
+ * @param report is the advertising report. It is only valid during the call.
+ * @param user_data  Data defined when calling `gattlib_adapter_scan_enable_with_reports()`
+ */
+typedef void (*gattlib_advertising_report_cb_t)(void *adapter, const gattlib_advertising_report_t *report, void *user_data);
+
+/**
+ * Structure to represent the parameters of Bluetooth scanning
+ */
+typedef struct {
+	uint8_t  scan_type;          /**< GATTLIB_SCAN_TYPE_PASSIVE or GATTLIB_SCAN_TYPE_ACTIVE */
+	uint16_t interval;           /**< Scan interval in units of 0.625 ms (from 0x0004 to 0x4000) */
+	uint16_t window;             /**< Scan window in units of 0.625 ms. It must not be greater than interval */
+	uint8_t  filter_duplicates;  /**< If not 0, the controller filters duplicate advertising reports */
+	uint8_t  use_accept_list;    /**< If not 0, only the devices of the accept list are reported. See gattlib_adapter_scan_set_accept_list() */
+} gattlib_scan_parameters_t;
+
+/**
+ * Structure to represent an entry of the controller accept list
+ */
+typedef struct {
+	const char* addr;       /**< MAC address of the BLE device */
+	uint8_t     addr_type;  /**< GATTLIB_ADDRESS_TYPE_PUBLIC or GATTLIB_ADDRESS_TYPE_RANDOM */
+} gattlib_accept_list_entry_t;
+
 /**
  * @brief Handler called on asynchronous connection when connection is ready
  *
@@ -205,6 +391,25 @@ extern const uuid_t gattlib_eddystone_common_data_uuid;
 extern const char *gattlib_eddystone_url_scheme_prefix[];
 
 
+/**
+ * Structure to describe a Bluetooth adapter of the system
+ */
+typedef struct {
+	char    name[16];    /**< Name of the adapter to pass to gattlib_adapter_open() (eg: 'hci0') */
+	char    address[18]; /**< MAC address of the adapter */
+	uint8_t powered;     /**< Not 0 if the adapter is up */
+} gattlib_adapter_info_t;
+
+/**
+ * @brief List the Bluetooth adapters of the system
+ *
+ * @param adapters is the array of adapters. It must be freed by the caller with free().
+ * @param adapters_count is the number of adapters
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_list(gattlib_adapter_info_t **adapters, size_t *adapters_count);
+
 /**
  * @brief Open Bluetooth adapter
  *
@@ -227,6 +432,21 @@ int gattlib_adapter_open(const char* adapter_name, void** adapter);
  */
 int gattlib_adapter_scan_enable(void* adapter, gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data);
 
+/**
+ * @brief Enable Bluetooth scanning on a given adapter and report every advertising report
+ *
+ * Contrary to gattlib_adapter_scan_enable(), the MAC address is given in binary form and the
+ * advertising data is not parsed. No memory is allocated per report.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param advertising_report_cb is the function callback called for each advertising report
+ * @param timeout defines the duration of the Bluetooth scanning. When timeout=0, we scan indefinitely.
+ * @param user_data is the data passed to the callback `advertising_report_cb()`
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_scan_enable_with_reports(void* adapter, gattlib_advertising_report_cb_t advertising_report_cb, size_t timeout, void *user_data);
+
 /**
  * @brief Enable Bluetooth scanning on a given adapter
  *
@@ -284,6 +504,73 @@ int gattlib_adapter_scan_enable_with_filter_non_blocking(void *adapter, uuid_t *
 int gattlib_adapter_scan_eddystone(void *adapter, int16_t rssi_threshold, uint32_t eddystone_types,
 		gattlib_discovered_device_with_data_t discovered_device_cb, size_t timeout, void *user_data);
 
+/**
+ * @brief Bound the table of devices tracked by Bluetooth scanning on a given adapter
+ *
+ * The table is used to only notify new devices. When the table is full, the least recently seen
+ * device is evicted. A device that has not been seen for `device_timeout` seconds is also evicted.
+ * An evicted device is reported again by the scan callback if it is seen again.
+ *
+ * @note This function must be called before enabling the scan
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param max_devices is the maximum number of devices in the table. When max_devices=0, the table is unbounded.
+ * @param device_timeout is the number of seconds before an idle device is evicted. When device_timeout=0, devices are never evicted on timeout.
+ * @param flags defines the eviction policy. The flags are defined by the macros `GATTLIB_SCAN_DEVICE_TABLE_*`.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_scan_set_device_table(void *adapter, size_t max_devices, size_t device_timeout, uint32_t flags);
+
+/**
+ * @brief Deliver the devices discovered by Bluetooth scanning in batches
+ *
+ * Discovered devices are gathered and `discovered_devices_cb` is called every `batch_period_ms`
+ * milliseconds or as soon as `batch_max_devices` devices have been gathered. The remaining devices
+ * are delivered when the scan completes. While batching is enabled, the callback passed to
+ * gattlib_adapter_scan_enable*() is not called and can be NULL.
+ *
+ * @note This function must be called before enabling the scan
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param discovered_devices_cb is the function callback called for each batch. With value NULL, batching is disabled.
+ * @param batch_period_ms is the maximum delay in milliseconds before delivering a discovered device. When batch_period_ms=0, there is no delay limit.
+ * @param batch_max_devices is the maximum number of devices in a batch. When batch_max_devices=0, there is no size limit.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_scan_set_batch(void *adapter, gattlib_discovered_devices_t discovered_devices_cb,
+		size_t batch_period_ms, size_t batch_max_devices);
+
+/**
+ * @brief Set the parameters used by Bluetooth scanning on a given adapter
+ *
+ * @note This function must be called before enabling the scan
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param parameters are the scan parameters. With value NULL, the default parameters are restored.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_scan_set_parameters(void *adapter, const gattlib_scan_parameters_t *parameters);
+
+/**
+ * @brief Load the accept list of the Bluetooth controller
+ *
+ * The previous content of the accept list is cleared. The accept list is used by Bluetooth scanning
+ * when `use_accept_list` is set in the scan parameters. The filtering is then done by the controller.
+ *
+ * @note The accept list cannot be changed while scanning
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param entries is the array of devices to accept
+ * @param entries_count is the number of elements in the entries array. With value 0, the accept list is only cleared.
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_INVALID_PARAMETER if an entry is invalid (the accept list is then
+ *         left unchanged) or GATTLIB_* error code (the accept list is then left empty)
+ */
+int gattlib_adapter_scan_set_accept_list(void *adapter, const gattlib_accept_list_entry_t *entries, size_t entries_count);
+
 /**
  * @brief Disable Bluetooth scanning on a given adapter
  *
@@ -302,9 +589,115 @@ int gattlib_adapter_scan_disable(void* adapter);
  */
 int gattlib_adapter_close(void* adapter);
 
+/**
+ * @brief Open a group of adapters to spread the scans and the connections over several radios
+ *
+ * The connections are opened on the adapter of the group that has the fewest connections. Scans run on
+ * the adapters that have the fewest connections. An adapter that disappears or goes down (eg: after a reset)
+ * is skipped until it is back.
+ *
+ * @param adapter_names are the names of the adapters of the group. With value NULL, all the adapters of the system are used.
+ * @param adapters_count is the number of names in `adapter_names`
+ * @param group is the opened group
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_group_open(const char **adapter_names, size_t adapters_count, gattlib_adapter_group_t **group);
+
+/**
+ * @brief Connect a device with the least loaded adapter of a group
+ *
+ * If the adapter has gone down, the connection is attempted again with the next least loaded adapter.
+ *
+ * @param group is the group opened with gattlib_adapter_group_open()
+ * @param dst is the MAC address of the device
+ * @param options are the options to connect to the device. See `GATTLIB_CONNECTION_OPTIONS_*`
+ *
+ * @return the connection or NULL on error
+ */
+gatt_connection_t *gattlib_adapter_group_connect(gattlib_adapter_group_t *group, const char *dst, unsigned long options);
+
+/**
+ * @brief Disconnect a device connected with gattlib_adapter_group_connect()
+ *
+ * @param group is the group opened with gattlib_adapter_group_open()
+ * @param connection is the connection to close
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_group_disconnect(gattlib_adapter_group_t *group, gatt_connection_t *connection);
+
+/**
+ * @brief Scan for devices with the least loaded adapters of a group
+ *
+ * This function blocks until the timeout has expired or gattlib_adapter_group_scan_disable() has been called.
+ * The calls to `discovered_device_cb` are serialized. A device can be reported by several adapters.
+ *
+ * @param group is the group opened with gattlib_adapter_group_open()
+ * @param discovered_device_cb is the function called for each discovered device
+ * @param timeout defines the duration of the Bluetooth scanning. When timeout=0, we scan indefinitely.
+ * @param user_data is the data passed to the callback `discovered_device_cb()`
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_group_scan_enable(gattlib_adapter_group_t *group, gattlib_discovered_device_t discovered_device_cb,
+		size_t timeout, void *user_data);
+
+/**
+ * @brief Stop the scan started with gattlib_adapter_group_scan_enable()
+ *
+ * @param group is the group opened with gattlib_adapter_group_open()
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_group_scan_disable(gattlib_adapter_group_t *group);
+
+/**
+ * @brief Close a group of adapters
+ *
+ * The connections opened with the group must have been disconnected before.
+ *
+ * @param group is the group to close
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_group_close(gattlib_adapter_group_t *group);
+
+/**
+ * @brief Function to set the number of threads running the events of the GATT connections
+ *
+ * New connections are assigned to the event loop with the fewest connections, unless
+ * `GATTLIB_CONNECTION_OPTIONS_LEGACY_EVENT_LOOP()` is set. Connections that are already established
+ * keep their event loop.
+ *
+ * @note This function is only supported before Bluez v5.42 (prior to D-BUS support)
+ *
+ * @param count is the number of event loop threads (default: 1)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_set_event_loop_count(unsigned int count);
+
+/**
+ * @brief Function to set the time given to the connection attempts
+ *
+ * The timeout bounds the whole connection attempt: the connection of the socket, the ATT MTU exchange,
+ * the discovery and the opening of the Enhanced ATT bearers. It applies to the attempts started afterwards.
+ *
+ * @note This function is only supported before Bluez v5.42 (prior to D-BUS support)
+ *
+ * @param timeout_s is the timeout in seconds (default: `GATTLIB_DEFAULT_CONNECTION_ATTEMPT_TIMEOUT`)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_set_connection_attempt_timeout(unsigned int timeout_s);
+
 /**
  * @brief Function to connect to a BLE device
  *
+ * The device does not need to be scanned first. If Bluez does not know it yet, it is created and connected
+ * with org.bluez.Adapter1.ConnectDevice() or, when this method is not available, found by a short scan.
+ *
  * @param adapter	Local Adaptater interface. When passing NULL, we use default adapter.
  * @param dst		Remote Bluetooth address
  * @param options	Options to connect to BLE device. See `GATTLIB_CONNECTION_OPTIONS_*`
@@ -314,12 +707,23 @@ gatt_connection_t *gattlib_connect(void *adapter, const char *dst, unsigned long
 /**
  * @brief Function to asynchronously connect to a BLE device
  *
- * @note This function is mainly used before Bluez v5.42 (prior to D-BUS support)
+ * The function returns as soon as the connection attempt is started. Many attempts can be
+ * in progress at the same time. Each attempt is bounded by its own timeout.
+ *
+ * The attempt is cancelled by calling gattlib_disconnect() on the returned connection before the callback
+ * has been called. The callback is then not called.
+ *
+ * The callback and the disconnection handler of the connection can call gattlib_connect(),
+ * gattlib_connect_async() and gattlib_disconnect().
+ *
+ * @note Cancelling a connection attempt is only supported with D-BUS support (Bluez v5.42+)
  *
  * @param adapter	Local Adaptater interface. When passing NULL, we use default adapter.
  * @param dst		Remote Bluetooth address
  * @param options	Options to connect to BLE device. See `GATTLIB_CONNECTION_OPTIONS_*`
- * @param connect_cb is the callback to call when the connection is established
+ * @param connect_cb is the callback to call when the connection is established. It receives NULL
+ *                   when the attempt failed; the connection returned by this function must not be used
+ *                   once the callback has returned.
  * @param user_data is the user specific data to pass to the callback
  */
 gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
@@ -329,12 +733,185 @@ gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
 /**
  * @brief Function to disconnect the GATT connection
  *
+ * It also cancels a connection attempt of gattlib_connect_async() that is still in progress.
+ *
  * @param connection Active GATT connection
  *
  * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
  */
 int gattlib_disconnect(gatt_connection_t* connection);
 
+/**
+ * Policy of the automatic reconnection after the loss of the link
+ */
+typedef struct {
+	unsigned int max_attempts;     /**< Largest number of reconnection attempts (0 disables the automatic reconnection) */
+	unsigned int initial_delay_ms; /**< Delay before the first attempt. It doubles after each failed attempt. */
+	unsigned int max_delay_ms;     /**< Upper bound of the delay between two attempts */
+	unsigned int jitter_percent;   /**< Random variation of each delay (from 0 to 100%) to not reconnect many devices at once */
+} gattlib_reconnect_policy_t;
+
+/**
+ * @brief Reconnect the device automatically when the link is lost
+ *
+ * On reconnection, the discovered GATT attributes are reused and the notifications and indications
+ * that were enabled are enabled again. The disconnection handler is only called once all the attempts have failed.
+ *
+ * @note This function is not supported before Bluez v5.42 (prior to D-BUS support)
+ *
+ * @param connection Active GATT connection
+ * @param policy is the reconnection policy. NULL disables the automatic reconnection.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_connection_set_reconnect_policy(gatt_connection_t* connection, const gattlib_reconnect_policy_t *policy);
+
+/**
+ * @brief Bound the duration of the GATT operations of a connection
+ *
+ * It applies to the read, write and notification functions. An operation that has not completed
+ * before the timeout returns GATTLIB_TIMEOUT. With Bluez prior to v5.42, only the reads of discovered
+ * characteristics, the writes (including the long writes), gattlib_read_multiple() and
+ * gattlib_notification_start()/gattlib_notification_start_multiple()/gattlib_notification_stop()
+ * are bounded. Discovery waits for the remote device.
+ *
+ * @param connection Active GATT connection
+ * @param timeout_ms is the largest duration of an operation. 0 restores the default of the Bluetooth stack.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_connection_set_timeout(gatt_connection_t* connection, unsigned int timeout_ms);
+
+/**
+ * @brief Cancel the GATT operations in progress on a connection
+ *
+ * The operations waiting for the remote device return GATTLIB_CANCELLED. The operations started
+ * after this call are not affected. This function can be called from any thread.
+ *
+ * @param connection Active GATT connection
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_connection_cancel(gatt_connection_t* connection);
+
+/**
+ * @brief Serve the reads of a connection from a cache of the characteristic values
+ *
+ * A value read with gattlib_read_char_by_uuid() is returned again without any request to the device
+ * until it is older than `ttl_ms`. The notifications and indications received on the connection
+ * refresh the cached values. The writes to a characteristic drop its cached value.
+ *
+ * @param connection Active GATT connection
+ * @param ttl_ms is the lifetime of a cached value. 0 disables the cache (default) and drops the cached values.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_connection_set_value_cache(gatt_connection_t* connection, unsigned int ttl_ms);
+
+/**
+ * @brief Function to retrieve the ATT MTU of a GATT connection
+ *
+ * The ATT MTU is negotiated when the connection is established. With Bluez prior to v5.42,
+ * the requested MTU is set with `GATTLIB_CONNECTION_OPTIONS_LEGACY_MTU()` (default: `GATTLIB_DEFAULT_ATT_MTU`).
+ * With D-BUS support, Bluez negotiates the MTU itself. Bluez prior to v5.62 does not expose it:
+ * it is then only known once `gattlib_write_char_by_uuid_stream_open()` has succeeded on the connection,
+ * otherwise GATTLIB_NOT_SUPPORTED is returned.
+ *
+ * @note The largest payload of a write or notification is `mtu - 3` bytes
+ *
+ * @param connection Active GATT connection
+ * @param mtu is the effective ATT MTU of the connection
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_get_mtu(gatt_connection_t* connection, uint16_t *mtu);
+
+/**
+ * Structure to represent the parameters of a LE connection
+ */
+typedef struct {
+	uint16_t min_interval;         /**< Minimum connection interval in units of 1.25 ms (from 0x0006 to 0x0C80) */
+	uint16_t max_interval;         /**< Maximum connection interval in units of 1.25 ms (from 0x0006 to 0x0C80) */
+	uint16_t latency;              /**< Slave latency in number of connection events (from 0x0000 to 0x01F3) */
+	uint16_t supervision_timeout;  /**< Supervision timeout in units of 10 ms (from 0x000A to 0x0C80) */
+} gattlib_connection_parameters_t;
+
+/**
+ * @brief Function to request new parameters for a GATT connection
+ *
+ * @note With Bluez prior to v5.42, the request is sent to the controller through a raw HCI socket
+ *       that requires the CAP_NET_RAW capability.
+ *
+ * @param connection Active GATT connection
+ * @param parameters are the requested connection parameters
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_connection_set_parameters(gatt_connection_t* connection, const gattlib_connection_parameters_t *parameters);
+
+/**
+ * @brief Function to request a predefined set of parameters for a GATT connection
+ *
+ * @param connection Active GATT connection
+ * @param profile is one of the `GATTLIB_CONNECTION_PROFILE_*` profiles
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_connection_set_profile(gatt_connection_t* connection, int profile);
+
+/**
+ * Structure to represent the Link Layer settings of a LE connection
+ */
+typedef struct {
+	uint16_t max_tx_octets;        /**< Maximum number of payload octets sent in a Link Layer packet */
+	uint16_t max_tx_time;          /**< Maximum time in microseconds to send a Link Layer packet */
+	uint16_t max_rx_octets;        /**< Maximum number of payload octets received in a Link Layer packet */
+	uint16_t max_rx_time;          /**< Maximum time in microseconds to receive a Link Layer packet */
+	uint8_t  tx_phy;               /**< PHY used to transmit (`GATTLIB_PHY_*`) */
+	uint8_t  rx_phy;               /**< PHY used to receive (`GATTLIB_PHY_*`) */
+} gattlib_link_info_t;
+
+/**
+ * @brief Function to request the LE Data Length Extension on a GATT connection
+ *
+ * Larger Link Layer packets let an ATT PDU fit in a single packet instead of being fragmented
+ * into 27-byte packets. The controller negotiates the effective values with the remote device.
+ *
+ * @note With Bluez prior to v5.42, the request is sent to the controller through a raw HCI socket
+ *       that requires the CAP_NET_RAW capability.
+ *
+ * @param connection Active GATT connection
+ * @param tx_octets is the preferred maximum number of payload octets (from 27 to 251)
+ * @param tx_time is the preferred maximum transmission time in microseconds (from 328 to 17040)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_connection_set_data_length(gatt_connection_t* connection, uint16_t tx_octets, uint16_t tx_time);
+
+/**
+ * @brief Function to request the PHYs used by a GATT connection
+ *
+ * @param connection Active GATT connection
+ * @param tx_phys is the mask of the preferred PHYs to transmit (`GATTLIB_PHY_MASK_*`)
+ * @param rx_phys is the mask of the preferred PHYs to receive (`GATTLIB_PHY_MASK_*`)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_connection_set_phy(gatt_connection_t* connection, uint8_t tx_phys, uint8_t rx_phys);
+
+/**
+ * @brief Function to retrieve the Link Layer settings of a GATT connection
+ *
+ * The settings are the ones last reported by the controller. They are the Bluetooth defaults
+ * (27 octets, 1M PHY) until gattlib_connection_set_data_length() or gattlib_connection_set_phy() succeed.
+ *
+ * @param connection Active GATT connection
+ * @param info is the Link Layer settings of the connection
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_get_link_info(gatt_connection_t* connection, gattlib_link_info_t *info);
+
 /**
  * @brief Function to register a callback on GATT disconnection
  *
@@ -444,6 +1021,9 @@ int gattlib_discover_desc(gatt_connection_t* connection, gattlib_descriptor_t**
  *
  * @note buffer is allocated by the function. It is the responsibility of the caller to free the buffer.
  *
+ * @note When several threads read the same characteristic of a connection at the same time, a single
+ *       request is sent to the device. They all receive the value it returns.
+ *
  * @param connection Active GATT connection
  * @param uuid UUID of the GATT characteristic to read
  * @param buffer contains the value to read. It is allocated by the function.
@@ -464,6 +1044,33 @@ int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, void*
  */
 int gattlib_read_char_by_uuid_async(gatt_connection_t* connection, uuid_t* uuid, gatt_read_cb_t gatt_read_cb);
 
+/**
+ * Structure to represent one characteristic read by gattlib_read_multiple()
+ */
+typedef struct {
+	uuid_t uuid;        /**< UUID of the GATT characteristic to read (set by the caller) */
+	void*  buffer;      /**< Value of the characteristic. It is allocated by the function, the caller frees it */
+	size_t buffer_len;  /**< Length of the value */
+	int    ret;         /**< GATTLIB_SUCCESS or GATTLIB_* error code of this characteristic */
+} gattlib_read_multiple_t;
+
+/**
+ * @brief Function to read several GATT characteristics at once
+ *
+ * With Bluez prior to v5.42, the characteristics are read with ATT Read Multiple Variable Length
+ * requests. The characteristics the remote device does not return in these responses are read
+ * one by one. With D-BUS support, the reads are issued together without waiting for each value.
+ *
+ * @param connection Active GATT connection
+ * @param reads are the characteristics to read. `buffer`, `buffer_len` and `ret` are set by the function.
+ * @param count is the number of characteristics in `reads`
+ *
+ * @return GATTLIB_SUCCESS if all the characteristics have been read, GATTLIB_TIMEOUT or GATTLIB_CANCELLED if
+ *         the reads have been abandoned, or the error code of the first one that failed. The values read
+ *         before the reads have been abandoned are still returned and must be freed.
+ */
+int gattlib_read_multiple(gatt_connection_t* connection, gattlib_read_multiple_t* reads, size_t count);
+
 /**
  * @brief Free buffer allocated by the characteristic reading to store the value
  *
@@ -495,6 +1102,36 @@ int gattlib_write_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, cons
  */
 int gattlib_write_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len);
 
+/**
+ * @brief Function to atomically write a value longer than the ATT MTU to the GATT characteristic UUID
+ *
+ * The value is split into Prepare Write requests sized to the negotiated MTU and committed with
+ * a single Execute Write request. The server applies either the whole value or nothing.
+ *
+ * @note With D-BUS support, Bluez performs the reliable write. Bluez versions that ignore the `type`
+ *       option of WriteValue fall back to a regular long write.
+ *
+ * @param connection Active GATT connection
+ * @param uuid UUID of the GATT characteristic to write
+ * @param buffer contains the values to write to the GATT characteristic
+ * @param buffer_len is the length of the buffer to write (up to 512 bytes)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_write_long_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, const void* buffer, size_t buffer_len);
+
+/**
+ * @brief Function to atomically write a value longer than the ATT MTU to the GATT characteristic handle
+ *
+ * @param connection Active GATT connection
+ * @param handle is the handle of the GATT characteristic
+ * @param buffer contains the values to write to the GATT characteristic
+ * @param buffer_len is the length of the buffer to write (up to 512 bytes)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_write_long_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len);
+
 /**
  * @brief Function to write without response to the GATT characteristic UUID
  *
@@ -553,6 +1190,26 @@ int gattlib_write_char_stream_close(gatt_stream_t *stream);
  */
 int gattlib_write_without_response_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len);
 
+/**
+ * @brief Coalesce the writes without response to a GATT characteristic
+ *
+ * When enabled, gattlib_write_without_response_char_by_uuid() and gattlib_write_without_response_char_by_handle()
+ * return without waiting for the write to complete. While a write to the characteristic is in progress,
+ * a newer value replaces the value waiting to be sent. Only the latest value is sent when the link has room.
+ * It suits streams of set-points where the intermediate values are not worth their latency.
+ *
+ * The errors of the coalesced writes are logged but not reported to the caller.
+ *
+ * @note Not supported with Bluez prior to v5.40
+ *
+ * @param connection Active GATT connection
+ * @param uuid is the UUID of the GATT characteristic
+ * @param enable is non-zero to coalesce the writes, 0 to write every value (default)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_write_without_response_set_coalescing(gatt_connection_t* connection, const uuid_t* uuid, int enable);
+
 /*
  * @brief Enable notification on GATT characteristic represented by its UUID
  *
@@ -573,6 +1230,31 @@ int gattlib_notification_start(gatt_connection_t* connection, const uuid_t* uuid
  */
 int gattlib_notification_stop(gatt_connection_t* connection, const uuid_t* uuid);
 
+/**
+ * Structure to represent one characteristic enabled by gattlib_notification_start_multiple()
+ */
+typedef struct {
+	uuid_t   uuid;    /**< UUID of the GATT characteristic (set by the caller). Only used when `handle` is 0 */
+	uint16_t handle;  /**< Handle of the GATT characteristic as used by gattlib_write_char_by_handle() or 0 (set by the caller) */
+	int      ret;     /**< GATTLIB_SUCCESS or GATTLIB_* error code of this characteristic */
+} gattlib_notification_multiple_t;
+
+/**
+ * @brief Enable notification on several GATT characteristics at once
+ *
+ * The characteristics are all resolved before any of them is enabled. The requests to enable
+ * the notifications are then issued together without waiting for each reply.
+ *
+ * @param connection Active GATT connection
+ * @param notifications are the characteristics to enable. `ret` is set by the function.
+ * @param count is the number of characteristics in `notifications`
+ *
+ * @return GATTLIB_SUCCESS if all the notifications have been enabled or the error code of the first one that failed.
+ *         GATTLIB_TIMEOUT or GATTLIB_CANCELLED if the requests did not complete in time (see gattlib_connection_set_timeout())
+ *         or have been cancelled. The characteristics whose request has not completed take this error.
+ */
+int gattlib_notification_start_multiple(gatt_connection_t* connection, gattlib_notification_multiple_t* notifications, size_t count);
+
 /*
  * @brief Enable indication on GATT characteristic represented by its UUID
  *
@@ -615,6 +1297,163 @@ void gattlib_register_notification(gatt_connection_t* connection, gattlib_event_
  */
 void gattlib_register_indication(gatt_connection_t* connection, gattlib_event_handler_t indication_handler, void* user_data);
 
+/**
+ * Options of a LE Credit Based Connection Oriented Channel
+ */
+typedef struct {
+	uint16_t mtu;                /**< Largest SDU accepted from the remote device (0 for the kernel default).
+	                                  The kernel derives the MPS and the credits granted to the remote device from it.
+	                                  Kernels that require the 'enable_ecred' parameter of the bluetooth module to change it
+	                                  keep their default: check the MTU with gattlib_l2cap_get_mtu() */
+	uint8_t  security_level;     /**< BT_SECURITY_* level of the channel (0 for the kernel default) */
+	int      connect_timeout_ms; /**< Connection timeout in milliseconds (0 for the kernel timeout) */
+} gattlib_l2cap_options_t;
+
+/**
+ * @brief Open a LE Credit Based Connection Oriented Channel to a PSM of a device
+ *
+ * The channel carries data without the overhead of GATT. The flow control is driven by the credits
+ * granted by the remote device: when it runs out of credits, sending blocks until it grants new ones.
+ *
+ * @param src is the MAC address of the adapter to use (NULL for any adapter)
+ * @param dst is the MAC address of the remote device
+ * @param dst_type is the address type of the remote device (BDADDR_LE_PUBLIC or BDADDR_LE_RANDOM)
+ * @param psm is the LE PSM of the remote service
+ * @param options are the options of the channel (NULL for the defaults)
+ * @param channel is the opened channel
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_l2cap_connect(const char *src, const char *dst, uint8_t dst_type, uint16_t psm,
+		const gattlib_l2cap_options_t *options, gattlib_l2cap_channel_t **channel);
+
+/**
+ * @brief Retrieve the MTUs negotiated for a LE Credit Based Connection Oriented Channel
+ *
+ * @param channel is the channel opened with gattlib_l2cap_connect()
+ * @param tx_mtu is the largest SDU the remote device accepts (can be NULL)
+ * @param rx_mtu is the largest SDU the local device accepts (can be NULL)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_l2cap_get_mtu(gattlib_l2cap_channel_t *channel, uint16_t *tx_mtu, uint16_t *rx_mtu);
+
+/**
+ * @brief Retrieve the file descriptor of a channel to wait for it in an event loop
+ *
+ * @param channel is the channel opened with gattlib_l2cap_connect()
+ *
+ * @return the file descriptor of the channel or -1 on error
+ */
+int gattlib_l2cap_get_fd(gattlib_l2cap_channel_t *channel);
+
+/**
+ * @brief Send one SDU gathered from several buffers
+ *
+ * @param channel is the channel opened with gattlib_l2cap_connect()
+ * @param iov are the buffers that form the SDU (up to the TX MTU bytes in total)
+ * @param iovcnt is the number of buffers
+ * @param timeout_ms is the time to wait for credits in milliseconds (negative value to wait forever)
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_TIMEOUT if the remote device has not granted credits in time
+ *         or GATTLIB_* error code
+ */
+int gattlib_l2cap_sendv(gattlib_l2cap_channel_t *channel, const struct iovec *iov, int iovcnt, int timeout_ms);
+
+/**
+ * @brief Receive one SDU scattered into several buffers
+ *
+ * @param channel is the channel opened with gattlib_l2cap_connect()
+ * @param iov are the buffers to receive the SDU
+ * @param iovcnt is the number of buffers
+ * @param len is the length of the received SDU
+ * @param timeout_ms is the time to wait for a SDU in milliseconds (negative value to wait forever)
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_TIMEOUT if no SDU has been received in time,
+ *         GATTLIB_INVALID_PARAMETER if the SDU did not fit in the buffers (its first `len` bytes are received
+ *         and the rest is lost) or GATTLIB_* error code
+ */
+int gattlib_l2cap_recvv(gattlib_l2cap_channel_t *channel, const struct iovec *iov, int iovcnt, size_t *len, int timeout_ms);
+
+/**
+ * @brief Close a channel opened with gattlib_l2cap_connect()
+ *
+ * @param channel is the channel to close
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_l2cap_close(gattlib_l2cap_channel_t *channel);
+
+/**
+ * @brief Handler called by the connection scheduler to run a job
+ *
+ * The handler is called from a thread of the scheduler. It can run any GATT operation on the connection
+ * but must not disconnect it.
+ *
+ * @param connection is the connection to the device of the job (NULL when `error` is not GATTLIB_SUCCESS)
+ * @param error is GATTLIB_SUCCESS, GATTLIB_DEVICE_ERROR if the device could not be connected,
+ *        GATTLIB_TIMEOUT if the job could not start before its deadline or GATTLIB_CANCELLED if the
+ *        scheduler has been freed before the job could start
+ * @param user_data is the data passed to gattlib_scheduler_submit()
+ *
+ * @return GATTLIB_SUCCESS to keep the connection open for the next jobs of the device. Any other value
+ *         closes the connection.
+ */
+typedef int (*gattlib_scheduler_job_cb_t)(gatt_connection_t* connection, int error, void* user_data);
+
+/**
+ * Options of a connection scheduler
+ */
+typedef struct {
+	unsigned int  max_connections;    /**< Largest number of connections kept open at the same time.
+	                                       It should not exceed the number of LE connections supported by the controller */
+	unsigned int  idle_timeout_ms;    /**< Time a connection stays open after its last job to be reused by the next jobs */
+	unsigned long connection_options; /**< Options passed to gattlib_connect(). See `GATTLIB_CONNECTION_OPTIONS_*` */
+} gattlib_scheduler_options_t;
+
+/**
+ * @brief Create a scheduler that multiplexes the connections to many devices on an adapter
+ *
+ * The scheduler runs the jobs submitted with gattlib_scheduler_submit() by order of priority and deadline
+ * while keeping at most `max_connections` connections open. The connections are kept open while they are
+ * used, and the least recently used idle connection is closed when a job needs to connect another device.
+ *
+ * @param adapter is the adapter to connect the devices with (NULL for the default adapter).
+ *        It is not closed by the scheduler and must stay open until gattlib_scheduler_free().
+ * @param options are the options of the scheduler
+ * @param scheduler is the created scheduler
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_scheduler_new(void *adapter, const gattlib_scheduler_options_t *options, gattlib_scheduler_t **scheduler);
+
+/**
+ * @brief Submit a job to run on a connection to a device
+ *
+ * @param scheduler is the scheduler created with gattlib_scheduler_new()
+ * @param dst is the MAC address of the device
+ * @param priority is the priority of the job. Jobs with a higher priority run first.
+ * @param deadline_ms is the time in milliseconds the job must start within (0 for no deadline).
+ *        Among the jobs of same priority, the jobs with the earliest deadline run first.
+ * @param job_cb is the handler that runs the job
+ * @param user_data is the data passed to the handler
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_scheduler_submit(gattlib_scheduler_t *scheduler, const char *dst, int priority, unsigned int deadline_ms,
+		gattlib_scheduler_job_cb_t job_cb, void *user_data);
+
+/**
+ * @brief Stop a scheduler and close its connections
+ *
+ * The jobs that are running are completed. The handlers of the pending jobs are called with GATTLIB_CANCELLED.
+ *
+ * @param scheduler is the scheduler to free
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_scheduler_free(gattlib_scheduler_t *scheduler);
+
 #if 0 // Disable until https://github.com/labapart/gattlib/issues/75 is resolved
 /**
  * @brief Function to retrieve RSSI from a GATT connection
@@ -674,6 +1513,66 @@ int gattlib_get_advertisement_data_from_mac(void *adapter, const char *mac_addre
 		gattlib_advertisement_data_t **advertisement_data, size_t *advertisement_data_count,
 		uint16_t *manufacturer_id, uint8_t **manufacturer_data, size_t *manufacturer_data_size);
 
+/**
+ * @brief Get the record of a device from the registry filled by Bluetooth scanning
+ *
+ * @note: Contrary to `gattlib_get_rssi_from_mac()` and `gattlib_get_advertisement_data_from_mac()`,
+ * this function does not involve any Bluez request.
+ *
+ * @param adapter is the adapter the device has been seen
+ * @param mac_address is the MAC address of the device
+ * @param record is the structure that receives a copy of the device record
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_FOUND if the device has not been seen or GATTLIB_* error code
+ */
+int gattlib_device_registry_get(void *adapter, const char *mac_address, gattlib_device_record_t *record);
+
+/**
+ * @brief Copy all the records of the device registry
+ *
+ * @param adapter is the adapter the devices have been seen
+ * @param records is the array of records. It must be freed with free()
+ * @param records_count is the number of records in the array
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_device_registry_snapshot(void *adapter, gattlib_device_record_t **records, size_t *records_count);
+
+/**
+ * @brief Iterate over the records of the device registry
+ *
+ * @note: The registry is locked during the iteration. The callback must not call gattlib_device_registry_*() functions.
+ *
+ * @param adapter is the adapter the devices have been seen
+ * @param record_cb is the function called for each record
+ * @param user_data is the data passed to the callback `record_cb()`
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_device_registry_foreach(void *adapter, gattlib_device_record_cb_t record_cb, void *user_data);
+
+/**
+ * @brief Bound the number of devices of the device registry
+ *
+ * When the registry is full, the least recently seen device is evicted to record a new device.
+ * The registry holds up to `GATTLIB_DEVICE_REGISTRY_DEFAULT_MAX_DEVICES` devices by default.
+ *
+ * @param adapter is the adapter the devices have been seen
+ * @param max_devices is the maximum number of devices in the registry. When max_devices=0, the registry is unbounded.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_device_registry_set_max_devices(void *adapter, size_t max_devices);
+
+/**
+ * @brief Remove all the records of the device registry
+ *
+ * @param adapter is the adapter the devices have been seen
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_device_registry_clear(void *adapter);
+
 /**
  * @brief Convert a UUID into a string
  *
@@ -0,0 +1,251 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-or-later
+ *
+ * Copyright (c) 2021-2022, Olivier Martin <olivier@labapart.org>
+ */
+
+//
+// Encoding of the LE Link Layer HCI commands and parsing of their events. The HCI socket is
+// replaced by a socketpair: the test plays the controller on the other end.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gattlib_internal.h"
+
+#define HANDLE        0x0040
+#define OTHER_HANDLE  0x0041
+
+// Opcodes of LE Set Data Length (OCF 0x0022) and LE Set PHY (OCF 0x0032) in OGF 0x08
+#define OPCODE_LE_SET_DATA_LENGTH  0x2022
+#define OPCODE_LE_SET_PHY          0x2032
+
+#define CHECK(cond) do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: Check '%s' failed\n", __FILE__, __LINE__, #cond); \
+			exit(EXIT_FAILURE); \
+		} \
+	} while (0)
+
+static const uint8_t m_cmd_status_ok[] = { 0x04, 0x0F, 0x04, 0x00, 0x01, 0x32, 0x20 };
+static const uint8_t m_cmd_status_failed[] = { 0x04, 0x0F, 0x04, 0x0C, 0x01, 0x32, 0x20 };
+static const uint8_t m_cmd_complete_ok[] = { 0x04, 0x0E, 0x06, 0x01, 0x22, 0x20, 0x00, 0x40, 0x00 };
+static const uint8_t m_data_length_change[] = {
+	0x04, 0x3E, 0x0B, 0x07, 0x40, 0x00, 0xFB, 0x00, 0x48, 0x08, 0xB0, 0x00, 0x40, 0x03 };
+static const uint8_t m_phy_update_complete[] = { 0x04, 0x3E, 0x06, 0x0C, 0x00, 0x40, 0x00, 0x02, 0x03 };
+static const uint8_t m_phy_update_failed[] = { 0x04, 0x3E, 0x06, 0x0C, 0x1A, 0x40, 0x00, 0x02, 0x02 };
+
+static int64_t get_monotonic_time_ms(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void test_encode(void) {
+	static const uint8_t expected_data_length[] = {
+		0x01, 0x22, 0x20, 0x06, 0x40, 0x00, 0xFB, 0x00, 0x48, 0x08 };
+	static const uint8_t expected_phy[] = {
+		0x01, 0x32, 0x20, 0x07, 0x40, 0x00, 0x00, 0x02, 0x03, 0x00, 0x00 };
+	uint8_t buf[32];
+	size_t len;
+
+	len = gattlib_hci_encode_le_set_data_length(buf, HANDLE, 251, 2120);
+	CHECK(len == sizeof(expected_data_length));
+	CHECK(memcmp(buf, expected_data_length, len) == 0);
+
+	len = gattlib_hci_encode_le_set_phy(buf, HANDLE, GATTLIB_PHY_2M, GATTLIB_PHY_1M | GATTLIB_PHY_2M);
+	CHECK(len == sizeof(expected_phy));
+	CHECK(memcmp(buf, expected_phy, len) == 0);
+}
+
+static void test_parse_command_events(void) {
+	gattlib_link_info_t info;
+
+	gattlib_link_info_init(&info);
+
+	CHECK(gattlib_hci_parse_link_event(m_cmd_status_ok, sizeof(m_cmd_status_ok),
+			OPCODE_LE_SET_PHY, HANDLE, &info) == GATTLIB_LINK_EVENT_COMMAND_DONE);
+	CHECK(gattlib_hci_parse_link_event(m_cmd_status_failed, sizeof(m_cmd_status_failed),
+			OPCODE_LE_SET_PHY, HANDLE, &info) == GATTLIB_LINK_EVENT_COMMAND_FAILED);
+	CHECK(gattlib_hci_parse_link_event(m_cmd_complete_ok, sizeof(m_cmd_complete_ok),
+			OPCODE_LE_SET_DATA_LENGTH, HANDLE, &info) == GATTLIB_LINK_EVENT_COMMAND_DONE);
+
+	// The events of another command are ignored
+	CHECK(gattlib_hci_parse_link_event(m_cmd_status_failed, sizeof(m_cmd_status_failed),
+			OPCODE_LE_SET_DATA_LENGTH, HANDLE, &info) == GATTLIB_LINK_EVENT_NONE);
+	CHECK(gattlib_hci_parse_link_event(m_cmd_complete_ok, sizeof(m_cmd_complete_ok),
+			OPCODE_LE_SET_PHY, HANDLE, &info) == GATTLIB_LINK_EVENT_NONE);
+}
+
+static void test_parse_le_meta_events(void) {
+	gattlib_link_info_t info;
+
+	gattlib_link_info_init(&info);
+	CHECK(gattlib_hci_parse_link_event(m_data_length_change, sizeof(m_data_length_change),
+			OPCODE_LE_SET_DATA_LENGTH, HANDLE, &info) == GATTLIB_LINK_EVENT_DATA_LENGTH_CHANGED);
+	CHECK(info.max_tx_octets == 251);
+	CHECK(info.max_tx_time == 2120);
+	CHECK(info.max_rx_octets == 176);
+	CHECK(info.max_rx_time == 832);
+
+	CHECK(gattlib_hci_parse_link_event(m_phy_update_complete, sizeof(m_phy_update_complete),
+			OPCODE_LE_SET_PHY, HANDLE, &info) == GATTLIB_LINK_EVENT_PHY_UPDATED);
+	CHECK(info.tx_phy == 0x02);
+	CHECK(info.rx_phy == 0x03);
+
+	CHECK(gattlib_hci_parse_link_event(m_phy_update_failed, sizeof(m_phy_update_failed),
+			OPCODE_LE_SET_PHY, HANDLE, &info) == GATTLIB_LINK_EVENT_COMMAND_FAILED);
+	// A failed update does not change the PHYs in use
+	CHECK(info.tx_phy == 0x02);
+	CHECK(info.rx_phy == 0x03);
+}
+
+static void test_parse_other_handle(void) {
+	gattlib_link_info_t info;
+
+	gattlib_link_info_init(&info);
+	CHECK(gattlib_hci_parse_link_event(m_data_length_change, sizeof(m_data_length_change),
+			OPCODE_LE_SET_DATA_LENGTH, OTHER_HANDLE, &info) == GATTLIB_LINK_EVENT_NONE);
+	CHECK(gattlib_hci_parse_link_event(m_phy_update_complete, sizeof(m_phy_update_complete),
+			OPCODE_LE_SET_PHY, OTHER_HANDLE, &info) == GATTLIB_LINK_EVENT_NONE);
+	CHECK(info.max_tx_octets == 27);
+	CHECK(info.tx_phy == GATTLIB_PHY_1M);
+}
+
+static void test_parse_truncated(void) {
+	static const uint8_t not_an_event[] = { 0x02, 0x0F, 0x04, 0x00, 0x01, 0x32, 0x20 };
+	gattlib_link_info_t info;
+
+	gattlib_link_info_init(&info);
+
+	// Every truncation of the events must be ignored
+	for (size_t len = 0; len < sizeof(m_data_length_change); len++) {
+		CHECK(gattlib_hci_parse_link_event(m_data_length_change, len,
+				OPCODE_LE_SET_DATA_LENGTH, HANDLE, &info) == GATTLIB_LINK_EVENT_NONE);
+	}
+	for (size_t len = 0; len < sizeof(m_phy_update_complete); len++) {
+		CHECK(gattlib_hci_parse_link_event(m_phy_update_complete, len,
+				OPCODE_LE_SET_PHY, HANDLE, &info) == GATTLIB_LINK_EVENT_NONE);
+	}
+	for (size_t len = 0; len < sizeof(m_cmd_status_ok); len++) {
+		CHECK(gattlib_hci_parse_link_event(m_cmd_status_ok, len,
+				OPCODE_LE_SET_PHY, HANDLE, &info) == GATTLIB_LINK_EVENT_NONE);
+	}
+	CHECK(info.max_tx_octets == 27);
+	CHECK(info.tx_phy == GATTLIB_PHY_1M);
+
+	CHECK(gattlib_hci_parse_link_event(not_an_event, sizeof(not_an_event),
+			OPCODE_LE_SET_PHY, HANDLE, &info) == GATTLIB_LINK_EVENT_NONE);
+}
+
+/* Queue the events of the controller and send the command through the socketpair */
+static int link_request(const uint8_t *cmd, size_t cmd_len, int expected_event,
+		const uint8_t *events[], const size_t events_len[], size_t events_count,
+		gattlib_link_info_t *info, int timeout_ms)
+{
+	uint8_t received[32];
+	int fds[2];
+	int ret;
+
+	CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == 0);
+
+	for (size_t i = 0; i < events_count; i++) {
+		CHECK(write(fds[1], events[i], events_len[i]) == (ssize_t)events_len[i]);
+	}
+
+	ret = gattlib_hci_link_request(fds[0], cmd, cmd_len, HANDLE, expected_event, info, timeout_ms);
+
+	// The controller must have received the command as encoded
+	CHECK(read(fds[1], received, sizeof(received)) == (ssize_t)cmd_len);
+	CHECK(memcmp(received, cmd, cmd_len) == 0);
+
+	close(fds[0]);
+	close(fds[1]);
+	return ret;
+}
+
+static void test_link_request(void) {
+	gattlib_link_info_t info;
+	uint8_t cmd[32];
+	size_t cmd_len;
+
+	// LE Set PHY: Command Status then LE PHY Update Complete
+	{
+		const uint8_t *events[] = { m_cmd_status_ok, m_phy_update_complete };
+		const size_t events_len[] = { sizeof(m_cmd_status_ok), sizeof(m_phy_update_complete) };
+
+		gattlib_link_info_init(&info);
+		cmd_len = gattlib_hci_encode_le_set_phy(cmd, HANDLE, GATTLIB_PHY_2M, GATTLIB_PHY_2M);
+		CHECK(link_request(cmd, cmd_len, GATTLIB_LINK_EVENT_PHY_UPDATED, events, events_len, 2, &info, 1000) == GATTLIB_SUCCESS);
+		CHECK(info.tx_phy == 0x02);
+		CHECK(info.rx_phy == 0x03);
+	}
+
+	// LE Set PHY: the controller rejects the command
+	{
+		const uint8_t *events[] = { m_cmd_status_failed };
+		const size_t events_len[] = { sizeof(m_cmd_status_failed) };
+
+		gattlib_link_info_init(&info);
+		cmd_len = gattlib_hci_encode_le_set_phy(cmd, HANDLE, GATTLIB_PHY_2M, GATTLIB_PHY_2M);
+		CHECK(link_request(cmd, cmd_len, GATTLIB_LINK_EVENT_PHY_UPDATED, events, events_len, 1, &info, 1000) == GATTLIB_DEVICE_ERROR);
+		CHECK(info.tx_phy == GATTLIB_PHY_1M);
+	}
+
+	// LE Set Data Length: the events of another connection are skipped
+	{
+		const uint8_t other_data_length_change[] = {
+			0x04, 0x3E, 0x0B, 0x07, 0x41, 0x00, 0x1B, 0x00, 0x48, 0x01, 0x1B, 0x00, 0x48, 0x01 };
+		const uint8_t *events[] = { m_cmd_complete_ok, other_data_length_change, m_data_length_change };
+		const size_t events_len[] = { sizeof(m_cmd_complete_ok), sizeof(other_data_length_change), sizeof(m_data_length_change) };
+
+		gattlib_link_info_init(&info);
+		cmd_len = gattlib_hci_encode_le_set_data_length(cmd, HANDLE, 251, 2120);
+		CHECK(link_request(cmd, cmd_len, GATTLIB_LINK_EVENT_DATA_LENGTH_CHANGED, events, events_len, 3, &info, 1000) == GATTLIB_SUCCESS);
+		CHECK(info.max_tx_octets == 251);
+		CHECK(info.max_rx_octets == 176);
+	}
+}
+
+static void test_link_request_timeout(void) {
+	gattlib_link_info_t info;
+	uint8_t cmd[32];
+	size_t cmd_len;
+	int64_t start;
+
+	// The controller never answers
+	gattlib_link_info_init(&info);
+	cmd_len = gattlib_hci_encode_le_set_phy(cmd, HANDLE, GATTLIB_PHY_2M, GATTLIB_PHY_2M);
+	start = get_monotonic_time_ms();
+	CHECK(link_request(cmd, cmd_len, GATTLIB_LINK_EVENT_PHY_UPDATED, NULL, NULL, 0, &info, 100) == GATTLIB_DEVICE_ERROR);
+	CHECK(get_monotonic_time_ms() - start >= 100);
+
+	// The command completes but the values are already in use: no change is reported
+	{
+		const uint8_t *events[] = { m_cmd_complete_ok };
+		const size_t events_len[] = { sizeof(m_cmd_complete_ok) };
+
+		cmd_len = gattlib_hci_encode_le_set_data_length(cmd, HANDLE, 251, 2120);
+		start = get_monotonic_time_ms();
+		CHECK(link_request(cmd, cmd_len, GATTLIB_LINK_EVENT_DATA_LENGTH_CHANGED, events, events_len, 1, &info, 100) == GATTLIB_SUCCESS);
+		CHECK(get_monotonic_time_ms() - start >= 100);
+		CHECK(info.max_tx_octets == 27);
+	}
+}
+
+int main(void) {
+	test_encode();
+	test_parse_command_events();
+	test_parse_le_meta_events();
+	test_parse_other_handle();
+	test_parse_truncated();
+	test_link_request();
+	test_link_request_timeout();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-or-later
+ *
+ * Copyright (c) 2021-2022, Olivier Martin <olivier@labapart.org>
+ */
+
+//
+// Sequencing of the jobs of the connection scheduler. The connections are replaced by fakes that
+// check the adapter given to the scheduler stays usable for all its jobs.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gattlib_internal.h"
+
+#define DEVICE_A  "00:11:22:33:44:55"
+#define DEVICE_B  "66:77:88:99:AA:BB"
+
+#define CHECK(cond) do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: Check '%s' failed\n", __FILE__, __LINE__, #cond); \
+			exit(EXIT_FAILURE); \
+		} \
+	} while (0)
+
+// Adapter shared by all the connections of the scheduler. It is owned by the test.
+static struct {
+	bool open;
+	unsigned int connect_count;
+	unsigned int disconnect_count;
+	unsigned int connection_count;
+} m_adapter;
+
+static pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;
+
+struct job_result {
+	bool done;
+	int error;
+	gatt_connection_t* connection;
+	// Set to hold the job until 'released' is set
+	bool hold;
+	bool released;
+};
+
+//
+// Fake connections. The scheduler is the only user of the adapter.
+//
+gatt_connection_t *gattlib_connect(void *adapter, const char *dst, unsigned long options) {
+	CHECK(adapter == &m_adapter);
+	CHECK(m_adapter.open);
+
+	m_adapter.connect_count++;
+	m_adapter.connection_count++;
+	return calloc(1, sizeof(gatt_connection_t));
+}
+
+int gattlib_disconnect(gatt_connection_t *connection) {
+	// The adapter must outlive the connections opened on it
+	CHECK(m_adapter.open);
+	CHECK(m_adapter.connection_count > 0);
+
+	m_adapter.disconnect_count++;
+	m_adapter.connection_count--;
+	free(connection);
+	return GATTLIB_SUCCESS;
+}
+
+struct gattlib_device_registry* gattlib_adapter_get_device_registry(void *adapter) {
+	return NULL;
+}
+
+static int job_cb(gatt_connection_t* connection, int error, void* user_data) {
+	struct job_result *result = user_data;
+
+	pthread_mutex_lock(&m_mutex);
+	result->done = true;
+	result->error = error;
+	result->connection = connection;
+	pthread_cond_broadcast(&m_cond);
+	while (result->hold && !result->released) {
+		pthread_cond_wait(&m_cond, &m_mutex);
+	}
+	pthread_mutex_unlock(&m_mutex);
+
+	return GATTLIB_SUCCESS;
+}
+
+static void wait_job(struct job_result *result) {
+	pthread_mutex_lock(&m_mutex);
+	while (!result->done) {
+		pthread_cond_wait(&m_cond, &m_mutex);
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
+static void run_job(gattlib_scheduler_t *scheduler, const char *dst, struct job_result *result) {
+	memset(result, 0, sizeof(*result));
+	CHECK(gattlib_scheduler_submit(scheduler, dst, 0, 0, job_cb, result) == GATTLIB_SUCCESS);
+	wait_job(result);
+}
+
+static void* release_job(void *arg) {
+	struct job_result *result = arg;
+
+	// Leave time to gattlib_scheduler_free() to stop the scheduler
+	usleep(100000);
+
+	pthread_mutex_lock(&m_mutex);
+	result->released = true;
+	pthread_cond_broadcast(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+	return NULL;
+}
+
+static void test_jobs_in_sequence(void) {
+	gattlib_scheduler_options_t options = {
+		.max_connections = 1,
+		.idle_timeout_ms = 60000,
+	};
+	gattlib_scheduler_t *scheduler;
+	struct job_result first, second, third;
+
+	m_adapter.open = true;
+	CHECK(gattlib_scheduler_new(&m_adapter, &options, &scheduler) == GATTLIB_SUCCESS);
+
+	run_job(scheduler, DEVICE_A, &first);
+	CHECK(first.error == GATTLIB_SUCCESS);
+	CHECK(first.connection != NULL);
+	CHECK(m_adapter.connect_count == 1);
+
+	// The single slot drops the connection of the first device to run the job of the second one
+	run_job(scheduler, DEVICE_B, &second);
+	CHECK(second.error == GATTLIB_SUCCESS);
+	CHECK(second.connection != NULL);
+	CHECK(m_adapter.connect_count == 2);
+	CHECK(m_adapter.disconnect_count == 1);
+
+	// The warm connection is reused
+	run_job(scheduler, DEVICE_B, &third);
+	CHECK(third.error == GATTLIB_SUCCESS);
+	CHECK(third.connection == second.connection);
+	CHECK(m_adapter.connect_count == 2);
+
+	CHECK(gattlib_scheduler_free(scheduler) == GATTLIB_SUCCESS);
+	CHECK(m_adapter.connection_count == 0);
+	m_adapter.open = false;
+}
+
+static void test_pending_jobs_cancelled(void) {
+	gattlib_scheduler_options_t options = {
+		.max_connections = 1,
+		.idle_timeout_ms = 60000,
+	};
+	gattlib_scheduler_t *scheduler;
+	struct job_result running, pending;
+	pthread_t release_thread;
+
+	memset(&running, 0, sizeof(running));
+	memset(&pending, 0, sizeof(pending));
+	running.hold = true;
+
+	m_adapter.open = true;
+	CHECK(gattlib_scheduler_new(&m_adapter, &options, &scheduler) == GATTLIB_SUCCESS);
+
+	// The single slot is busy with the first job while the second one is pending
+	CHECK(gattlib_scheduler_submit(scheduler, DEVICE_A, 0, 0, job_cb, &running) == GATTLIB_SUCCESS);
+	wait_job(&running);
+	CHECK(gattlib_scheduler_submit(scheduler, DEVICE_B, 0, 0, job_cb, &pending) == GATTLIB_SUCCESS);
+
+	CHECK(pthread_create(&release_thread, NULL, release_job, &running) == 0);
+	CHECK(gattlib_scheduler_free(scheduler) == GATTLIB_SUCCESS);
+	pthread_join(release_thread, NULL);
+
+	CHECK(running.error == GATTLIB_SUCCESS);
+	CHECK(pending.done);
+	CHECK(pending.error == GATTLIB_CANCELLED);
+	CHECK(pending.connection == NULL);
+	CHECK(m_adapter.connection_count == 0);
+	m_adapter.open = false;
+}
+
+int main(void) {
+	test_jobs_in_sequence();
+	test_pending_jobs_cancelled();
+
+	printf("test_scheduler: OK\n");
+	return EXIT_SUCCESS;
+}